@@ -0,0 +1,62 @@
+/* Copyright 2015 Nikos Chantziaras
+ *
+ * This file is part of Hugor.
+ *
+ * Hugor is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Hugor is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Hugor.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Additional permission under GNU GPL version 3 section 7
+ *
+ * If you modify this Program, or any covered work, by linking or combining it
+ * with the Hugo Engine (or a modified version of the Hugo Engine), containing
+ * parts covered by the terms of the Hugo License, the licensors of this
+ * Program grant you additional permission to convey the resulting work.
+ * Corresponding Source for a non-source form of such a combination shall
+ * include the source code for the parts of the Hugo Engine used as well as
+ * that of the covered work.
+ */
+#include <QtTest>
+#include <thread>
+
+#include "happlication.h"
+#include "hmainwindow.h"
+#include "hugorbench.h"
+#include "version.h"
+
+
+int main( int argc, char* argv[] )
+{
+    // Results shouldn't depend on the desktop the benchmarks happen to run
+    // on.
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
+    // A name of our own, so that the player's settings don't apply.
+    HApplication* app = new HApplication(argc, argv, "Hugor Bench", HUGOR_VERSION,
+                                         "Nikos Chantziaras", "");
+    hMainWin->setUpdatesEnabled(true);
+    hMainWin->resize(800, 600);
+    hMainWin->show();
+
+    int ret = 0;
+    std::thread engine([&ret, argc, argv, app]{
+        HugorBench bench;
+        ret = QTest::qExec(&bench, argc, argv);
+        QMetaObject::invokeMethod(app, "quit", Qt::QueuedConnection);
+    });
+    app->exec();
+    engine.join();
+    delete app;
+    return ret;
+}
@@ -0,0 +1,286 @@
+/* Copyright 2015 Nikos Chantziaras
+ *
+ * This file is part of Hugor.
+ *
+ * Hugor is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Hugor is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Hugor.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Additional permission under GNU GPL version 3 section 7
+ *
+ * If you modify this Program, or any covered work, by linking or combining it
+ * with the Hugo Engine (or a modified version of the Hugo Engine), containing
+ * parts covered by the terms of the Hugo License, the licensors of this
+ * Program grant you additional permission to convey the resulting work.
+ * Corresponding Source for a non-source form of such a combination shall
+ * include the source code for the parts of the Hugo Engine used as well as
+ * that of the covered work.
+ */
+#include <QtTest>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QProcess>
+
+#include "hugorbench.h"
+#include "hframe.h"
+#include "hugohandlers.h"
+extern "C" {
+#include "heheader.h"
+}
+
+// The size of the synthetic game. About what a mid-sized game built with the
+// standard library has.
+static const HSyntheticGameSpec BENCH_SPEC = { 600, 12, 3000, 32, 48, 16 };
+
+// Turns replay() plays of the synthetic game.
+static const int REPLAY_TURNS = 400;
+
+static const char LINE[] = "The quick brown fox jumps over the lazy dog, and then it does it again.";
+
+
+void
+HugorBench::initTestCase()
+{
+    QVERIFY(fDir.isValid());
+    fSpec = BENCH_SPEC;
+    const double scale = qEnvironmentVariableIsSet("HUGOR_BENCH_SCALE")
+                         ? qgetenv("HUGOR_BENCH_SCALE").toDouble() : 1.0;
+    QVERIFY2(scale > 0, "HUGOR_BENCH_SCALE must be a number greater than 0.");
+    fSpec.objects = qMax(1, qRound(fSpec.objects * scale));
+    fSpec.dictionaryWords = qMax(1, qRound(fSpec.dictionaryWords * scale));
+    std::string error;
+    QVERIFY2(makeSyntheticGame(fSpec, fGame, error), error.c_str());
+    const std::vector<unsigned char>& img = fGame.image;
+    QFile file(fDir.filePath(QString::fromLatin1("bench.hex")));
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    QCOMPARE(file.write(reinterpret_cast<const char*>(img.data()), img.size()), qint64(img.size()));
+    file.close();
+    fSaveFile = QFile::encodeName(fDir.filePath(QString::fromLatin1("bench.sav")));
+
+    // What he_main() does up to running the game.
+    qstrncpy(gamefile, QFile::encodeName(file.fileName()).constData(), MAXPATH);
+    hugo_init_screen();
+    SetupDisplay();
+    gameseg = 0;
+    LoadGame();
+    defseg = arraytable;
+    for (int i = 0; i < MAXGLOBALS; ++i) {
+        var[i] = PeekWord(i * 2);
+    }
+    defseg = gameseg;
+
+    // A game in progress has changed a few bytes here and there, which is
+    // what saving has to pick out.
+    for (long i = objtable * 16L; i < codeend; i += 37) {
+        SETMEM(i, MEM(i) ^ 0x5A);
+    }
+}
+
+
+void
+HugorBench::cleanupTestCase()
+{
+    hugo_closefiles();
+    hugo_cleanup_screen();
+    hugo_blockfree(mem);
+    mem = nullptr;
+}
+
+
+void
+HugorBench::textWidth_data()
+{
+    QTest::addColumn<int>("font");
+    QTest::newRow("fixed") << int(NORMAL_FONT);
+    QTest::newRow("proportional") << int(PROP_FONT);
+}
+
+
+void
+HugorBench::textWidth()
+{
+    QFETCH(int, font);
+    hugo_font(font);
+    QByteArray line(LINE);
+    QBENCHMARK {
+        hugo_textwidth(line.data());
+    }
+    hugo_font(NORMAL_FONT);
+}
+
+
+void
+HugorBench::print()
+{
+    // Printing a line past the bottom of the window scrolls it, so this
+    // includes flushing and scrolling.
+    QByteArray line = QByteArray(LINE) + '\n';
+    hugo_font(PROP_FONT);
+    QBENCHMARK {
+        hHandlers->print(line.data());
+    }
+    hugo_font(NORMAL_FONT);
+}
+
+
+void
+HugorBench::flushText()
+{
+    const QString line = QString::fromLatin1(LINE);
+    QBENCHMARK {
+        hFrame->printText(line, physical_windowleft, physical_windowtop);
+        hFrame->flushText();
+    }
+}
+
+
+void
+HugorBench::scrollUp()
+{
+    QBENCHMARK {
+        hFrame->scrollUp(physical_windowleft, physical_windowtop, physical_windowright,
+                         physical_windowbottom, lineheight);
+    }
+}
+
+
+void
+HugorBench::findWord_data()
+{
+    const auto& words = fGame.words;
+    QTest::addColumn<QByteArray>("word");
+    QTest::newRow("first") << QByteArray(words.front().c_str());
+    QTest::newRow("middle") << QByteArray(words[words.size() / 2].c_str());
+    QTest::newRow("last") << QByteArray(words.back().c_str());
+    // Unknown words of six letters or more are looked up twice; the second
+    // time as a prefix.
+    QTest::newRow("unknown") << QByteArray("xyzzyplugh");
+}
+
+
+void
+HugorBench::findWord()
+{
+    QFETCH(QByteArray, word);
+    QBENCHMARK {
+        FindWord(word.data());
+    }
+}
+
+
+void
+HugorBench::propAddr_data()
+{
+    QTest::addColumn<int>("obj");
+    QTest::addColumn<int>("prop");
+    QTest::newRow("first") << fSpec.objects / 2 << noun;
+    QTest::newRow("last") << fSpec.objects / 2 << fGame.lastProperty;
+    QTest::newRow("missing") << fSpec.objects / 2 << fGame.lastProperty + 1;
+}
+
+
+void
+HugorBench::propAddr()
+{
+    QFETCH(int, obj);
+    QFETCH(int, prop);
+    QBENCHMARK {
+        PropAddr(obj, prop, 0);
+    }
+}
+
+
+void
+HugorBench::evalExpr()
+{
+    QBENCHMARK {
+        codeptr = fGame.expressionAddr;
+        SetupExpr();
+        EvalExpr(0);
+    }
+}
+
+
+void
+HugorBench::saveGameData()
+{
+    QBENCHMARK {
+        save = hugo_fopen(fSaveFile.constData(), "wb");
+        QVERIFY(save != nullptr);
+        QVERIFY(SaveGameData());
+        hugo_fclose(save);
+        save = nullptr;
+    }
+}
+
+
+void
+HugorBench::restoreGameData()
+{
+    // Uses the file saveGameData() wrote.
+    QVERIFY(QFile::exists(QFile::decodeName(fSaveFile)));
+    QBENCHMARK {
+        save = hugo_fopen(fSaveFile.constData(), "rb");
+        QVERIFY(save != nullptr);
+        QVERIFY(RestoreGameData());
+        hugo_fclose(save);
+        save = nullptr;
+    }
+}
+
+
+void
+HugorBench::replay()
+{
+    QString game = QString::fromLocal8Bit(qgetenv("HUGOR_BENCH_GAME"));
+    QString commands = QString::fromLocal8Bit(qgetenv("HUGOR_BENCH_COMMANDS"));
+    if (game.isEmpty() or commands.isEmpty()) {
+        // The synthetic game, as written by initTestCase(), with the mix of
+        // commands that hugor-mkgame writes.
+        game = fDir.filePath(QString::fromLatin1("bench.hex"));
+        commands = fDir.filePath(QString::fromLatin1("bench.cmd"));
+        QFile file(commands);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        for (int t = 0; t < REPLAY_TURNS; ++t) {
+            file.write(t % 4 == 1 ? "recurse\n" : t % 4 == 3 ? "compute\n" : "wait\n");
+        }
+        file.write("quit\n");
+    }
+    QString headless = QString::fromLocal8Bit(qgetenv("HUGOR_BENCH_HEADLESS"));
+    if (headless.isEmpty()) {
+        headless = QCoreApplication::applicationDirPath() + QString::fromLatin1("/headless/hugor-headless");
+        if (not QFile::exists(headless)) {
+            headless = QString::fromLatin1("hugor-headless");
+        }
+    }
+
+    // Every line is a command, and every command is a turn.
+    QFile file(commands);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    const int turns = file.readAll().count('\n');
+    file.close();
+
+    QProcess proc;
+    proc.setStandardOutputFile(QProcess::nullDevice());
+    proc.setStandardInputFile(commands);
+    int runs = 0;
+    QElapsedTimer timer;
+    timer.start();
+    QBENCHMARK {
+        proc.start(headless, QStringList() << game);
+        QVERIFY2(proc.waitForFinished(-1), qPrintable(proc.errorString()));
+        QCOMPARE(proc.exitStatus(), QProcess::NormalExit);
+        ++runs;
+    }
+    const qint64 elapsed = qMax(timer.elapsed(), qint64(1));
+    qDebug("%d turns in %d runs: %.1f turns/s", turns, runs, turns * runs * 1000.0 / elapsed);
+}
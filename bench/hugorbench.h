@@ -0,0 +1,103 @@
+/* Copyright 2015 Nikos Chantziaras
+ *
+ * This file is part of Hugor.
+ *
+ * Hugor is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Hugor is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Hugor.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Additional permission under GNU GPL version 3 section 7
+ *
+ * If you modify this Program, or any covered work, by linking or combining it
+ * with the Hugo Engine (or a modified version of the Hugo Engine), containing
+ * parts covered by the terms of the Hugo License, the licensors of this
+ * Program grant you additional permission to convey the resulting work.
+ * Corresponding Source for a non-source form of such a combination shall
+ * include the source code for the parts of the Hugo Engine used as well as
+ * that of the covered work.
+ */
+#ifndef HUGORBENCH_H
+#define HUGORBENCH_H
+
+#include <QObject>
+#include <QTemporaryDir>
+
+#include "hgamebuilder.h"
+
+
+// Benchmarks of the interpreter's hot paths. Runs on a thread of its own, the
+// way the engine does, while the GUI thread runs the event loop.
+//
+// The engine benchmarks run on a synthetic game (see makeSyntheticGame()), so
+// they don't need any game files. HUGOR_BENCH_SCALE scales its objects and
+// dictionary, for seeing how the lookups grow with the size of the game.
+// replay() plays the synthetic game with hugor-headless, or a real one if
+// HUGOR_BENCH_GAME and HUGOR_BENCH_COMMANDS name the game and a file with the
+// commands to play.
+class HugorBench: public QObject {
+    Q_OBJECT
+
+  private:
+    QTemporaryDir fDir;
+    HSyntheticGameSpec fSpec;
+    HSyntheticGame fGame;
+    QByteArray fSaveFile;
+
+  private slots:
+    void
+    initTestCase();
+
+    void
+    cleanupTestCase();
+
+    void
+    textWidth_data();
+
+    void
+    textWidth();
+
+    void
+    print();
+
+    void
+    flushText();
+
+    void
+    scrollUp();
+
+    void
+    findWord_data();
+
+    void
+    findWord();
+
+    void
+    propAddr_data();
+
+    void
+    propAddr();
+
+    void
+    evalExpr();
+
+    void
+    saveGameData();
+
+    void
+    restoreGameData();
+
+    void
+    replay();
+};
+
+
+#endif // HUGORBENCH_H
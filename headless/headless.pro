@@ -0,0 +1,9 @@
+# Builds the headless interpreter, the walkthrough regression runner, the
+# session library and the game generator.
+#
+#   cd headless
+#   qmake
+#   make -jN
+
+TEMPLATE = subdirs
+SUBDIRS = hugor-headless.pro hugor-regress.pro hugor-session.pro hugor-mkgame.pro
@@ -0,0 +1,55 @@
+# Headless interpreter. Runs games without a GUI, reading commands from stdin
+# (or a file) and writing game text to stdout (or a file.) Doesn't need Qt,
+# SDL or GStreamer; qmake is only used to build it.
+
+TEMPLATE = app
+CONFIG -= qt app_bundle
+CONFIG += console silent warn_on strict_c++ c++14 thread
+TARGET = hugor-headless
+
+# We use warn_off to allow only default warnings, not to supress them all.
+QMAKE_CXXFLAGS_WARN_OFF =
+QMAKE_CFLAGS_WARN_OFF =
+
+*-g++*|*-clang* {
+    # Avoid "unused parameter" warnings with C code.
+    QMAKE_CFLAGS_WARN_ON += -Wno-unused-parameter
+    # Falling off the end of a function that returns a value is never what we
+    # want.
+    QMAKE_CXXFLAGS_WARN_ON += -Werror=return-type
+}
+
+INCLUDEPATH += ../src ../hugo
+OBJECTS_DIR = obj
+
+DEFINES += HUGOR
+
+HEADERS += \
+    ../src/heheadless.h \
+    ../src/hgameindex.h \
+    ../src/hprofiler.h \
+    ../src/htracer.h \
+    ../src/heqtheader.h \
+    ../src/hugorfile.h \
+    \
+    ../hugo/heheader.h \
+    ../hugo/htokens.h
+
+SOURCES += \
+    ../src/heheadless.cc \
+    ../src/hgameindex.cc \
+    ../src/hprofiler.cc \
+    ../src/htokens.c \
+    ../src/htracer.cc \
+    ../src/headlessmain.cc \
+    \
+    ../hugo/he.c \
+    ../hugo/hebuffer.c \
+    ../hugo/heexpr.c \
+    ../hugo/hemisc.c \
+    ../hugo/heobject.c \
+    ../hugo/heparse.c \
+    ../hugo/heres.c \
+    ../hugo/herun.c \
+    ../hugo/heset.c \
+    ../hugo/stringfn.c
@@ -0,0 +1,23 @@
+# Game generator. Writes synthetic games of a given size, and commands to
+# play them with, for benchmarking and profiling the interpreter (see the
+# README.)
+
+TEMPLATE = app
+CONFIG -= qt app_bundle
+CONFIG += console silent warn_on strict_c++ c++14
+TARGET = hugor-mkgame
+
+INCLUDEPATH += ../src ../hugo
+OBJECTS_DIR = obj-mkgame
+
+DEFINES += HUGOR
+
+HEADERS += \
+    ../src/hgamebuilder.h \
+    \
+    ../hugo/heheader.h \
+    ../hugo/htokens.h
+
+SOURCES += \
+    ../src/hgamebuilder.cc \
+    ../src/mkgamemain.cc
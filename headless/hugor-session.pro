@@ -0,0 +1,59 @@
+# Static library for hosting many games in one process. Each game is a
+# HeadlessSession that suspends while it waits for input, so idle games don't
+# hold on to a thread. Needs GCC or Clang and an ELF platform (see
+# src/heqtheader.h.)
+
+TEMPLATE = lib
+CONFIG -= qt app_bundle
+CONFIG += staticlib silent warn_on strict_c++ c++14 thread
+TARGET = hugor-session
+
+# We use warn_off to allow only default warnings, not to supress them all.
+QMAKE_CXXFLAGS_WARN_OFF =
+QMAKE_CFLAGS_WARN_OFF =
+
+*-g++*|*-clang* {
+    # Avoid "unused parameter" warnings with C code.
+    QMAKE_CFLAGS_WARN_ON += -Wno-unused-parameter
+    # Falling off the end of a function that returns a value is never what we
+    # want.
+    QMAKE_CXXFLAGS_WARN_ON += -Werror=return-type
+}
+
+INCLUDEPATH += ../src ../hugo
+OBJECTS_DIR = obj-session
+
+DEFINES += HUGOR HUGOR_SUSPENDABLE
+
+HEADERS += \
+    ../src/hcheckpoint.h \
+    ../src/headlesssession.h \
+    ../src/heheadless.h \
+    ../src/hgameindex.h \
+    ../src/hprofiler.h \
+    ../src/htracer.h \
+    ../src/heqtheader.h \
+    ../src/hugorfile.h \
+    \
+    ../hugo/heheader.h \
+    ../hugo/htokens.h
+
+SOURCES += \
+    ../src/hcheckpoint.cc \
+    ../src/headlesssession.cc \
+    ../src/heheadless.cc \
+    ../src/hgameindex.cc \
+    ../src/hprofiler.cc \
+    ../src/htokens.c \
+    ../src/htracer.cc \
+    \
+    ../hugo/he.c \
+    ../hugo/hebuffer.c \
+    ../hugo/heexpr.c \
+    ../hugo/hemisc.c \
+    ../hugo/heobject.c \
+    ../hugo/heparse.c \
+    ../hugo/heres.c \
+    ../hugo/herun.c \
+    ../hugo/heset.c \
+    ../hugo/stringfn.c
@@ -54,10 +54,10 @@ const int pointer_y = 12;
    get the "real" address.  In this way, a 16-bit integer can reference
    64K * 16 = 1024K of memory.
 */
-int address_scale = 16;
+HUGO_TLS int address_scale = 16;
 
-static char **my_argv = NULL;
-char program_path[MAXPATH] = "";
+static HUGO_TLS char **my_argv = NULL;
+HUGO_TLS char program_path[MAXPATH] = "";
 
 void MakeProgramPath(char *path);
 
@@ -104,6 +104,7 @@ int he_main(int argc, char *argv[])
 	gameseg = 0;
 
 	LoadGame();
+	HUGO_LOADED_HOOK();
 
 #if defined (DEBUGGER)
 	LoadDebuggableFile();
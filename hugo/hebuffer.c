@@ -42,15 +42,15 @@ NOTES:	All TB_*() calls are done in individual units, i.e., in
 #define TB_NONE (-1)
 #define WINDOW_CELL " _win"
 
-char allow_text_selection = true;
+HUGO_TLS char allow_text_selection = true;
 
-int tb_first_used;		/* indexes */
-int tb_first_unused;
-int tb_last_used;
-int tb_last_unused;
+HUGO_TLS int tb_first_used;		/* indexes */
+HUGO_TLS int tb_first_unused;
+HUGO_TLS int tb_last_used;
+HUGO_TLS int tb_last_unused;
 
-int tb_used = 0;		/* counts */
-int tb_unused;
+HUGO_TLS int tb_used = 0;		/* counts */
+HUGO_TLS int tb_unused;
 
 typedef struct
 {
@@ -61,9 +61,9 @@ typedef struct
 	int font, fcolor, bgcolor;
 #endif
 } tb_list_struct;
-tb_list_struct tb_list[MAX_TEXTBUFFER_COUNT];
+HUGO_TLS tb_list_struct tb_list[MAX_TEXTBUFFER_COUNT];
 
-int tb_selected;
+HUGO_TLS int tb_selected;
 
 
 /* TB_Init()
@@ -414,7 +414,7 @@ char *TB_FindWord(int x, int y)
 		if (x >= tb_list[i].left && x <=tb_list[i].right &&
 			y >= tb_list[i].top && y <= tb_list[i].bottom)
 		{
-			static char buf[255];
+			static HUGO_TLS char buf[255];
 			char instring = false;
 			int n = 0, len;
 			char *w = tb_list[i].data;
@@ -28,21 +28,21 @@ void TrimExpr(int ptr);
 
 #if defined (DEBUG_EXPR_EVAL)
 void PrintExpr(void);
-int exprt = true;
+HUGO_TLS int exprt = true;
 #endif
 
 
 #define MAX_EVAL_ELEMENTS 256
 
-int eval[MAX_EVAL_ELEMENTS];		/* expression components           */
-int evalcount;                          /* # of expr. components           */
-int var[MAXLOCALS+MAXGLOBALS];		/* variables                       */
-int incdec;				/* value is being incremented/dec. */
-char getaddress = 0;                    /* true when finding &routine      */
-char inexpr = 0;                        /* true when in expression         */
-char inobj = 0;                         /* true when in object compound    */
+HUGO_TLS int eval[MAX_EVAL_ELEMENTS];		/* expression components           */
+HUGO_TLS int evalcount;                          /* # of expr. components           */
+HUGO_TLS int var[MAXLOCALS+MAXGLOBALS];		/* variables                       */
+HUGO_TLS int incdec;				/* value is being incremented/dec. */
+HUGO_TLS char getaddress = 0;                    /* true when finding &routine      */
+HUGO_TLS char inexpr = 0;                        /* true when in expression         */
+HUGO_TLS char inobj = 0;                         /* true when in object compound    */
 
-int last_precedence;
+HUGO_TLS int last_precedence;
 
 
 /* EVALEXPR
@@ -629,12 +629,16 @@ int GetVal()
 		}
 
 		case SAVE_T:
+			HUGO_TRACE_BEGIN("save");
 			val = RunSave();
+			HUGO_TRACE_END("save");
 			codeptr++;
 			break;
 
 		case RESTORE_T:
+			HUGO_TRACE_BEGIN("restore");
 			val = RunRestore();
+			HUGO_TRACE_END("restore");
 			codeptr++;
 			break;
 
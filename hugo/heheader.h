@@ -668,6 +668,73 @@ extern void PrintFatalError(char *a);
 #define HUGO_FOPEN fopen
 #endif
 
+/* Called by RunRoutine() before every statement, with the address of the
+   block being run. Ports use it to bound how long a game can run without
+   asking for input. */
+#if !defined (HUGO_STATEMENT_HOOK)
+#define HUGO_STATEMENT_HOOK(addr)
+#endif
+
+/* Called by RunRoutine() when it starts running a block of code, with <call>
+   true if the block is a routine being called rather than, e.g., the body of
+   a window statement; when it leaves the block; and with each token it
+   executes.  Ports use them for profiling. */
+#if !defined (HUGO_ENTER_HOOK)
+#define HUGO_ENTER_HOOK(addr, call)
+#endif
+#if !defined (HUGO_LEAVE_HOOK)
+#define HUGO_LEAVE_HOOK(addr)
+#endif
+#if !defined (HUGO_TOKEN_HOOK)
+#define HUGO_TOKEN_HOOK(t)
+#endif
+
+/* Mark the start and end of something the engine does that may take a
+   while, like looking up a resource or saving a game.  Ports use them for
+   tracing; <name> is a string literal. */
+#if !defined (HUGO_TRACE_BEGIN)
+#define HUGO_TRACE_BEGIN(name)
+#endif
+#if !defined (HUGO_TRACE_END)
+#define HUGO_TRACE_END(name)
+#endif
+
+/* Called by PlayMusic(), PlaySample() and PlayVideo() once they know which
+   resource to play, with the resource type (MUSIC_T, SOUND_T or VIDEO_T),
+   before the resource is looked up.  Called by he_main() after LoadGame().
+   Ports use them to start their media backends only when a game needs
+   them. */
+#if !defined (HUGO_MEDIA_HOOK)
+#define HUGO_MEDIA_HOOK(restype)
+#endif
+#if !defined (HUGO_LOADED_HOOK)
+#define HUGO_LOADED_HOOK()
+#endif
+
+/* Ports can keep an index of the game to find things faster than by
+   scanning for them.  HUGO_FINDWORD_HOOK(a, &ptr, &i) returns true and sets
+   ptr to the dictionary address of <a> if it knows it; otherwise it may
+   advance ptr and i past the dictionary entries <a> is known not to be
+   among.  HUGO_VERB_HOOK(word, ptr) moves ptr ahead in the grammar table to
+   the next verb header that may match <word>.  HUGO_PROPADDR_HOOK(obj, p,
+   &ptr) returns true and sets ptr to what PropAddr(obj, p, 0) returns, if
+   it knows it. */
+#if !defined (HUGO_FINDWORD_HOOK)
+#define HUGO_FINDWORD_HOOK(a, ptr, i) 0
+#endif
+#if !defined (HUGO_VERB_HOOK)
+#define HUGO_VERB_HOOK(word, ptr)
+#endif
+#if !defined (HUGO_PROPADDR_HOOK)
+#define HUGO_PROPADDR_HOOK(obj, p, ptr) 0
+#endif
+
+/* Storage class of the engine's global state. Ports that run more than one
+   engine per process define this to make the state thread-local. */
+#if !defined (HUGO_TLS)
+#define HUGO_TLS
+#endif
+
 #ifndef HUGO_INLINE
 #define NO_INLINE_MEM_FUNCTIONS
 #define HUGO_INLINE static
@@ -927,12 +994,15 @@ int he_main(int argc, char *argv[]);
 #endif
 void Banner(void);
 
-extern int address_scale;
-extern char program_path[];
+extern HUGO_TLS int address_scale;
+extern HUGO_TLS char program_path[];
 
 
 /* hebuffer.c */
 #ifdef USE_TEXTBUFFER
+#ifndef MAX_TEXTBUFFER_COUNT
+#define MAX_TEXTBUFFER_COUNT 1000
+#endif
 void TB_Init(void);
 int TB_AddWord(char *w, int, int, int, int);
 void TB_Remove(int n);
@@ -944,8 +1014,9 @@ int TB_FirstCell(void);
 int TB_AddWin(int, int, int, int);
 #endif
 
-extern int tb_selected;
-extern char allow_text_selection;
+extern HUGO_TLS int tb_selected;
+extern HUGO_TLS int tb_used;
+extern HUGO_TLS char allow_text_selection;
 #endif
 
 
@@ -956,11 +1027,11 @@ int Increment(int v, char inctype);
 char IsIncrement(long addr);
 void SetupExpr(void);
 
-extern int var[];
-extern int incdec;
-extern char getaddress;
-extern char inexpr;
-extern char inobj;
+extern HUGO_TLS int var[];
+extern HUGO_TLS int incdec;
+extern HUGO_TLS char getaddress;
+extern HUGO_TLS char inexpr;
+extern HUGO_TLS char inobj;
 
 
 /* hemisc.c */
@@ -998,75 +1069,75 @@ char SpecialChar(char *a, int *i);
 HUGO_FILE TrytoOpen(char *f, char *p, char *d);
 int Undo(void);
 
-extern int game_version;
-extern int object_size;
-extern HUGO_FILE game;
-extern HUGO_FILE script;
-extern HUGO_FILE save;
-extern HUGO_FILE playback;
-extern HUGO_FILE record;
-extern HUGO_FILE io; extern char ioblock; extern char ioerror;
-extern char gamefile[];
-extern char gamepath[];
+extern HUGO_TLS int game_version;
+extern HUGO_TLS int object_size;
+extern HUGO_TLS HUGO_FILE game;
+extern HUGO_TLS HUGO_FILE script;
+extern HUGO_TLS HUGO_FILE save;
+extern HUGO_TLS HUGO_FILE playback;
+extern HUGO_TLS HUGO_FILE record;
+extern HUGO_TLS HUGO_FILE io; extern HUGO_TLS char ioblock; extern HUGO_TLS char ioerror;
+extern HUGO_TLS char gamefile[];
+extern HUGO_TLS char gamepath[];
 #if !defined (GLK)
-extern char scriptfile[];
-extern char savefile[];
-extern char recordfile[];
+extern HUGO_TLS char scriptfile[];
+extern HUGO_TLS char savefile[];
+extern HUGO_TLS char recordfile[];
 #endif
-extern char id[];
-extern char serial[];
-extern unsigned int codestart;
-extern unsigned int objtable;
-extern unsigned int eventtable;
-extern unsigned int proptable;
-extern unsigned int arraytable;
-extern unsigned int dicttable;
-extern unsigned int syntable;
-extern unsigned int initaddr;
-extern unsigned int mainaddr;
-extern unsigned int parseaddr;
-extern unsigned int parseerroraddr;
-extern unsigned int findobjectaddr;
-extern unsigned int endgameaddr;
-extern unsigned int speaktoaddr;
-extern unsigned int performaddr;
-extern int objects;
-extern int events;
-extern int dictcount;
-extern int syncount;
+extern HUGO_TLS char id[];
+extern HUGO_TLS char serial[];
+extern HUGO_TLS unsigned int codestart;
+extern HUGO_TLS unsigned int objtable;
+extern HUGO_TLS unsigned int eventtable;
+extern HUGO_TLS unsigned int proptable;
+extern HUGO_TLS unsigned int arraytable;
+extern HUGO_TLS unsigned int dicttable;
+extern HUGO_TLS unsigned int syntable;
+extern HUGO_TLS unsigned int initaddr;
+extern HUGO_TLS unsigned int mainaddr;
+extern HUGO_TLS unsigned int parseaddr;
+extern HUGO_TLS unsigned int parseerroraddr;
+extern HUGO_TLS unsigned int findobjectaddr;
+extern HUGO_TLS unsigned int endgameaddr;
+extern HUGO_TLS unsigned int speaktoaddr;
+extern HUGO_TLS unsigned int performaddr;
+extern HUGO_TLS int objects;
+extern HUGO_TLS int events;
+extern HUGO_TLS int dictcount;
+extern HUGO_TLS int syncount;
 #if !defined (COMPILE_V25)
-extern char context_command[][64];
-extern int context_commands;
+extern HUGO_TLS char context_command[][64];
+extern HUGO_TLS int context_commands;
 #endif
-extern unsigned char *mem;
-extern int loaded_in_memory;
-extern unsigned int defseg;
-extern unsigned int gameseg;
-extern long codeptr;
-extern long codeend;
-extern char pbuffer[];
-extern int currentpos;
-extern int currentline;
-extern int full;
-extern signed char fcolor, bgcolor, icolor, default_bgcolor;
-extern int currentfont;
-extern char capital;
-extern unsigned int textto;
-extern int SCREENWIDTH, SCREENHEIGHT;
-extern int physical_windowwidth, physical_windowheight,
+extern HUGO_TLS unsigned char *mem;
+extern HUGO_TLS int loaded_in_memory;
+extern HUGO_TLS unsigned int defseg;
+extern HUGO_TLS unsigned int gameseg;
+extern HUGO_TLS long codeptr;
+extern HUGO_TLS long codeend;
+extern HUGO_TLS char pbuffer[];
+extern HUGO_TLS int currentpos;
+extern HUGO_TLS int currentline;
+extern HUGO_TLS int full;
+extern HUGO_TLS signed char fcolor, bgcolor, icolor, default_bgcolor;
+extern HUGO_TLS int currentfont;
+extern HUGO_TLS char capital;
+extern HUGO_TLS unsigned int textto;
+extern HUGO_TLS int SCREENWIDTH, SCREENHEIGHT;
+extern HUGO_TLS int physical_windowwidth, physical_windowheight,
 	physical_windowtop, physical_windowleft,
 	physical_windowbottom, physical_windowright;
-extern int inwindow;
-extern int charwidth, lineheight, FIXEDCHARWIDTH, FIXEDLINEHEIGHT;
-extern int current_text_x, current_text_y;
-extern int undostack[][5];
-extern int undoptr;
-extern int undoturn;
-extern char undoinvalid;
-extern char undorecord;
+extern HUGO_TLS int inwindow;
+extern HUGO_TLS int charwidth, lineheight, FIXEDCHARWIDTH, FIXEDLINEHEIGHT;
+extern HUGO_TLS int current_text_x, current_text_y;
+extern HUGO_TLS int undostack[][5];
+extern HUGO_TLS int undoptr;
+extern HUGO_TLS int undoturn;
+extern HUGO_TLS char undoinvalid;
+extern HUGO_TLS char undorecord;
 #ifdef USE_SMARTFORMATTING
-extern int smartformatting;
-extern char leftquote;
+extern HUGO_TLS int smartformatting;
+extern HUGO_TLS char leftquote;
 #endif
 
 /* heobject.c */
@@ -1086,9 +1157,9 @@ int Sibling(int obj);
 int TestAttribute(int obj, int attr, int nattr);
 int Youngest(int obj);
 
-extern int display_object;
-extern char display_needs_repaint;
-extern int display_pointer_x, display_pointer_y;
+extern HUGO_TLS int display_object;
+extern HUGO_TLS char display_needs_repaint;
+extern HUGO_TLS int display_pointer_x, display_pointer_y;
 
 
 /* heparse.c */
@@ -1105,36 +1176,36 @@ void RemoveWord(int a);
 void SeparateWords(void);
 int ValidObj(int obj);
 
-extern char buffer[];
-extern char full_buffer;
-extern char errbuf[];
-extern char line[];
-extern int words; extern char *word[];
-extern unsigned int wd[], parsed_number;
-extern char parse_called_twice;
-extern char punc_string[];
-extern signed char remaining;
-extern char parseerr[];
-extern char parsestr[];
-extern char xverb;
-extern unsigned int grammaraddr;
-extern char *obj_parselist;
-extern int domain, odomain;
-extern int objlist[];
-extern char objcount;
-extern char parse_allflag;
-extern struct pobject_structure pobjlist[];
-extern int pobjcount;
-extern int pobj;
-extern int obj_match_state;
-extern char object_is_number;
-extern unsigned int objgrammar;
-extern int objstart;
-extern int objfinish;
-extern char addflag;
-extern int speaking;
-extern char oops[];
-extern int oopscount;
+extern HUGO_TLS char buffer[];
+extern HUGO_TLS char full_buffer;
+extern HUGO_TLS char errbuf[];
+extern HUGO_TLS char line[];
+extern HUGO_TLS int words; extern HUGO_TLS char *word[];
+extern HUGO_TLS unsigned int wd[], parsed_number;
+extern HUGO_TLS char parse_called_twice;
+extern HUGO_TLS char punc_string[];
+extern HUGO_TLS signed char remaining;
+extern HUGO_TLS char parseerr[];
+extern HUGO_TLS char parsestr[];
+extern HUGO_TLS char xverb;
+extern HUGO_TLS unsigned int grammaraddr;
+extern HUGO_TLS char *obj_parselist;
+extern HUGO_TLS int domain, odomain;
+extern HUGO_TLS int objlist[];
+extern HUGO_TLS char objcount;
+extern HUGO_TLS char parse_allflag;
+extern HUGO_TLS struct pobject_structure pobjlist[];
+extern HUGO_TLS int pobjcount;
+extern HUGO_TLS int pobj;
+extern HUGO_TLS int obj_match_state;
+extern HUGO_TLS char object_is_number;
+extern HUGO_TLS unsigned int objgrammar;
+extern HUGO_TLS int objstart;
+extern HUGO_TLS int objfinish;
+extern HUGO_TLS char addflag;
+extern HUGO_TLS int speaking;
+extern HUGO_TLS char oops[];
+extern HUGO_TLS int oopscount;
 
 
 /* heres.c */
@@ -1144,13 +1215,14 @@ void PlayMusic(void);
 void PlaySample(void);
 void PlayVideo(void);
 
-extern HUGO_FILE resource_file;
-extern char loaded_filename[];
-extern char loaded_resname[];
-extern char resource_type;
+extern HUGO_TLS HUGO_FILE resource_file;
+extern HUGO_TLS char loaded_filename[];
+extern HUGO_TLS char loaded_resname[];
+extern HUGO_TLS char resource_type;
 
 
 /* herun.c */
+int RestoreGameData(void);
 void RunDo(void);
 void RunEvents(void);
 void RunGame(void);
@@ -1167,25 +1239,27 @@ void RunSet(int gotvalue);
 int RunString(void);
 int RunSystem(void);
 void RunWindow(void);
-
-extern char during_player_input;
-extern int passlocal[];
-extern int arguments_passed;
-extern int ret; extern char retflag;
-extern char game_reset;
-extern struct CODE_BLOCK code_block[];
-extern int stack_depth;
-extern int tail_recursion;
-extern long tail_recursion_addr;
-extern int last_window_top, last_window_bottom,
+int SaveGameData(void);
+
+extern HUGO_TLS char during_player_input;
+extern HUGO_TLS char fresh_input;
+extern HUGO_TLS int passlocal[];
+extern HUGO_TLS int arguments_passed;
+extern HUGO_TLS int ret; extern HUGO_TLS char retflag;
+extern HUGO_TLS char game_reset;
+extern HUGO_TLS struct CODE_BLOCK code_block[];
+extern HUGO_TLS int stack_depth;
+extern HUGO_TLS int tail_recursion;
+extern HUGO_TLS long tail_recursion_addr;
+extern HUGO_TLS int last_window_top, last_window_bottom,
 	last_window_left, last_window_right;
-extern char just_left_window;
+extern HUGO_TLS char just_left_window;
 
 
 /* heset.c */
-extern char game_title[];
-extern char arrexpr;
-extern char multiprop;
+extern HUGO_TLS char game_title[];
+extern HUGO_TLS char arrexpr;
+extern HUGO_TLS char multiprop;
 
 
 /* stringfn.c */
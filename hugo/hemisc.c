@@ -40,100 +40,100 @@ void hugo_stopvideo(void);
    version number of the game*10 + the revision number.  The object
    size of pre-v2.2 games was only 12 bytes.
 */
-int game_version;
-int object_size = 24;
+HUGO_TLS int game_version;
+HUGO_TLS int object_size = 24;
 
 /* File pointers, etc. */
-HUGO_FILE game = NULL;
-HUGO_FILE script = NULL;
-HUGO_FILE save = NULL;
-HUGO_FILE record = NULL;
-HUGO_FILE playback = NULL;
-HUGO_FILE io = NULL;     char ioblock = 0; char ioerror = 0;
-char gamefile[MAXPATH];
-char gamepath[MAXPATH];
+HUGO_TLS HUGO_FILE game = NULL;
+HUGO_TLS HUGO_FILE script = NULL;
+HUGO_TLS HUGO_FILE save = NULL;
+HUGO_TLS HUGO_FILE record = NULL;
+HUGO_TLS HUGO_FILE playback = NULL;
+HUGO_TLS HUGO_FILE io = NULL;     HUGO_TLS char ioblock = 0; HUGO_TLS char ioerror = 0;
+HUGO_TLS char gamefile[MAXPATH];
+HUGO_TLS char gamepath[MAXPATH];
 #if !defined (GLK)
-char scriptfile[MAXPATH];
-char savefile[MAXPATH];
-char recordfile[MAXPATH];
+HUGO_TLS char scriptfile[MAXPATH];
+HUGO_TLS char savefile[MAXPATH];
+HUGO_TLS char recordfile[MAXPATH];
 #endif
 
 /* Header information */
-char id[3];
-char serial[9];
-unsigned int codestart;			/* start of executable code	*/
-unsigned int objtable;                	/* object table			*/
-unsigned int eventtable;              	/* event table			*/
-unsigned int proptable;               	/* property table		*/
-unsigned int arraytable;              	/* array data table		*/
-unsigned int dicttable;               	/* dictionary			*/
-unsigned int syntable;                	/* synonyms			*/
-unsigned int initaddr;                	/* "Init" routine		*/
-unsigned int mainaddr;                	/* "Main"			*/
-unsigned int parseaddr;               	/* "Parse"			*/
-unsigned int parseerroraddr;          	/* "ParseError"			*/
-unsigned int findobjectaddr;          	/* "FindObject"			*/
-unsigned int endgameaddr;             	/* "Endgame"			*/
-unsigned int speaktoaddr;             	/* "SpeakTo"			*/
-unsigned int performaddr;		/* "Perform"			*/
+HUGO_TLS char id[3];
+HUGO_TLS char serial[9];
+HUGO_TLS unsigned int codestart;			/* start of executable code	*/
+HUGO_TLS unsigned int objtable;                	/* object table			*/
+HUGO_TLS unsigned int eventtable;              	/* event table			*/
+HUGO_TLS unsigned int proptable;               	/* property table		*/
+HUGO_TLS unsigned int arraytable;              	/* array data table		*/
+HUGO_TLS unsigned int dicttable;               	/* dictionary			*/
+HUGO_TLS unsigned int syntable;                	/* synonyms			*/
+HUGO_TLS unsigned int initaddr;                	/* "Init" routine		*/
+HUGO_TLS unsigned int mainaddr;                	/* "Main"			*/
+HUGO_TLS unsigned int parseaddr;               	/* "Parse"			*/
+HUGO_TLS unsigned int parseerroraddr;          	/* "ParseError"			*/
+HUGO_TLS unsigned int findobjectaddr;          	/* "FindObject"			*/
+HUGO_TLS unsigned int endgameaddr;             	/* "Endgame"			*/
+HUGO_TLS unsigned int speaktoaddr;             	/* "SpeakTo"			*/
+HUGO_TLS unsigned int performaddr;		/* "Perform"			*/
 
 /* Totals */
-int objects;
-int events;
-int dictcount;		/* dictionary entries */
-int syncount;		/* synonyms, etc.     */
+HUGO_TLS int objects;
+HUGO_TLS int events;
+HUGO_TLS int dictcount;		/* dictionary entries */
+HUGO_TLS int syncount;		/* synonyms, etc.     */
 
 #if !defined (COMPILE_V25)
-char context_command[MAX_CONTEXT_COMMANDS][64];
-int context_commands;
+HUGO_TLS char context_command[MAX_CONTEXT_COMMANDS][64];
+HUGO_TLS int context_commands;
 #endif
 
 /* Loaded memory image */
-unsigned char *mem = NULL;		/* the memory buffer       */
-int loaded_in_memory = true;		/* i.e., the text bank     */
-unsigned int defseg;			/* holds segment indicator */
-unsigned int gameseg;			/* code segment            */
-long codeptr;                           /* code pointer            */
-long codeend;                           /* end of loaded code      */
+HUGO_TLS unsigned char *mem = NULL;		/* the memory buffer       */
+HUGO_TLS int loaded_in_memory = true;		/* i.e., the text bank     */
+HUGO_TLS unsigned int defseg;			/* holds segment indicator */
+HUGO_TLS unsigned int gameseg;			/* code segment            */
+HUGO_TLS long codeptr;                           /* code pointer            */
+HUGO_TLS long codeend;                           /* end of loaded code      */
 
 /* Text output */
-char pbuffer[MAXBUFFER*2+1];            /* print buffer for line-wrapping  */
-int currentpos = 0;                     /* column position (pixel or char) */
-int currentline = 0;                    /* row number (line)               */
-int full = 0;                           /* page counter for PromptMore     */
-signed char fcolor = 16,		/* default fore/background colors  */
+HUGO_TLS char pbuffer[MAXBUFFER*2+1];            /* print buffer for line-wrapping  */
+HUGO_TLS int currentpos = 0;                     /* column position (pixel or char) */
+HUGO_TLS int currentline = 0;                    /* row number (line)               */
+HUGO_TLS int full = 0;                           /* page counter for PromptMore     */
+HUGO_TLS signed char fcolor = 16,		/* default fore/background colors  */
 	bgcolor = 17,			/* (16 = default foreground,	   */
 	icolor = -1;			/*  17 = default background)	   */
-signed char default_bgcolor = 17;	/* default for screen background   */
-int currentfont = NORMAL_FONT;		/* current font bitmasks           */
-char capital = 0;			/* if next letter is to be capital */
-unsigned int textto = 0;		/* for printing to an array        */
-int SCREENWIDTH, SCREENHEIGHT;		/* screen dimensions               */
+HUGO_TLS signed char default_bgcolor = 17;	/* default for screen background   */
+HUGO_TLS int currentfont = NORMAL_FONT;		/* current font bitmasks           */
+HUGO_TLS char capital = 0;			/* if next letter is to be capital */
+HUGO_TLS unsigned int textto = 0;		/* for printing to an array        */
+HUGO_TLS int SCREENWIDTH, SCREENHEIGHT;		/* screen dimensions               */
 					/*   (in pixels or characters)     */
-int physical_windowwidth,		/* "physical_..." measurements	   */
+HUGO_TLS int physical_windowwidth,		/* "physical_..." measurements	   */
 	physical_windowheight,		/*   are in pixels (or characters) */
 	physical_windowtop, physical_windowleft,
 	physical_windowbottom, physical_windowright;
-int inwindow = 0;
-int charwidth, lineheight, FIXEDCHARWIDTH, FIXEDLINEHEIGHT;
-int current_text_x = 0, current_text_y = 0;
+HUGO_TLS int inwindow = 0;
+HUGO_TLS int charwidth, lineheight, FIXEDCHARWIDTH, FIXEDLINEHEIGHT;
+HUGO_TLS int current_text_x = 0, current_text_y = 0;
 
 #ifdef USE_SMARTFORMATTING
-int smartformatting = true;
-char leftquote = true;
+HUGO_TLS int smartformatting = true;
+HUGO_TLS char leftquote = true;
 #endif
 
-char skipping_more = false;
+HUGO_TLS char skipping_more = false;
 
 /* SaveUndo() and Undo() */
-int undostack[MAXUNDO][5];		/* for saving undo information     */
-int undoptr = 0;                        /* number of operations undoable   */
-int undoturn = 0;                       /* number of operations this turn  */
-char undoinvalid = 0;                   /* for start of game, and restarts */
-char undorecord = 0;                    /* true when recording             */
+HUGO_TLS int undostack[MAXUNDO][5];		/* for saving undo information     */
+HUGO_TLS int undoptr = 0;                        /* number of operations undoable   */
+HUGO_TLS int undoturn = 0;                       /* number of operations this turn  */
+HUGO_TLS char undoinvalid = 0;                   /* for start of game, and restarts */
+HUGO_TLS char undorecord = 0;                    /* true when recording             */
 
 #ifdef USE_TEXTBUFFER
-static int bufferbreak = 0, bufferbreaklen = 0;
+static HUGO_TLS int bufferbreak = 0, bufferbreaklen = 0;
 #endif
 
 /* AP
@@ -148,10 +148,10 @@ void AP (char *a)
 	char c = 0;			/* current character */
 	char lastc = 0;			/* for smart formatting */
 
-	static int lastfcolor = 16, lastbgcolor = 17;
-	static int lastfont = NORMAL_FONT;
-	static int thisline = 0;	/* width in pixels or characters */
-	static int linebreaklen = 0, linebreak = 0;
+	static HUGO_TLS int lastfcolor = 16, lastbgcolor = 17;
+	static HUGO_TLS int lastfont = NORMAL_FONT;
+	static HUGO_TLS int thisline = 0;	/* width in pixels or characters */
+	static HUGO_TLS int linebreaklen = 0, linebreak = 0;
 	int tempfont;
 	char printed_something = false;
 #ifdef USE_TEXTBUFFER
@@ -1089,7 +1089,7 @@ void GetCommand(void)
 
 char *GetString(long addr)
 {
-	static char a[256];
+	static HUGO_TLS char a[256];
 	int i, length;
 
 	length = Peek(addr);
@@ -1111,7 +1111,7 @@ char *GetString(long addr)
 
 char *GetText(long textaddr)
 {
-	static char g[1025];
+	static HUGO_TLS char g[1025];
 	int i, a;
 	int tdatal, tdatah, tlen;       /* low byte, high byte, length */
 
@@ -1156,7 +1156,7 @@ char *GetText(long textaddr)
 
 char *GetWord(unsigned int w)
 {
-	static char *b;
+	static HUGO_TLS char *b;
 	unsigned short a;
 
 	a = w;
@@ -1613,7 +1613,7 @@ void PokeWord(unsigned int a, unsigned int v)
 
 char *PrintHex(long a)
 {
-	static char hex[7];
+	static HUGO_TLS char hex[7];
 	int h = 0;
 
 	strcpy(hex, "");
@@ -2601,8 +2601,8 @@ CheckUndoFailed:
 
 #if defined (BUILD_RANDOM)
 
-static unsigned int rand_table[55];	/* state for the RNG */
-static int rand_index1, rand_index2;
+static HUGO_TLS unsigned int rand_table[55];	/* state for the RNG */
+static HUGO_TLS int rand_index1, rand_index2;
 
 int random()
 {
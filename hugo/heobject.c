@@ -26,9 +26,9 @@
 int CheckObjectRange(int obj);
 #endif
 
-int display_object = -1;		/* i.e., non-existent (yet) */
-char display_needs_repaint = 0;		/* for display object       */
-int display_pointer_x = 0, display_pointer_y = 0;
+HUGO_TLS int display_object = -1;		/* i.e., non-existent (yet) */
+HUGO_TLS char display_needs_repaint = 0;		/* for display object       */
+HUGO_TLS int display_pointer_x = 0, display_pointer_y = 0;
 
 
 /* CHECKOBJECTRANGE
@@ -615,6 +615,12 @@ unsigned int PropAddr(int obj, int p, unsigned int offset)
 	*/
 	if (obj<0 || obj>=objects) return 0;
 
+	if (!offset && HUGO_PROPADDR_HOOK(obj, p, &ptr))
+	{
+		defseg = gameseg;
+		return ptr;
+	}
+
 	defseg = objtable;
 
 	/* Position in the property table...
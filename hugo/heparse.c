@@ -56,53 +56,53 @@ int GetVal(void);			/* from heexpr.c */
 
 #define STARTS_AS_NUMBER(a) (((a[0]>='0' && a[0]<='9') || a[0]=='-')?1:0)
 
-char buffer[MAXBUFFER+MAXWORDS];        /* input buffer                    */
-char errbuf[MAXBUFFER+1];               /* last invalid input              */
-char line[1025];                        /* line buffer                     */
-
-int words = 0;                          /* parsed word count               */
-char *word[MAXWORDS+1];                 /* breakdown into words            */
-unsigned int wd[MAXWORDS+1];            /*     "      "   dict. entries    */
-unsigned int parsed_number;             /* needed for numbers in input	   */
-
-signed char remaining = 0;              /* multiple commands in input      */
-char parseerr[MAXBUFFER+1];             /* for passing to RunPrint, etc.   */
-char parsestr[MAXBUFFER+1];             /* for passing quoted string       */
-char xverb;                             /* flag; 0 = regular verb          */
-char starts_with_verb;			/* input line; 0 = no verb word    */
-unsigned int grammaraddr;             	/* address in grammar              */
-char *obj_parselist = NULL;             /* objects with noun/adjective     */
-int domain, odomain;                  	/* of object(s)                    */
-int objlist[MAXOBJLIST];                /* for objects of verb             */
-char objcount;                          /* of objlist                      */
-char parse_allflag = false;             /* for "all" in MatchObject()      */
-struct pobject_structure
+HUGO_TLS char buffer[MAXBUFFER+MAXWORDS];        /* input buffer                    */
+HUGO_TLS char errbuf[MAXBUFFER+1];               /* last invalid input              */
+HUGO_TLS char line[1025];                        /* line buffer                     */
+
+HUGO_TLS int words = 0;                          /* parsed word count               */
+HUGO_TLS char *word[MAXWORDS+1];                 /* breakdown into words            */
+HUGO_TLS unsigned int wd[MAXWORDS+1];            /*     "      "   dict. entries    */
+HUGO_TLS unsigned int parsed_number;             /* needed for numbers in input	   */
+
+HUGO_TLS signed char remaining = 0;              /* multiple commands in input      */
+HUGO_TLS char parseerr[MAXBUFFER+1];             /* for passing to RunPrint, etc.   */
+HUGO_TLS char parsestr[MAXBUFFER+1];             /* for passing quoted string       */
+HUGO_TLS char xverb;                             /* flag; 0 = regular verb          */
+HUGO_TLS char starts_with_verb;			/* input line; 0 = no verb word    */
+HUGO_TLS unsigned int grammaraddr;             	/* address in grammar              */
+HUGO_TLS char *obj_parselist = NULL;             /* objects with noun/adjective     */
+HUGO_TLS int domain, odomain;                  	/* of object(s)                    */
+HUGO_TLS int objlist[MAXOBJLIST];                /* for objects of verb             */
+HUGO_TLS char objcount;                          /* of objlist                      */
+HUGO_TLS char parse_allflag = false;             /* for "all" in MatchObject()      */
+HUGO_TLS struct pobject_structure
 	pobjlist[MAXPOBJECTS];          /* for possible objects            */
-int pobjcount;                          /* of pobjlist                     */
-int pobj;                               /* last remaining suspect          */
-int obj_match_state;                    /* see MatchCommand() for details  */
-char objword_cache[MAXWORDS];           /* for MatchWord() xobject, etc.   */
-char object_is_number;                  /* number used in player command   */
-unsigned int objgrammar;                /* for 2nd pass                    */
-int objstart;                           /*  "   "   "                      */
-int objfinish;                          /*  "   "   "                      */
-char addflag;                           /* true if adding to objlist[]     */
-int speaking;                           /* if command is addressed to obj. */
-
-char oops[MAXBUFFER+1];                 /* illegal word                    */
-int oopscount = 0;                      /* # of corrections in a row       */
-
-char parse_called_twice;
-char reparse_everything;
-char punc_string[64];                   /* punctuation string */
-
-char full_buffer = false;
-static char recursive_call = false;     /* to MatchObject() */
+HUGO_TLS int pobjcount;                          /* of pobjlist                     */
+HUGO_TLS int pobj;                               /* last remaining suspect          */
+HUGO_TLS int obj_match_state;                    /* see MatchCommand() for details  */
+HUGO_TLS char objword_cache[MAXWORDS];           /* for MatchWord() xobject, etc.   */
+HUGO_TLS char object_is_number;                  /* number used in player command   */
+HUGO_TLS unsigned int objgrammar;                /* for 2nd pass                    */
+HUGO_TLS int objstart;                           /*  "   "   "                      */
+HUGO_TLS int objfinish;                          /*  "   "   "                      */
+HUGO_TLS char addflag;                           /* true if adding to objlist[]     */
+HUGO_TLS int speaking;                           /* if command is addressed to obj. */
+
+HUGO_TLS char oops[MAXBUFFER+1];                 /* illegal word                    */
+HUGO_TLS int oopscount = 0;                      /* # of corrections in a row       */
+
+HUGO_TLS char parse_called_twice;
+HUGO_TLS char reparse_everything;
+HUGO_TLS char punc_string[64];                   /* punctuation string */
+
+HUGO_TLS char full_buffer = false;
+static HUGO_TLS char recursive_call = false;     /* to MatchObject() */
 
 /* Necessary for proper disambiguation when addressing a character;
    i.e., when 'held' doesn't refer to held by the player, etc.
 */
-int parse_location;	/* usually var[location] */
+HUGO_TLS int parse_location;	/* usually var[location] */
 
 
 /* ADDALLOBJECTS
@@ -433,7 +433,14 @@ unsigned int FindWord(char *a)
 
 	defseg = dicttable;
 
-	for (i=1; i<=dictcount; i++)
+	i = 1;
+	if (HUGO_FINDWORD_HOOK(a, &ptr, &i))
+	{
+		defseg = gameseg;
+		return ptr;
+	}
+
+	for (; i<=dictcount; i++)
 	{
 		if (alen==(p = Peek(ptr+2)) && (unsigned char)(MEM(dicttable*16L+ptr+3)-CHAR_TRANSLATION)==(unsigned char)a[0])
 		{
@@ -676,6 +683,8 @@ MatchVerb:
 	var[self] = 0;
 	var[verbroutine] = 0;
 
+	HUGO_VERB_HOOK(wd[1], ptr);
+
 	while ((a = Peek(ptr)) != 255)
 	{
 		defseg = gameseg;
@@ -743,6 +752,7 @@ MatchVerb:
 
 			/* Otherwise skip over this verb header */
 			ptr += 2 + numverbs * 2;
+			HUGO_VERB_HOOK(wd[1], ptr);
 		}
 
 		/* anything else */
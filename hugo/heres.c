@@ -53,11 +53,11 @@ void hugo_stopvideo(void);
 #define MAX_RES_PATH 255
 #endif
 
-HUGO_FILE resource_file;
-int extra_param;
-char loaded_filename[MAX_RES_PATH];
-char loaded_resname[MAX_RES_PATH];
-char resource_type = 0;
+HUGO_TLS HUGO_FILE resource_file;
+HUGO_TLS int extra_param;
+HUGO_TLS char loaded_filename[MAX_RES_PATH];
+HUGO_TLS char loaded_resname[MAX_RES_PATH];
+HUGO_TLS char resource_type = 0;
 
 
 /* For system_status: */
@@ -86,7 +86,10 @@ void DisplayPicture(void)
 	   the line[] array simply holds the path of the file to be loaded
 	   as a resource
 	*/
-	if (!(reslength = FindResource(filename, resname)))
+	HUGO_TRACE_BEGIN("FindResource");
+	reslength = FindResource(filename, resname);
+	HUGO_TRACE_END("FindResource");
+	if (!reslength)
 		return;
 
 	/* Find out what type of image resource this is */
@@ -120,6 +123,7 @@ void PlayMusic(void)
 	{
 		return;
 	}
+	HUGO_MEDIA_HOOK(MUSIC_T);
 
 	if (extra_param>=0)
 	{
@@ -127,7 +131,10 @@ void PlayMusic(void)
 		hugo_musicvolume(extra_param);
 	}
 
-	if (!(reslength = FindResource(filename, resname)))
+	HUGO_TRACE_BEGIN("FindResource");
+	reslength = FindResource(filename, resname);
+	HUGO_TRACE_END("FindResource");
+	if (!reslength)
 		return;
 
 	/* Find out what type of music resource this is */
@@ -211,6 +218,7 @@ void PlaySample(void)
 	{
 		return;
 	}
+	HUGO_MEDIA_HOOK(SOUND_T);
 
 	if (extra_param>=0)
 	{
@@ -218,7 +226,10 @@ void PlaySample(void)
 		hugo_samplevolume(extra_param);
 	}
 
-	if (!(reslength = FindResource(filename, resname)))
+	HUGO_TRACE_BEGIN("FindResource");
+	reslength = FindResource(filename, resname);
+	HUGO_TRACE_END("FindResource");
+	if (!reslength)
 		return;
 
 	/* Find out what kind of audio sample this is */
@@ -258,6 +269,7 @@ void PlayVideo(void)
 	{
 		return;
 	}
+	HUGO_MEDIA_HOOK(VIDEO_T);
 
 	if (MEM(codeptr-1)==COMMA_T)
 	{
@@ -271,7 +283,10 @@ void PlayVideo(void)
 		volume = extra_param;
 	}
 
-	if (!(reslength = FindResource(filename, resname)))
+	HUGO_TRACE_BEGIN("FindResource");
+	reslength = FindResource(filename, resname);
+	HUGO_TRACE_END("FindResource");
+	if (!reslength)
 		return;
 
 	/* Find out what type of video resource this is */
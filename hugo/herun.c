@@ -22,28 +22,29 @@ extern void hugo_gettimeformatted(char *a);
 #endif
 
 
-int passlocal[MAXLOCALS];		/* locals passed to routine        */
-int arguments_passed;                   /* when calling routine            */
-int ret = 0; char retflag = 0;		/* return value and returning flag */
+HUGO_TLS int passlocal[MAXLOCALS];		/* locals passed to routine        */
+HUGO_TLS int arguments_passed;                   /* when calling routine            */
+HUGO_TLS int ret = 0; HUGO_TLS char retflag = 0;		/* return value and returning flag */
 
-char during_player_input = false;
-char override_full = 0;
+HUGO_TLS char during_player_input = false;
+HUGO_TLS char fresh_input = false;		/* reading a new command           */
+HUGO_TLS char override_full = 0;
 
-char game_reset = false;		/* for restore, undo, etc. */
+HUGO_TLS char game_reset = false;		/* for restore, undo, etc. */
 
-struct CODE_BLOCK code_block[MAXSTACKDEPTH];
-int stack_depth;
-int tail_recursion = 0;
-long tail_recursion_addr = 0;
+HUGO_TLS struct CODE_BLOCK code_block[MAXSTACKDEPTH];
+HUGO_TLS int stack_depth;
+HUGO_TLS int tail_recursion = 0;
+HUGO_TLS long tail_recursion_addr = 0;
 
 /* Used by RunWindow() for setting current window dimensions: */
-int last_window_top, last_window_bottom, last_window_left, last_window_right;
-int lowest_windowbottom = 0,			/* in text lines */
+HUGO_TLS int last_window_top, last_window_bottom, last_window_left, last_window_right;
+HUGO_TLS int lowest_windowbottom = 0,			/* in text lines */
 	physical_lowest_windowbottom;		/* in pixels or text lines */
-char just_left_window = false;
+HUGO_TLS char just_left_window = false;
 	
 /* from heparse.c, for RunEvents() */
-extern int parse_location;
+extern HUGO_TLS int parse_location;
 
 #ifdef PALMOS
 int AutoResume(void);
@@ -151,7 +152,7 @@ void RunEvents(void)
 
 /* RUNGAME */
 
-extern char reparse_everything;		/* from ParseError() in heparse.c */
+extern HUGO_TLS char reparse_everything;		/* from ParseError() in heparse.c */
 
 #if defined (DEBUGGER)
 extern int original_dictcount;
@@ -305,7 +306,9 @@ FreshInput:
 #endif
 						if (!playback)
 						{
+							fresh_input = true;
 							GetCommand();
+							fresh_input = false;
 						}
 						else
 						{
@@ -314,7 +317,9 @@ FreshInput:
 								if (hugo_fclose(playback))
 									FatalError(READ_E);
 								playback = NULL;
+								fresh_input = true;
 								GetCommand();
+								fresh_input = false;
 							}
 							else
 							{
@@ -1538,6 +1543,8 @@ void RunRoutine(long addr)
 
 #endif  /* defined (DEBUGGER) */
 
+	HUGO_ENTER_HOOK(addr, codeptr != addr);
+
 	defseg = gameseg;
 	codeptr = addr;
 
@@ -1550,6 +1557,7 @@ ContinueRunning:
 
 	while (MEM(codeptr) != CLOSE_BRACE_T)   /* until "}" */
 	{
+		HUGO_STATEMENT_HOOK(addr);
 
 #if defined (DEBUGGER)
 		/* Check if we're stepping over, and if we've returned to
@@ -1561,7 +1569,11 @@ ContinueRunning:
 			debugger_interrupt = true;
 		}
 #endif
-		if (var[endflag]) return;
+		if (var[endflag])
+		{
+			HUGO_LEAVE_HOOK(addr);
+			return;
+		}
 
 		null_count = 0;
 
@@ -1671,7 +1683,11 @@ ContinueRunning:
 		*/
 
 		/* Collapsing the RunRoutine() call stack */
-		if (debugger_collapsing) return;
+		if (debugger_collapsing)
+		{
+			HUGO_LEAVE_HOOK(addr);
+			return;
+		}
 
 
 		/* May be necessary to reset this if, for some
@@ -1712,6 +1728,8 @@ ContinueRunning:
 #if defined (DEBUGGER)
 ProcessToken:
 #endif
+		HUGO_TOKEN_HOOK(t);
+
 		switch (t)
 		{
 			/* First process any encoded, non-executable data: */
@@ -2248,11 +2266,17 @@ Writevalloop:
 
 	if (stack_depth<0) stack_depth = 0;
 
-	if (var[endflag]) return;
+	if (var[endflag])
+	{
+		HUGO_LEAVE_HOOK(addr);
+		return;
+	}
 
 
 LeaveRunRoutine:
 
+	HUGO_LEAVE_HOOK(addr);
+
 #if defined (DEBUGGER)
 
 /*
@@ -2689,7 +2713,7 @@ int RunSystem(void)
 	As in 'window [n[, o, p, q]]'.
 */
 
-struct SAVED_WINDOW_DATA
+HUGO_TLS struct SAVED_WINDOW_DATA
 {
 	int left, top, right, bottom;
 	int width, height, charwidth, lineheight;
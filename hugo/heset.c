@@ -18,12 +18,12 @@ unsigned int GetAnonymousFunction(long addr);
 int SetCompound(int t);
 
 #define MAX_GAME_TITLE 64
-char game_title[MAX_GAME_TITLE] = "";
+HUGO_TLS char game_title[MAX_GAME_TITLE] = "";
 
-char arrexpr = 0;                       /* true when assigning array       */
-char multiprop = 0;                     /* true in multiple prop. assign.  */
+HUGO_TLS char arrexpr = 0;                       /* true when assigning array       */
+HUGO_TLS char multiprop = 0;                     /* true in multiple prop. assign.  */
 
-static int set_value = 0;
+static HUGO_TLS int set_value = 0;
 
 
 /* RUNSET
@@ -15,6 +15,16 @@
 #include <string.h>
 #include <ctype.h>
 
+/* Like the engine's state, the temporary strings are per thread when the
+   port asks for it (see heheader.h).
+*/
+#if defined (HUGOR)
+#include "heqtheader.h"
+#endif
+#if !defined (HUGO_TLS)
+#define HUGO_TLS
+#endif
+
 char *Left(char *a, int l);
 char *Ltrim(char *a);
 char *Mid(char *a, int pos, int n);
@@ -48,15 +58,15 @@ char *strupr(char *s);
 */
 
 #ifndef ALLOW_NESTING
-static char tempstring[1025];
+static HUGO_TLS char tempstring[1025];
 #else
 #define NUM_TEMPSTRINGS 2
-static char tempstring[NUM_TEMPSTRINGS][1025];
-static char tempstring_count = 0;
+static HUGO_TLS char tempstring[NUM_TEMPSTRINGS][1025];
+static HUGO_TLS char tempstring_count = 0;
 
 static char *GetTempString(void)
 {
-	static char *r;
+	static HUGO_TLS char *r;
 
 	r = &tempstring[(int)tempstring_count][0];
 	if (++tempstring_count >= NUM_TEMPSTRINGS) tempstring_count = 0;
@@ -76,7 +86,7 @@ static char *GetTempString(void)
 
 char *Left(char a[], int l)
 {
-	static char *temp;
+	static HUGO_TLS char *temp;
 	int i;
 
 #ifdef ALLOW_NESTING
@@ -97,7 +107,7 @@ char *Left(char a[], int l)
 
 char *Ltrim(char a[])
 {
-	static char *temp;
+	static HUGO_TLS char *temp;
 
 #ifdef ALLOW_NESTING
 	temp = GetTempString();
@@ -115,7 +125,7 @@ char *Ltrim(char a[])
 
 char *Mid(char a[], int pos, int n)
 {
-	static char *temp;
+	static HUGO_TLS char *temp;
 	int i;
 
 #ifdef ALLOW_NESTING
@@ -137,7 +147,7 @@ char *Mid(char a[], int pos, int n)
 
 char *Right(char a[], int l)
 {
-	static char *temp;
+	static HUGO_TLS char *temp;
 	int i;
 
 #ifdef ALLOW_NESTING
@@ -158,7 +168,7 @@ char *Right(char a[], int l)
 
 char *Rtrim(char a[])
 {
-	static char *temp;
+	static HUGO_TLS char *temp;
 	int len;
 
 #ifdef ALLOW_NESTING
@@ -0,0 +1,31 @@
+# Micro-benchmarks of the interpreter's hot paths, and a macro-benchmark that
+# replays a game with hugor-headless (see the README.) Builds what hugor.pro
+# builds, with the benchmarks in place of main(), and the game builder that
+# makes the game they run on.
+#
+#   qmake hugor-bench.pro
+#   make -jN
+#   ./hugor-bench -median 5
+
+include(hugor.pro)
+
+QT += testlib
+TARGET = hugor-bench
+CONFIG -= app_bundle
+CONFIG += console thread
+OBJECTS_DIR = obj-bench
+MOC_DIR = tmp-bench
+UI_DIR = tmp-bench
+
+INCLUDEPATH += bench
+
+SOURCES -= src/main.cc
+
+HEADERS += \
+    bench/hugorbench.h \
+    src/hgamebuilder.h
+
+SOURCES += \
+    bench/benchmain.cc \
+    bench/hugorbench.cc \
+    src/hgamebuilder.cc
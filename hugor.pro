@@ -138,6 +138,9 @@ QMAKE_CFLAGS_WARN_OFF =
 *-g++*|*-clang* {
     # Avoid "unused parameter" warnings with C code.
     QMAKE_CFLAGS_WARN_ON += -Wno-unused-parameter
+    # Falling off the end of a function that returns a value is never what we
+    # want.
+    QMAKE_CXXFLAGS_WARN_ON += -Werror=return-type
 }
 
 INCLUDEPATH += src hugo
@@ -157,11 +160,22 @@ HEADERS += \
     src/aboutdialog.h \
     src/confdialog.h \
     src/happlication.h \
+    src/hcheckpoint.h \
     src/heqtheader.h \
     src/hframe.h \
+    src/hframepacer.h \
+    src/hgameindex.h \
+    src/hgamelibrary.h \
+    src/hgamelibrarydialog.h \
+    src/hinputqueue.h \
     src/hmainwindow.h \
     src/hmarginwidget.h \
+    src/hmetrics.h \
+    src/hprofiler.h \
     src/hscrollback.h \
+    src/hstartup.h \
+    src/hstatictextcache.h \
+    src/htracer.h \
     src/hugodefs.h \
     src/kcolorbutton.h \
     src/settings.h \
@@ -182,11 +196,23 @@ SOURCES += \
     src/aboutdialog.cc \
     src/confdialog.cc \
     src/happlication.cc \
+    src/hcheckpoint.cc \
     src/heqt.cc \
     src/hframe.cc \
+    src/hframepacer.cc \
+    src/hgameindex.cc \
+    src/hgamelibrary.cc \
+    src/hgamelibrarydialog.cc \
+    src/hinputqueue.cc \
     src/hmainwindow.cc \
     src/hmarginwidget.cc \
+    src/hmetrics.cc \
+    src/hprofiler.cc \
+    src/htokens.c \
     src/hscrollback.cc \
+    src/hstartup.cc \
+    src/hstatictextcache.cc \
+    src/htracer.cc \
     src/kcolorbutton.cc \
     src/main.cc \
     src/settings.cc \
@@ -27,6 +27,8 @@
  */
 #include <QThread>
 #include "enginerunner.h"
+#include "hprofiler.h"
+#include "htracer.h"
 extern "C" {
 #include "heheader.h"
 }
@@ -40,6 +42,22 @@ EngineRunner::runEngine()
     strcpy(argv1, fGameFile.toLocal8Bit().constData());
     char* argv[2] = {argv0, argv1};
     fThread->setTerminationEnabled(true);
+    HTracer::setThreadName("engine");
+    // Profile the game if HUGOR_PROFILE names a report file, and sample it if
+    // HUGOR_SAMPLE names a file for the samples.
+    const QByteArray profileFile = qgetenv("HUGOR_PROFILE");
+    const QByteArray sampleFile = qgetenv("HUGOR_SAMPLE");
+    if (not profileFile.isEmpty()) {
+        HProfiler::start(profileFile.constData());
+    }
+    if (not sampleFile.isEmpty()) {
+        const int rate = qEnvironmentVariableIsSet("HUGOR_SAMPLE_RATE")
+                         ? qgetenv("HUGOR_SAMPLE_RATE").toInt() : DEFAULT_SAMPLE_RATE;
+        HProfiler::startSampling(sampleFile.constData(), rate);
+    }
     he_main(2, argv);
+    if (not HProfiler::finish()) {
+        qWarning("Can't write the profile to %s", (profileFile + ' ' + sampleFile).constData());
+    }
     emit finished();
 }
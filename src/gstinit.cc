@@ -25,11 +25,11 @@
  * include the source code for the parts of the Hugo Engine used as well as
  * that of the covered work.
  */
-#include <QMessageBox>
 #include <gst/gst.h>
 #include <gst/gstplugin.h>
 
 #include "happlication.h"
+#include "hugodefs.h"
 #include "settings.h"
 
 
@@ -307,7 +307,7 @@ registerGstStaticPlugins()
 #endif // Q_OS_WIN
 
 
-void initVideoEngine(int& argc, char* argv[])
+QString initVideoEngine(int& argc, char* argv[])
 {
     GError* gstError = 0;
 
@@ -318,13 +318,14 @@ void initVideoEngine(int& argc, char* argv[])
             errMsg += QObject::tr("The GStreamer error was: ") + QString::fromLocal8Bit(gstError->message);
         }
         g_error_free(gstError);
-        QMessageBox::critical(0, hApp->applicationName(), errMsg);
         hApp->settings()->videoSysError = true;
+        return errMsg;
     }
 
 #ifdef Q_OS_WIN
     registerGstStaticPlugins();
 #endif
+    return QString();
 }
 
 
@@ -35,9 +35,14 @@
 #include <QMessageBox>
 #include <QFileDialog>
 #include <QDialogButtonBox>
+#include <QStandardPaths>
 #include <QStyle>
 #include <QMenuBar>
 #include <QDesktopWidget>
+#include <QEventLoop>
+#include <QTimer>
+#include <QWindow>
+#include <cstdlib>
 
 extern "C" {
 #include "heheader.h"
@@ -52,6 +57,12 @@ extern "C" {
 #include "enginerunner.h"
 #include "hugohandlers.h"
 #include "videoplayer.h"
+#include "hgameindex.h"
+#include "hgamelibrarydialog.h"
+#include "hstartup.h"
+#include "htracer.h"
+#include "hmetrics.h"
+#include "hprofiler.h"
 
 
 HApplication* hApp = 0;
@@ -64,7 +75,17 @@ HApplication::HApplication( int& argc, char* argv[], const char* appName,
       fBottomMarginSize(0),
       fGameRunning(false),
       fHugoCodec(QTextCodec::codecForName("Windows-1252")),
-      fDesktopIsGnome(false)
+      fDesktopIsGnome(false),
+      fArgc(argc),
+      fArgv(argv),
+      fSoundReady(false),
+#ifdef DISABLE_VIDEO
+      fVideoReady(true),
+#else
+      fVideoReady(false),
+#endif
+      fFirstFrameShown(false),
+      fWaitLoop(0)
 {
     //qDebug() << Q_FUNC_INFO;
     Q_ASSERT(hApp == 0);
@@ -130,6 +151,13 @@ HApplication::HApplication( int& argc, char* argv[], const char* appName,
     // Apply the smart formatting setting.
     smartformatting = this->fSettings->smartFormatting;
 
+    // Games' indexes are kept with our other cached data.
+    const QString& indexDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+                              + QString::fromLatin1("/index");
+    if (QDir().mkpath(indexDir)) {
+        HGameIndex::setCacheDir(QFile::encodeName(indexDir).constData());
+    }
+
     // Set our global pointer.
     hApp = this;
 
@@ -170,6 +198,13 @@ HApplication::HApplication( int& argc, char* argv[], const char* appName,
 HApplication::~HApplication()
 {
     //qDebug() << Q_FUNC_INFO;
+    // Don't leave a media engine half-way initialized.
+    if (this->fSoundInit.valid()) {
+        this->fSoundInit.wait();
+    }
+    if (this->fVideoInit.valid()) {
+        this->fVideoInit.wait();
+    }
     Q_ASSERT(hHandlers != 0);
     delete hHandlers;
     hHandlers = 0;
@@ -304,6 +339,57 @@ HApplication::updateMargins( int color )
 }
 
 
+void
+HApplication::fWaitForEvent( int timeout )
+{
+    QEventLoop loop;
+    QTimer::singleShot(timeout, &loop, SLOT(quit()));
+    this->fWaitLoop = &loop;
+    loop.exec(QEventLoop::ExcludeUserInputEvents);
+    this->fWaitLoop = 0;
+}
+
+
+void
+HApplication::fStopWaiting()
+{
+    if (this->fWaitLoop) {
+        this->fWaitLoop->quit();
+    }
+}
+
+
+bool
+HApplication::eventFilter( QObject* watched, QEvent* e )
+{
+    if (e->type() == QEvent::Expose and watched == fMainWin->windowHandle()
+        and fMainWin->windowHandle()->isExposed())
+    {
+        this->fStopWaiting();
+    } else if (e->type() == QEvent::Paint and watched == fFrameWin and not this->fFirstFrameShown) {
+        // The frame is painted once this event has been handled.
+        this->fFirstFrameShown = true;
+        QMetaObject::invokeMethod(this, "fHandleFirstFrame", Qt::QueuedConnection);
+    }
+    return QApplication::eventFilter(watched, e);
+}
+
+
+void
+HApplication::fHandleFirstFrame()
+{
+    fFrameWin->removeEventFilter(this);
+    HStartup::finish();
+}
+
+
+void
+HApplication::fShowMediaError( QString msg )
+{
+    QMessageBox::critical(0, this->applicationName(), msg);
+}
+
+
 #ifdef Q_OS_MAC
 #include <QFileOpenEvent>
 bool
@@ -319,6 +405,7 @@ HApplication::event( QEvent* e )
         return QApplication::event(e);
     }
     this->fNextGame = fOpenEv->file();
+    this->fStopWaiting();
     e->accept();
     return true;
 }
@@ -328,20 +415,42 @@ HApplication::event( QEvent* e )
 void
 HApplication::entryPoint( QString gameFileName )
 {
-    // Process pending events in case we have a FileOpen event. Freeze user
-    // input while doing so; we don't want to leave a way to mess with the
-    // GUI when we don't have a game running yet.  We do this a bunch of
-    // times to make sure the FileOpen event can propagate properly.
-    for (int i = 0; i < 100; ++i) {
-        this->advanceEventLoop();
+    HStartup::phase("file open");
+#ifdef Q_OS_MAC
+    // If we were started by opening a file, the FileOpen event arrives after
+    // the event loop has started, but before we become the active
+    // application. Wait for either. Freeze user input while doing so; we
+    // don't want to leave a way to mess with the GUI when we don't have a
+    // game running yet.
+    if (this->fNextGame.isEmpty() and this->applicationState() != Qt::ApplicationActive) {
+        QMetaObject::Connection conn
+            = connect(this, &QGuiApplication::applicationStateChanged, [this](Qt::ApplicationState state) {
+                if (state == Qt::ApplicationActive) {
+                    this->fStopWaiting();
+                }
+            });
+        this->fWaitForEvent(1000);
+        disconnect(conn);
     }
+#endif
 
     if (this->fNextGame.isEmpty()) {
         this->fNextGame = gameFileName;
     }
 
-    // If we still don't have a filename, prompt for one.
-    if (this->fNextGame.isEmpty() and this->fSettings->askForGameFile) {
+    // If we still don't have a filename, let the player pick a game from the
+    // directory HUGOR_LIBRARY names (on kiosks, for example) or prompt for one.
+    const QString& libraryDir = QString::fromLocal8Bit(qgetenv("HUGOR_LIBRARY"));
+    if (this->fNextGame.isEmpty() and not libraryDir.isEmpty()) {
+        HStartup::phase("game library");
+        HGameLibraryDialog dialog(QStringList(libraryDir),
+                                  QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+                                  + QString::fromLatin1("/library"));
+        if (dialog.exec() == QDialog::Accepted) {
+            this->fNextGame = dialog.selectedGame();
+        }
+    } else if (this->fNextGame.isEmpty() and this->fSettings->askForGameFile) {
+        HStartup::phase("file dialog");
         this->fNextGame = QFileDialog::getOpenFileName(0, QObject::tr("Choose the story file you wish to play"),
                                                        this->fSettings->lastFileOpenDir,
                                                        QObject::tr("Hugo Games")
@@ -349,13 +458,17 @@ HApplication::entryPoint( QString gameFileName )
     }
 
     // Switch to fullscreen, if needed.
+    HStartup::phase("window");
     if (fSettings->isFullscreen) {
         this->fMainWin->toggleFullscreen();
-        // If we don't let the event loop run for a while, for some reason
-        // the screen will be flashing when the window first becomes visible.
-        // The reason is unknown, but this seems to work around the issue.
-        for (int i = 0; i < 5000; ++i) {
-            this->advanceEventLoop();
+        // If the game starts drawing before the fullscreen window is on the
+        // screen, the screen flashes when the window first becomes visible.
+        // So wait until the window system has exposed it.
+        QWindow* win = this->fMainWin->windowHandle();
+        if (win and not win->isExposed()) {
+            win->installEventFilter(this);
+            this->fWaitForEvent(2000);
+            win->removeEventFilter(this);
         }
     }
 
@@ -369,6 +482,8 @@ HApplication::entryPoint( QString gameFileName )
         } else {
             this->fMainWin->show();
         }
+        HStartup::phase("game start");
+        fFrameWin->installEventFilter(this);
         this->fRunGame();
     } else {
         // File dialog was canceled.
@@ -394,14 +509,10 @@ HApplication::notifyPreferencesChange( const Settings* sett )
     // 'bgcolor' is a Hugo engine global.
     this->updateMargins(::bgcolor);
 
-    // Recalculate font dimensions, in case font settings have changed.
-    hHandlers->calcFontDimensions();
-
-    // The fonts might have changed.
-    hFrame->setFontType(currentfont);
+    // The fonts might have changed. The engine thread recalculates the font
+    // dimensions and draws the screen again the next time it waits for input.
+    hFrame->requestFontChange();
     hMainWin->setScrollbackFont(sett->scrollbackFont);
-
-    display_needs_repaint = true;
 #ifndef DISABLE_AUDIO
     if (not sett->enableMusic) {
         hHandlers->stopmusic();
@@ -418,7 +529,7 @@ HApplication::notifyPreferencesChange( const Settings* sett )
         hHandlers->stopvideo();
     }
 #endif
-    fFrameWin->updateGameScreen(true);
+    fFrameWin->publishFrame(true);
 }
 
 
@@ -436,9 +547,92 @@ HApplication::advanceEventLoop()
 }
 
 
+void
+HApplication::prewarmMediaEngines( int engines )
+{
+    std::lock_guard<std::mutex> locker(this->fMediaMutex);
+    if ((engines & SoundEngine) and not this->fSoundInit.valid()) {
+        this->fSoundInit = std::async(std::launch::async, [this]{
+            HTraceScope trace("init sound", "media");
+            const QString& err = initSoundEngine();
+            this->fSoundReady = true;
+            if (not err.isEmpty()) {
+                QMetaObject::invokeMethod(this, "fShowMediaError", Qt::QueuedConnection,
+                                          Q_ARG(QString, err));
+            }
+        }).share();
+    }
+#ifndef DISABLE_VIDEO
+    if ((engines & VideoEngine) and not this->fVideoInit.valid()) {
+        this->fVideoInit = std::async(std::launch::async, [this]{
+            HTraceScope trace("init video", "media");
+            const QString& err = initVideoEngine(this->fArgc, this->fArgv);
+            this->fVideoReady = true;
+            if (not err.isEmpty()) {
+                QMetaObject::invokeMethod(this, "fShowMediaError", Qt::QueuedConnection,
+                                          Q_ARG(QString, err));
+            }
+        }).share();
+    }
+#endif
+}
+
+
+void
+HApplication::initMediaEngines( int engines )
+{
+    if (this->mediaEnginesReady(engines)) {
+        return;
+    }
+    this->prewarmMediaEngines(engines);
+    std::shared_future<void> soundInit;
+    std::shared_future<void> videoInit;
+    {
+        std::lock_guard<std::mutex> locker(this->fMediaMutex);
+        soundInit = this->fSoundInit;
+        videoInit = this->fVideoInit;
+    }
+    if ((engines & SoundEngine) and soundInit.valid()) {
+        soundInit.wait();
+    }
+    if ((engines & VideoEngine) and videoInit.valid()) {
+        videoInit.wait();
+    }
+}
+
+
 void
 HApplication::terminateEngineThread()
 {
     fHugoThread->terminate();
     fHugoThread->wait(2000);
 }
+
+
+void
+HApplication::quitImmediately()
+{
+    this->fSettings->saveToDisk();
+    closeSoundEngine();
+    this->terminateEngineThread();
+    writeExitReports();
+    exit(0);
+}
+
+
+void
+HApplication::writeExitReports()
+{
+    // The engine thread writes the profile when the game ends. If it was cut
+    // short, we do it. The engine's state isn't thread-local in Hugor, so we
+    // get to see the profile of its thread.
+    if (HProfiler::isRunning() and not HProfiler::finish()) {
+        qWarning("Can't write the profile to %s",
+                 (qgetenv("HUGOR_PROFILE") + ' ' + qgetenv("HUGOR_SAMPLE")).constData());
+    }
+    HMetrics::stopExport();
+    const QByteArray traceFile = qgetenv("HUGOR_TRACE");
+    if (not traceFile.isEmpty() and HTracer::isCapturing() and not HTracer::dump(traceFile.constData())) {
+        qWarning("Can't write the trace to %s", traceFile.constData());
+    }
+}
@@ -29,6 +29,9 @@
 #define HAPPLICATION_H
 
 #include <QApplication>
+#include <atomic>
+#include <future>
+#include <mutex>
 
 
 extern class HApplication*  hApp;
@@ -71,6 +74,26 @@ class HApplication: public QApplication {
     class EngineRunner* fEngineRunner;
     class EngineThread* fHugoThread;
 
+    // The command line, for the video engine.
+    int& fArgc;
+    char** fArgv;
+
+    // Background initialization of the sound and video engines, once it's
+    // been started (see prewarmMediaEngines().) Guarded by fMediaMutex.
+    std::mutex fMediaMutex;
+    std::shared_future<void> fSoundInit;
+    std::shared_future<void> fVideoInit;
+
+    // Are the sound and video engines up?
+    std::atomic<bool> fSoundReady;
+    std::atomic<bool> fVideoReady;
+
+    // Has the frame window been painted since the game started?
+    bool fFirstFrameShown;
+
+    // Event loop of fWaitForEvent(), while it runs.
+    class QEventLoop* fWaitLoop;
+
     // Run the game file contained in fNextGame.
     void
     fRunGame();
@@ -78,6 +101,29 @@ class HApplication: public QApplication {
     void
     fUpdateMarginColor( int color );
 
+    // Runs the event loop, without user input, until fStopWaiting() is called
+    // or 'timeout' milliseconds have passed. For waiting on things the window
+    // system tells us about during startup.
+    void
+    fWaitForEvent( int timeout );
+
+    void
+    fStopWaiting();
+
+  private slots:
+    // Called once the first frame of the game has been painted.
+    void
+    fHandleFirstFrame();
+
+    // Tells the user that sound or video won't work. The media engines find
+    // out in a background thread.
+    void
+    fShowMediaError( QString msg );
+
+  protected:
+    virtual bool
+    eventFilter( QObject* watched, QEvent* e );
+
 #ifdef Q_OS_MAC
   protected:
     // On the Mac, dropping a file on our application icon will generate a
@@ -153,6 +199,32 @@ class HApplication: public QApplication {
     void
     advanceEventLoop();
 
+    enum MediaEngine {
+        SoundEngine = 1,
+        VideoEngine = 2,
+        AllMediaEngines = SoundEngine | VideoEngine
+    };
+
+    // Starts initializing the given media engines in a background thread,
+    // unless that's been done already, and returns right away. Most games
+    // never play anything, so nothing starts them up front; the engine hints
+    // at them once it knows it needs them. Can be called from any thread.
+    void
+    prewarmMediaEngines( int engines = AllMediaEngines );
+
+    // Like prewarmMediaEngines(), but waits until the engines are up. Has to
+    // be called before using an engine. Can be called from any thread.
+    void
+    initMediaEngines( int engines = AllMediaEngines );
+
+    // Can be called from any thread.
+    bool
+    mediaEnginesReady( int engines = AllMediaEngines )
+    {
+        return (not (engines & SoundEngine) or this->fSoundReady)
+               and (not (engines & VideoEngine) or this->fVideoReady);
+    }
+
     // Text codec used by Hugo.
     QTextCodec*
     hugoCodec()
@@ -164,6 +236,18 @@ class HApplication: public QApplication {
 
     void
     terminateEngineThread();
+
+    // Abandon the game in progress and quit right away, without returning to
+    // the event loop.
+    void
+    quitImmediately();
+
+    // Write out what's only written when Hugor quits: the profile of a game
+    // that didn't end, the last metrics snapshot and the trace for
+    // HUGOR_TRACE. Every way of quitting has to
+    // call this, including those that exit() right away.
+    static void
+    writeExitReports();
 };
 
 
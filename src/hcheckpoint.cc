@@ -0,0 +1,130 @@
+/* Copyright 2015 Nikos Chantziaras
+ *
+ * This file is part of Hugor.
+ *
+ * Hugor is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Hugor is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Hugor.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Additional permission under GNU GPL version 3 section 7
+ *
+ * If you modify this Program, or any covered work, by linking or combining it
+ * with the Hugo Engine (or a modified version of the Hugo Engine), containing
+ * parts covered by the terms of the Hugo License, the licensors of this
+ * Program grant you additional permission to convey the resulting work.
+ * Corresponding Source for a non-source form of such a combination shall
+ * include the source code for the parts of the Hugo Engine used as well as
+ * that of the covered work.
+ */
+#include <algorithm>
+#include <cstring>
+
+#include "hcheckpoint.h"
+
+extern "C" {
+#include "heheader.h"
+}
+
+
+const size_t HCheckpoint::PAGE_SIZE;
+
+
+bool
+HCheckpoint::atTurnPrompt()
+{
+    return fresh_input and during_player_input;
+}
+
+
+std::shared_ptr<const HCheckpoint>
+HCheckpoint::take( const HCheckpoint* base )
+{
+    std::shared_ptr<HCheckpoint> cp(new HCheckpoint);
+    std::copy(serial, serial + cp->fSerial.size(), cp->fSerial.begin());
+    // Same range that SaveGameData() writes.
+    cp->fMemStart = objtable * 16L;
+    cp->fMemEnd = codeend + 1;
+
+    if (base != nullptr and not base->matchesGame()) {
+        base = nullptr;
+    }
+    const size_t pages = (cp->fMemEnd - cp->fMemStart + PAGE_SIZE - 1) / PAGE_SIZE;
+    cp->fPages.reserve(pages);
+    cp->fOwnPages = 0;
+    for (size_t i = 0; i < pages; ++i) {
+        const unsigned char* src = mem + cp->fMemStart + i * PAGE_SIZE;
+        const size_t len = std::min<size_t>(PAGE_SIZE, cp->fMemEnd - cp->fMemStart - i * PAGE_SIZE);
+        if (base != nullptr and std::memcmp(base->fPages[i]->data(), src, len) == 0) {
+            cp->fPages.push_back(base->fPages[i]);
+            continue;
+        }
+        std::shared_ptr<Page> page(new Page);
+        std::memcpy(page->data(), src, len);
+        cp->fPages.push_back(std::move(page));
+        ++cp->fOwnPages;
+    }
+
+    cp->fVars.assign(var, var + MAXGLOBALS + MAXLOCALS);
+    cp->fUndoStack.assign(&undostack[0][0], &undostack[0][0] + MAXUNDO * 5);
+    cp->fUndoPtr = undoptr;
+    cp->fUndoTurn = undoturn;
+    cp->fUndoInvalid = undoinvalid;
+    cp->fUndoRecord = undorecord;
+
+    cp->fFont = currentfont;
+    cp->fFgColor = fcolor;
+    cp->fBgColor = bgcolor;
+    cp->fInputColor = icolor;
+    cp->fDefaultBgColor = default_bgcolor;
+    return cp;
+}
+
+
+bool
+HCheckpoint::matchesGame() const
+{
+    return std::equal(fSerial.begin(), fSerial.end(), serial)
+           and fMemStart == objtable * 16L and fMemEnd == codeend + 1;
+}
+
+
+bool
+HCheckpoint::restore() const
+{
+    if (not matchesGame()) {
+        return false;
+    }
+    for (size_t i = 0; i < fPages.size(); ++i) {
+        const size_t len = std::min<size_t>(PAGE_SIZE, fMemEnd - fMemStart - i * PAGE_SIZE);
+        std::memcpy(mem + fMemStart + i * PAGE_SIZE, fPages[i]->data(), len);
+    }
+
+    std::copy(fVars.begin(), fVars.end(), var);
+    std::copy(fUndoStack.begin(), fUndoStack.end(), &undostack[0][0]);
+    undoptr = fUndoPtr;
+    undoturn = fUndoTurn;
+    undoinvalid = fUndoInvalid;
+    undorecord = fUndoRecord;
+
+    currentfont = fFont;
+    fcolor = fFgColor;
+    bgcolor = fBgColor;
+    icolor = fInputColor;
+    default_bgcolor = fDefaultBgColor;
+    hugo_font(currentfont);
+    hugo_settextcolor(fcolor);
+    hugo_setbackcolor(bgcolor);
+
+    // Same as after RunRestore().
+    game_reset = true;
+    return true;
+}
@@ -0,0 +1,118 @@
+/* Copyright 2015 Nikos Chantziaras
+ *
+ * This file is part of Hugor.
+ *
+ * Hugor is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Hugor is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Hugor.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Additional permission under GNU GPL version 3 section 7
+ *
+ * If you modify this Program, or any covered work, by linking or combining it
+ * with the Hugo Engine (or a modified version of the Hugo Engine), containing
+ * parts covered by the terms of the Hugo License, the licensors of this
+ * Program grant you additional permission to convey the resulting work.
+ * Corresponding Source for a non-source form of such a combination shall
+ * include the source code for the parts of the Hugo Engine used as well as
+ * that of the covered work.
+ */
+#ifndef HCHECKPOINT_H
+#define HCHECKPOINT_H
+
+#include <array>
+#include <memory>
+#include <vector>
+
+
+// An in-memory snapshot of a running game: the dynamic part of the game image
+// (object table to the end of the code), the global and local variables, the
+// undo stack and the current text colors and font. This is the same state a
+// saved game file has, so a checkpoint can be restored any time a saved game
+// could be.
+//
+// Checkpoints don't touch the disk. The game image is split into pages and a
+// checkpoint only copies the pages that differ from the checkpoint it's based
+// on; the rest are shared with it. A game usually changes very little of the
+// image in a turn, so taking a checkpoint is mostly a compare, not a copy.
+// Checkpoints are immutable once taken, so they can be kept around and shared
+// between threads and sessions freely.
+//
+// Everything here must be called on the thread that runs the engine (or,
+// with HeadlessSession, from within the session.)
+class HCheckpoint {
+  public:
+    // Whether the engine is at a point where checkpoints can be taken and
+    // restored: waiting for the player to enter a new command. Other input
+    // (like a game's own "input" statement or a "Which do you mean" question)
+    // is read in the middle of running game code, and restoring there would
+    // return into code that belongs to a different turn.
+    static bool
+    atTurnPrompt();
+
+    // Takes a checkpoint of the current game. Pages that didn't change since
+    // 'base' was taken are shared with it. 'base' can be null, or a
+    // checkpoint of any game; it's only used if it's one of this game.
+    static std::shared_ptr<const HCheckpoint>
+    take( const HCheckpoint* base = nullptr );
+
+    // Puts the game back into the state it was in when the checkpoint was
+    // taken. Returns false, without changing anything, if the checkpoint
+    // belongs to a different game. The game sees this like a restored game
+    // (the GAME_RESET system call returns true.)
+    bool
+    restore() const;
+
+    // Whether this checkpoint was taken from the currently loaded game.
+    bool
+    matchesGame() const;
+
+    // How many pages this checkpoint holds, and how many of them it owns
+    // rather than shares with the checkpoint it was based on.
+    size_t
+    pageCount() const
+    { return this->fPages.size(); }
+
+    size_t
+    ownPageCount() const
+    { return this->fOwnPages; }
+
+  private:
+    static const size_t PAGE_SIZE = 4096;
+    using Page = std::array<unsigned char, PAGE_SIZE>;
+
+    HCheckpoint() = default;
+
+    // Identifies the game, along with the extent of its dynamic memory.
+    std::array<char, 8> fSerial;
+    long fMemStart;
+    long fMemEnd;
+
+    std::vector<std::shared_ptr<const Page>> fPages;
+    size_t fOwnPages;
+
+    std::vector<int> fVars;
+
+    std::vector<int> fUndoStack;
+    int fUndoPtr;
+    int fUndoTurn;
+    char fUndoInvalid;
+    char fUndoRecord;
+
+    int fFont;
+    signed char fFgColor;
+    signed char fBgColor;
+    signed char fInputColor;
+    signed char fDefaultBgColor;
+};
+
+
+#endif // HCHECKPOINT_H
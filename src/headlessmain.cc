@@ -0,0 +1,136 @@
+/* Copyright 2015 Nikos Chantziaras
+ *
+ * This file is part of Hugor.
+ *
+ * Hugor is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Hugor is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Hugor.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Additional permission under GNU GPL version 3 section 7
+ *
+ * If you modify this Program, or any covered work, by linking or combining it
+ * with the Hugo Engine (or a modified version of the Hugo Engine), containing
+ * parts covered by the terms of the Hugo License, the licensors of this
+ * Program grant you additional permission to convey the resulting work.
+ * Corresponding Source for a non-source form of such a combination shall
+ * include the source code for the parts of the Hugo Engine used as well as
+ * that of the covered work.
+ */
+// Entry point of the headless interpreter (hugor-headless). Runs a game
+// without any GUI, reading commands from stdin and writing game text to
+// stdout. Meant for automated playthroughs.
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "heheadless.h"
+#include "hgameindex.h"
+#include "hprofiler.h"
+
+
+static void
+usage( const char* argv0 )
+{
+    std::fprintf(stderr,
+        "Usage: %s [options] gamefile\n"
+        "\n"
+        "Options:\n"
+        "  -o, --output FILE    Write game text to FILE instead of stdout.\n"
+        "  -i, --input FILE     Read commands from FILE instead of stdin.\n"
+        "  -p, --playback FILE  Play back a command recording (.rec) first.\n"
+        "  -t, --transcript FILE\n"
+        "                       Write a transcript to FILE.\n"
+        "      --turn-hashes FILE\n"
+        "                       Write a hash of each turn of the transcript to\n"
+        "                       FILE. Needs --transcript.\n"
+        "  -w, --width N        Screen width in characters (default 80.)\n"
+        "  -h, --height N       Screen height in lines (default 25.)\n"
+        "      --windows        Also print text printed into windows, like the\n"
+        "                       status line.\n"
+        "      --watchdog N     Stop the game with exit code %d when it runs for\n"
+        "                       N seconds without asking for input.\n"
+        "      --profile FILE   Profile the game's code and write the report to\n"
+        "                       FILE when it ends.\n"
+        "      --sample FILE    Sample where the game's code spends its time and\n"
+        "                       write the samples to FILE as folded stacks.\n"
+        "      --sample-rate N  Samples per second (default %d.)\n"
+        "      --trace FILE     Write a timeline of the session to FILE in the\n"
+        "                       Chrome trace event format.\n"
+        "      --index-cache DIR\n"
+        "                       Keep the game's index in DIR, so it doesn't have\n"
+        "                       to be built again next time.\n",
+        argv0, WATCHDOG_EXIT_CODE, DEFAULT_SAMPLE_RATE);
+}
+
+
+int
+main( int argc, char* argv[] )
+{
+    HeadlessOptions opts = { stdout, stdin, 80, 25, false, nullptr, nullptr, nullptr, 0, 0, nullptr,
+                             nullptr, 0, nullptr };
+    const char* gameFile = nullptr;
+
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if ((not std::strcmp(arg, "-o") or not std::strcmp(arg, "--output")) and hasValue) {
+            opts.output = std::fopen(argv[++i], "w");
+            if (not opts.output) {
+                std::fprintf(stderr, "Can't open output file: %s\n", argv[i]);
+                return 1;
+            }
+        } else if ((not std::strcmp(arg, "-i") or not std::strcmp(arg, "--input")) and hasValue) {
+            opts.input = std::fopen(argv[++i], "r");
+            if (not opts.input) {
+                std::fprintf(stderr, "Can't open input file: %s\n", argv[i]);
+                return 1;
+            }
+        } else if ((not std::strcmp(arg, "-p") or not std::strcmp(arg, "--playback")) and hasValue) {
+            opts.playbackFile = argv[++i];
+        } else if ((not std::strcmp(arg, "-t") or not std::strcmp(arg, "--transcript")) and hasValue) {
+            opts.transcriptFile = argv[++i];
+        } else if (not std::strcmp(arg, "--turn-hashes") and hasValue) {
+            opts.turnHashFile = argv[++i];
+        } else if ((not std::strcmp(arg, "-w") or not std::strcmp(arg, "--width")) and hasValue) {
+            opts.screenWidth = std::atoi(argv[++i]);
+        } else if ((not std::strcmp(arg, "-h") or not std::strcmp(arg, "--height")) and hasValue) {
+            opts.screenHeight = std::atoi(argv[++i]);
+        } else if (not std::strcmp(arg, "--watchdog") and hasValue) {
+            opts.watchdogSeconds = std::atoi(argv[++i]);
+        } else if (not std::strcmp(arg, "--profile") and hasValue) {
+            opts.profileFile = argv[++i];
+        } else if (not std::strcmp(arg, "--sample") and hasValue) {
+            opts.sampleFile = argv[++i];
+        } else if (not std::strcmp(arg, "--sample-rate") and hasValue) {
+            opts.sampleRate = std::atoi(argv[++i]);
+        } else if (not std::strcmp(arg, "--trace") and hasValue) {
+            opts.traceFile = argv[++i];
+        } else if (not std::strcmp(arg, "--index-cache") and hasValue) {
+            HGameIndex::setCacheDir(argv[++i]);
+        } else if (not std::strcmp(arg, "--windows")) {
+            opts.printWindows = true;
+        } else if (arg[0] != '-' and not gameFile) {
+            gameFile = arg;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (not gameFile or opts.screenWidth < 1 or opts.screenHeight < 1
+        or (opts.turnHashFile and not opts.transcriptFile))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    return runHeadlessSession(opts, gameFile);
+}
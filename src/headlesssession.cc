@@ -0,0 +1,262 @@
+/* Copyright 2015 Nikos Chantziaras
+ *
+ * This file is part of Hugor.
+ *
+ * Hugor is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Hugor is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Hugor.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Additional permission under GNU GPL version 3 section 7
+ *
+ * If you modify this Program, or any covered work, by linking or combining it
+ * with the Hugo Engine (or a modified version of the Hugo Engine), containing
+ * parts covered by the terms of the Hugo License, the licensors of this
+ * Program grant you additional permission to convey the resulting work.
+ * Corresponding Source for a non-source form of such a combination shall
+ * include the source code for the parts of the Hugo Engine used as well as
+ * that of the covered work.
+ */
+#include <cstring>
+#include <mutex>
+
+#include "headlesssession.h"
+
+
+// The engine state, as laid out by the linker (see heqtheader.h.)
+extern "C" char __start_hugo_state[];
+extern "C" char __stop_hugo_state[];
+
+static size_t
+engineStateSize()
+{
+    return __stop_hugo_state - __start_hugo_state;
+}
+
+// The engine state before any game ran. New sessions start from this.
+static char*
+initialEngineState()
+{
+    static std::unique_ptr<char[]> state = [] {
+        std::unique_ptr<char[]> copy(new char[engineStateSize()]);
+        std::memcpy(copy.get(), __start_hugo_state, engineStateSize());
+        return copy;
+    }();
+    return state.get();
+}
+
+// Only one session runs at a time, since they share the engine's globals.
+static std::mutex runMutex;
+static HeadlessSession* currentSession = nullptr;
+
+
+HeadlessSession::HeadlessSession( const HeadlessOptions& opts, const std::string& gameFile,
+                                  size_t stackSize )
+    : fOpts(opts),
+      fGameFile(gameFile),
+      fStack(new char[stackSize]),
+      fStackSize(stackSize),
+      fEngineState(new char[engineStateSize()]),
+      fState(Idle),
+      fExitCode(0),
+      fClosing(false),
+      fRequest(NoRequest),
+      fRequestCheckpoint(nullptr),
+      fRequestDone(false)
+{
+    std::memcpy(fEngineState.get(), initialEngineState(), engineStateSize());
+}
+
+
+HeadlessSession::~HeadlessSession()
+{
+    if (fState == WaitingForLine or fState == WaitingForKey or fState == Busy) {
+        fClosing = true;
+        fResume();
+    }
+}
+
+
+HeadlessSession::State
+HeadlessSession::start()
+{
+    if (fState != Idle) {
+        return fState;
+    }
+    getcontext(&fContext);
+    fContext.uc_stack.ss_sp = fStack.get();
+    fContext.uc_stack.ss_size = fStackSize;
+    fContext.uc_link = &fHostContext;
+    makecontext(&fContext, fRun, 0);
+    return fResume();
+}
+
+
+HeadlessSession::State
+HeadlessSession::sendLine( const std::string& line )
+{
+    if (fState == WaitingForKey and line.empty()) {
+        return sendKey('\r');
+    }
+    if (fState == WaitingForKey) {
+        return sendKey(static_cast<unsigned char>(line[0]));
+    }
+    if (fState != WaitingForLine) {
+        return fState;
+    }
+    fInput = line;
+    return fResume();
+}
+
+
+HeadlessSession::State
+HeadlessSession::sendKey( int key )
+{
+    if (fState != WaitingForKey) {
+        return fState;
+    }
+    fInput.assign(1, static_cast<char>(key));
+    return fResume();
+}
+
+
+HeadlessSession::State
+HeadlessSession::resume()
+{
+    if (fState != Busy) {
+        return fState;
+    }
+    return fResume();
+}
+
+
+std::shared_ptr<const HCheckpoint>
+HeadlessSession::checkpoint()
+{
+    if (not fRunRequest(TakeCheckpoint, nullptr)) {
+        return nullptr;
+    }
+    return fLastCheckpoint;
+}
+
+
+bool
+HeadlessSession::restore( const HCheckpoint& cp )
+{
+    return fRunRequest(RestoreCheckpoint, &cp);
+}
+
+
+std::unique_ptr<HeadlessSession>
+HeadlessSession::fork( const HCheckpoint& cp, const HeadlessOptions& opts ) const
+{
+    std::unique_ptr<HeadlessSession> session(new HeadlessSession(opts, fGameFile, fStackSize));
+    // Games can ask for keys (like "press a key to begin") before their first
+    // prompt. Anything will do for those.
+    State state = session->start();
+    while (state == WaitingForKey or state == Busy) {
+        state = state == Busy ? session->resume() : session->sendKey(' ');
+    }
+    if (not session->restore(cp)) {
+        return nullptr;
+    }
+    return session;
+}
+
+
+bool
+HeadlessSession::fRunRequest( Request req, const HCheckpoint* cp )
+{
+    if (fState != WaitingForLine) {
+        return false;
+    }
+    fRequest = req;
+    fRequestCheckpoint = cp;
+    fRequestDone = false;
+    fResume();
+    fRequest = NoRequest;
+    fRequestCheckpoint = nullptr;
+    return fRequestDone;
+}
+
+
+HeadlessSession::State
+HeadlessSession::fResume()
+{
+    std::lock_guard<std::mutex> locker(runMutex);
+    currentSession = this;
+    std::memcpy(__start_hugo_state, fEngineState.get(), engineStateSize());
+    swapcontext(&fHostContext, &fContext);
+    std::memcpy(fEngineState.get(), __start_hugo_state, engineStateSize());
+    currentSession = nullptr;
+    return fState;
+}
+
+
+void
+HeadlessSession::fRun()
+{
+    HeadlessSession* self = currentSession;
+    self->fExitCode = runHeadlessSession(self->fOpts, self->fGameFile.c_str());
+    self->fState = Finished;
+    // Returning switches back to fHostContext.
+}
+
+
+bool
+HeadlessSession::suspendForLine( char* buf, int size )
+{
+    HeadlessSession* self = currentSession;
+    self->fState = WaitingForLine;
+    swapcontext(&self->fContext, &self->fHostContext);
+    // Checkpoint requests need the engine state, so they're done here, on the
+    // session's side. The game keeps waiting for its line afterwards.
+    while (self->fRequest != NoRequest and not self->fClosing) {
+        if (HCheckpoint::atTurnPrompt()) {
+            if (self->fRequest == TakeCheckpoint) {
+                self->fLastCheckpoint = HCheckpoint::take(self->fLastCheckpoint.get());
+                self->fRequestDone = true;
+            } else {
+                self->fRequestDone = self->fRequestCheckpoint->restore();
+            }
+        }
+        swapcontext(&self->fContext, &self->fHostContext);
+    }
+    if (self->fClosing) {
+        return false;
+    }
+    std::strncpy(buf, self->fInput.c_str(), size - 1);
+    buf[size - 1] = '\0';
+    return true;
+}
+
+
+int
+HeadlessSession::suspendForKey()
+{
+    HeadlessSession* self = currentSession;
+    self->fState = WaitingForKey;
+    swapcontext(&self->fContext, &self->fHostContext);
+    if (self->fClosing) {
+        return EOF;
+    }
+    return static_cast<unsigned char>(self->fInput[0]);
+}
+
+
+bool
+HeadlessSession::suspendForSlice()
+{
+    HeadlessSession* self = currentSession;
+    self->fState = Busy;
+    swapcontext(&self->fContext, &self->fHostContext);
+    return not self->fClosing;
+}
@@ -0,0 +1,168 @@
+/* Copyright 2015 Nikos Chantziaras
+ *
+ * This file is part of Hugor.
+ *
+ * Hugor is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Hugor is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Hugor.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Additional permission under GNU GPL version 3 section 7
+ *
+ * If you modify this Program, or any covered work, by linking or combining it
+ * with the Hugo Engine (or a modified version of the Hugo Engine), containing
+ * parts covered by the terms of the Hugo License, the licensors of this
+ * Program grant you additional permission to convey the resulting work.
+ * Corresponding Source for a non-source form of such a combination shall
+ * include the source code for the parts of the Hugo Engine used as well as
+ * that of the covered work.
+ */
+#ifndef HEADLESSSESSION_H
+#define HEADLESSSESSION_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <ucontext.h>
+
+#include "hcheckpoint.h"
+#include "heheadless.h"
+
+
+// A game that suspends whenever it asks for input, instead of blocking the
+// thread that runs it. Each session runs on a coroutine stack of its own and
+// the engine state is swapped in when it's resumed, so a host can keep any
+// number of idle sessions around and only run them when the player does
+// something.
+//
+// Needs the engine built with HUGOR_SUSPENDABLE. Sessions can be resumed from
+// any thread, but only one of them runs at a time.
+class HeadlessSession {
+  public:
+    enum State {
+        // Not started yet.
+        Idle,
+        // Suspended until sendLine() or sendKey() is called.
+        WaitingForLine,
+        WaitingForKey,
+        // Suspended in the middle of a turn, after running a slice of
+        // statements (see HeadlessOptions::statementSlice.) Call resume().
+        Busy,
+        // The game has ended.
+        Finished
+    };
+
+    // The options' input stream is not used; input comes from sendLine() and
+    // sendKey() instead.
+    HeadlessSession( const HeadlessOptions& opts, const std::string& gameFile,
+                     size_t stackSize = 1024 * 1024 );
+
+    // A game that hasn't finished yet is ended as if the input ran out.
+    ~HeadlessSession();
+
+    HeadlessSession( const HeadlessSession& ) = delete;
+    HeadlessSession& operator =( const HeadlessSession& ) = delete;
+
+    // Runs the game until it asks for input or ends.
+    State
+    start();
+
+    // Resumes the game with the given input and runs it until it asks for
+    // input again or ends. A line sent while the game waits for a key is
+    // sent as its first character (or Enter, if it's empty.) A key sent while
+    // the game waits for a line is ignored.
+    State
+    sendLine( const std::string& line );
+
+    State
+    sendKey( int key );
+
+    // Continues a Busy game until it asks for input, ends, or runs another
+    // slice of statements.
+    State
+    resume();
+
+    State
+    state() const
+    { return this->fState; }
+
+    // Takes a checkpoint of a game that waits for a new command (see
+    // HCheckpoint.) Returns null if the game isn't waiting for one. Each
+    // checkpoint is based on the previous one, so successive checkpoints only
+    // copy what changed in between.
+    std::shared_ptr<const HCheckpoint>
+    checkpoint();
+
+    // Puts a game that waits for a new command back into the state of the
+    // checkpoint, which can come from any session of the same game. The game
+    // keeps waiting for a command. Returns false if the game isn't waiting for
+    // one, or the checkpoint is of a different game.
+    bool
+    restore( const HCheckpoint& cp );
+
+    // Starts a new session of the same game and restores the checkpoint into
+    // it. The new session gets there by running the game up to its first
+    // prompt, so its output starts with the game's introduction. Returns null
+    // if the checkpoint couldn't be restored.
+    std::unique_ptr<HeadlessSession>
+    fork( const HCheckpoint& cp, const HeadlessOptions& opts ) const;
+
+    // The game's exit code, once it finished.
+    int
+    exitCode() const
+    { return this->fExitCode; }
+
+    // Engine side. Suspend the current session until input arrives. They
+    // return false (or EOF) when the session is being destroyed instead.
+    static bool
+    suspendForLine( char* buf, int size );
+
+    static int
+    suspendForKey();
+
+    static bool
+    suspendForSlice();
+
+  private:
+    HeadlessOptions fOpts;
+    std::string fGameFile;
+    std::unique_ptr<char[]> fStack;
+    size_t fStackSize;
+    ucontext_t fContext;
+    ucontext_t fHostContext;
+
+    // This session's copy of the engine state while it's suspended.
+    std::unique_ptr<char[]> fEngineState;
+
+    State fState;
+    int fExitCode;
+    std::string fInput;
+    bool fClosing;
+
+    // Checkpoint work for the engine side to do while we wait for a line.
+    enum Request { NoRequest, TakeCheckpoint, RestoreCheckpoint };
+    Request fRequest;
+    const HCheckpoint* fRequestCheckpoint;
+    bool fRequestDone;
+    std::shared_ptr<const HCheckpoint> fLastCheckpoint;
+
+    bool
+    fRunRequest( Request req, const HCheckpoint* cp );
+
+    State
+    fResume();
+
+    static void
+    fRun();
+};
+
+
+#endif // HEADLESSSESSION_H
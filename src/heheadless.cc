@@ -0,0 +1,818 @@
+/* Copyright 2015 Nikos Chantziaras
+ *
+ * This file is part of Hugor.
+ *
+ * Hugor is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Hugor is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Hugor.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Additional permission under GNU GPL version 3 section 7
+ *
+ * If you modify this Program, or any covered work, by linking or combining it
+ * with the Hugo Engine (or a modified version of the Hugo Engine), containing
+ * parts covered by the terms of the Hugo License, the licensors of this
+ * Program grant you additional permission to convey the resulting work.
+ * Corresponding Source for a non-source form of such a combination shall
+ * include the source code for the parts of the Hugo Engine used as well as
+ * that of the covered work.
+ */
+// Implementation of the Hugo engine's system interface for the headless
+// interpreter. This is the counterpart of heqt.cc without any GUI: text goes
+// to a stream, input comes from a stream, and all text is measured in
+// fixed-size character cells.
+#include <chrono>
+#include <csetjmp>
+#include <cstdarg>
+#include <cstdlib>
+#include <cstring>
+
+#include "heheadless.h"
+#include "hgameindex.h"
+#include "hprofiler.h"
+#include "htracer.h"
+#include "hugorfile.h"
+#if defined (HUGOR_SUSPENDABLE)
+#include "headlesssession.h"
+#endif
+
+extern "C" {
+#include "heheader.h"
+}
+
+
+// Options of the game running on this thread.
+static HUGO_TLS HeadlessOptions headlessOpts;
+
+// Turn hashing state. The hash is 64-bit FNV-1a over the transcript text of
+// the current turn.
+static HUGO_TLS FILE* turnHashes = nullptr;
+static HUGO_TLS unsigned long long turnHash = 0;
+static HUGO_TLS bool turnHasText = false;
+static HUGO_TLS int turnNumber = 0;
+
+// Statement budget (see heqtheader.h.)
+static const long DEFAULT_STATEMENT_SLICE = 100000;
+HUGO_TLS long hugo_statementsleft = DEFAULT_STATEMENT_SLICE;
+
+// Milliseconds the game ran since it last asked for input, and when we last
+// added to that.
+static HUGO_TLS long long busyTime = 0;
+static HUGO_TLS long long busyCheckTime = 0;
+
+#if defined (HUGOR_SESSIONS)
+// Where runHeadlessSession() is waiting for the game to end, and its exit code.
+static HUGO_TLS std::jmp_buf* sessionExit = nullptr;
+static HUGO_TLS int sessionExitCode = 0;
+
+void
+hugo_exitsession( int n )
+{
+    sessionExitCode = n;
+    std::longjmp(*sessionExit, 1);
+}
+#endif
+
+
+static void
+finishProfile()
+{
+    if (HProfiler::isRunning() and not HProfiler::finish()) {
+        std::fprintf(stderr, "Can't write the profile.\n");
+    }
+    if (headlessOpts.traceFile and HTracer::isCapturing()) {
+        HTracer::stop();
+        if (not HTracer::dump(headlessOpts.traceFile)) {
+            std::fprintf(stderr, "Can't write the trace to %s\n", headlessOpts.traceFile);
+        }
+    }
+}
+
+
+// Ends the game. Unless we're reentrant, that ends the program too.
+static void
+endSession( int code )
+{
+#if defined (HUGOR_SESSIONS)
+    hugo_exitsession(code);
+#else
+    finishProfile();
+    std::exit(code);
+#endif
+}
+
+
+static long long
+currentTime()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+static void
+resetWatchdog()
+{
+    busyTime = 0;
+    busyCheckTime = currentTime();
+}
+
+
+static void
+putText( const char* s )
+{
+    if (inwindow and not headlessOpts.printWindows) {
+        return;
+    }
+    std::fputs(s, headlessOpts.output);
+}
+
+
+static void
+resetTurnHash()
+{
+    turnHash = 14695981039346656037ULL;
+    turnHasText = false;
+}
+
+
+static void
+endTurn()
+{
+    if (not turnHashes) {
+        return;
+    }
+    std::fprintf(turnHashes, "%d %016llx\n", turnNumber++, turnHash);
+    std::fflush(turnHashes);
+    resetTurnHash();
+}
+
+
+// Read a line from the input into 'buf', without the line terminator. We're
+// done when the input runs out. Suspendable sessions suspend here until the
+// host has a line for us.
+static void
+readLine( char* buf, int size )
+{
+    std::fflush(headlessOpts.output);
+    HProfiler::pause();
+#if defined (HUGOR_SUSPENDABLE)
+    const bool gotLine = HeadlessSession::suspendForLine(buf, size);
+#else
+    const bool gotLine = std::fgets(buf, size, headlessOpts.input) != nullptr;
+#endif
+    HProfiler::resume();
+    if (not gotLine) {
+        std::fputc('\n', headlessOpts.output);
+        std::fflush(headlessOpts.output);
+        hugo_closefiles();
+        endSession(0);
+    }
+    size_t len = std::strlen(buf);
+    while (len > 0 and (buf[len - 1] == '\n' or buf[len - 1] == '\r')) {
+        buf[--len] = '\0';
+    }
+    resetWatchdog();
+}
+
+
+void*
+hugo_blockalloc( long num )
+{
+    return new char[num];
+}
+
+
+void
+hugo_blockfree( void* block )
+{
+    if (block == mem) {
+        HGameIndex::unload();
+    }
+    delete[] static_cast<char*>(block);
+}
+
+
+void
+hugo_splitpath( char* path, char* drive, char* dir, char* fname, char* ext )
+{
+    drive[0] = '\0';
+    dir[0] = '\0';
+    fname[0] = '\0';
+    ext[0] = '\0';
+
+    if (path[0] == '\0')
+        return;
+
+    const char* base = std::strrchr(path, '/');
+#ifdef _WIN32
+    const char* bslash = std::strrchr(path, '\\');
+    if (bslash and (not base or bslash > base)) {
+        base = bslash;
+    }
+#endif
+    if (base) {
+        std::strncpy(dir, path, base - path);
+        dir[base - path] = '\0';
+        ++base;
+    } else {
+        base = path;
+    }
+    const char* dot = std::strrchr(base, '.');
+    if (dot and dot != base) {
+        std::strncpy(fname, base, dot - base);
+        fname[dot - base] = '\0';
+        std::strcpy(ext, dot + 1);
+    } else {
+        std::strcpy(fname, base);
+    }
+}
+
+
+void
+hugo_makepath( char* path, char* drive, char* dir, char* fname, char* ext )
+{
+    std::strcpy(path, drive);
+    std::strcat(path, dir);
+    const size_t len = std::strlen(path);
+    if (len > 0 and path[len - 1] != '/') {
+        std::strcat(path, "/");
+    }
+    std::strcat(path, fname);
+    if (ext[0] != '\0') {
+        std::strcat(path, ".");
+        std::strcat(path, ext);
+    }
+}
+
+
+/* There are no file dialogs, so we read the file name from the input, like
+   a command.
+*/
+void
+hugo_getfilename( char* a, char* b )
+{
+    std::fprintf(headlessOpts.output, "\nEnter path and filename %s (default %s): ", a, b);
+    readLine(line, MAXBUFFER);
+    std::fprintf(headlessOpts.output, "%s\n", line);
+    if (line[0] == '\0') {
+        std::strcpy(line, b);
+    }
+}
+
+
+int
+hugo_overwrite( char* )
+{
+    return true;
+}
+
+
+HUGO_FILE
+hugo_fopen( const char* path, const char* mode )
+{
+    auto handle = std::fopen(path, mode);
+    if (handle == nullptr) {
+        return nullptr;
+    }
+    return new HugorFile(handle);
+}
+
+int
+hugo_fclose( HUGO_FILE file )
+{
+    auto ret = file->close();
+    delete file;
+    return ret;
+}
+
+int
+hugo_fgetc( HUGO_FILE file )
+{
+    return std::fgetc(file->get());
+}
+
+int
+hugo_fseek( HUGO_FILE file, long offset, int whence )
+{
+    return std::fseek(file->get(), offset, whence);
+}
+
+long
+hugo_ftell( HUGO_FILE file )
+{
+    return std::ftell(file->get());
+}
+
+size_t
+hugo_fread( void* ptr, size_t size, size_t nmemb, HUGO_FILE file )
+{
+    return std::fread(ptr, size, nmemb, file->get());
+}
+
+char*
+hugo_fgets( char* s, int size, HUGO_FILE file )
+{
+    return std::fgets(s, size, file->get());
+}
+
+int
+hugo_fputc( int c, HUGO_FILE file )
+{
+    return std::fputc(c, file->get());
+}
+
+int
+hugo_fputs( const char* s, HUGO_FILE file )
+{
+    return std::fputs(s, file->get());
+}
+
+int
+hugo_ferror( HUGO_FILE file )
+{
+    return std::ferror(file->get());
+}
+
+int
+hugo_fprintf( HUGO_FILE file, const char* format, ... )
+{
+    va_list args;
+    va_start(args, format);
+    auto ret = std::vfprintf(file->get(), format, args);
+    va_end(args);
+    return ret;
+}
+
+
+void
+hugo_closefiles()
+{
+    delete game;
+    game = nullptr;
+    if (turnHashes) {
+        if (turnHasText) {
+            endTurn();
+        }
+        std::fclose(turnHashes);
+        turnHashes = nullptr;
+    }
+    if (script) {
+        hugo_fclose(script);
+        script = nullptr;
+    }
+    delete io;
+    io = nullptr;
+    delete record;
+    record = nullptr;
+    if (playback) {
+        hugo_fclose(playback);
+        playback = nullptr;
+    }
+}
+
+
+void
+hugo_sendtoscrollback( char* )
+{ }
+
+
+int
+hugo_writetoscript( const char* s )
+{
+    if (turnHashes) {
+        for (const unsigned char* c = reinterpret_cast<const unsigned char*>(s); *c; ++c) {
+            turnHash = (turnHash ^ *c) * 1099511628211ULL;
+        }
+        turnHasText = true;
+    }
+    return std::fputs(s, script->get()) < 0 ? -1 : 0;
+}
+
+
+/* Keys are read from the input one character at a time. A newline counts
+   as Enter.
+*/
+int
+hugo_getkey( void )
+{
+    std::fflush(headlessOpts.output);
+    HProfiler::pause();
+#if defined (HUGOR_SUSPENDABLE)
+    int c = HeadlessSession::suspendForKey();
+#else
+    int c = std::fgetc(headlessOpts.input);
+#endif
+    HProfiler::resume();
+    if (c == EOF) {
+        std::fflush(headlessOpts.output);
+        hugo_closefiles();
+        endSession(0);
+    }
+    if (c == '\n') {
+        c = '\r';
+    }
+    resetWatchdog();
+    return c;
+}
+
+
+void
+hugo_getline( char* p )
+{
+    if (script) {
+        hugo_writetoscript(p);
+        endTurn();
+    }
+    putText(p);
+    readLine(buffer, MAXBUFFER);
+
+    // Echo the command, so that the output reads like a transcript.
+    putText(buffer);
+    putText("\n");
+    if (script) {
+        hugo_writetoscript(buffer);
+        hugo_writetoscript("\n");
+    }
+}
+
+
+int
+hugo_waitforkey( void )
+{
+    return hugo_getkey();
+}
+
+
+/* There's nobody to press keys in real time. */
+int
+hugo_iskeywaiting( void )
+{
+    return false;
+}
+
+
+/* We run as fast as possible. */
+int
+hugo_timewait( int )
+{
+    resetWatchdog();
+    return true;
+}
+
+
+void
+hugo_budgetexhausted( long addr )
+{
+    hugo_statementsleft = headlessOpts.statementSlice > 0 ? headlessOpts.statementSlice
+                                                          : DEFAULT_STATEMENT_SLICE;
+    busyTime += currentTime() - busyCheckTime;
+#if defined (HUGOR_SUSPENDABLE)
+    // Let the host run other sessions in between. The time we spend suspended
+    // doesn't count.
+    if (not HeadlessSession::suspendForSlice()) {
+        hugo_closefiles();
+        endSession(0);
+    }
+#endif
+    busyCheckTime = currentTime();
+
+    if (headlessOpts.watchdogSeconds > 0 and busyTime >= headlessOpts.watchdogSeconds * 1000LL) {
+        std::fflush(headlessOpts.output);
+        std::fprintf(stderr, "Game busy for %d seconds without asking for input, running the "
+                     "block at $%lX, code position $%lX. Stopping it.\n",
+                     headlessOpts.watchdogSeconds, addr, codeptr);
+        hugo_closefiles();
+        endSession(WATCHDOG_EXIT_CODE);
+    }
+}
+
+
+void
+hugo_init_screen( void )
+{
+    resetWatchdog();
+    if (headlessOpts.transcriptFile) {
+        script = hugo_fopen(headlessOpts.transcriptFile, "wt");
+        if (not script) {
+            std::fprintf(stderr, "Can't open transcript file: %s\n", headlessOpts.transcriptFile);
+            endSession(1);
+        }
+        if (headlessOpts.turnHashFile) {
+            turnHashes = std::fopen(headlessOpts.turnHashFile, "w");
+            if (not turnHashes) {
+                std::fprintf(stderr, "Can't open turn hash file: %s\n", headlessOpts.turnHashFile);
+                endSession(1);
+            }
+            resetTurnHash();
+        }
+    }
+    if (headlessOpts.playbackFile) {
+        playback = hugo_fopen(headlessOpts.playbackFile, "rt");
+        if (not playback) {
+            std::fprintf(stderr, "Can't open playback file: %s\n", headlessOpts.playbackFile);
+        }
+    }
+}
+
+
+int
+hugo_hasgraphics( void )
+{
+    // Report the same as the GUI does by default, so that games take the
+    // same code paths. Pictures are simply not drawn.
+    return true;
+}
+
+
+void
+hugo_setgametitle( char* )
+{ }
+
+
+void
+hugo_cleanup_screen( void )
+{
+    std::fflush(headlessOpts.output);
+}
+
+
+void
+hugo_clearfullscreen( void )
+{
+    currentpos = 0;
+    currentline = 1;
+    TB_Clear(0, 0, screenwidth, screenheight);
+}
+
+
+void
+hugo_clearwindow( void )
+{
+    currentpos = 0;
+    currentline = 1;
+    TB_Clear(physical_windowleft, physical_windowtop,
+             physical_windowright, physical_windowbottom);
+}
+
+
+/* Everything is measured in character cells. */
+void
+hugo_settextmode( void )
+{
+    FIXEDCHARWIDTH = 1;
+    FIXEDLINEHEIGHT = 1;
+    ::charwidth = 1;
+    lineheight = 1;
+    SCREENWIDTH = headlessOpts.screenWidth;
+    SCREENHEIGHT = headlessOpts.screenHeight;
+    hugo_settextwindow(1, 1, SCREENWIDTH, SCREENHEIGHT);
+}
+
+
+void
+hugo_settextwindow( int left, int top, int right, int bottom )
+{
+    physical_windowleft = left - 1;
+    physical_windowtop = top - 1;
+    physical_windowright = right - 1;
+    physical_windowbottom = bottom - 1;
+    physical_windowwidth = physical_windowright - physical_windowleft + 1;
+    physical_windowheight = physical_windowbottom - physical_windowtop + 1;
+}
+
+
+void
+hugo_settextpos( int x, int y )
+{
+    currentline = y;
+    currentpos = x - 1;
+    current_text_x = physical_windowleft + currentpos;
+    current_text_y = physical_windowtop + y - 1;
+}
+
+
+void
+printFatalError( char* a )
+{
+    std::fflush(headlessOpts.output);
+    std::fprintf(stderr, "%s", a);
+}
+
+
+void
+hugo_print( char* a )
+{
+    // Output isn't paged; we never want a [MORE] prompt to eat our input.
+    full = 0;
+
+    for (; *a != '\0'; ++a) {
+        switch (static_cast<unsigned char>(*a)) {
+          case '\r':
+            break;
+          case 151:
+            putText("--");
+            break;
+          case 145:
+          case 146:
+            putText("'");
+            break;
+          case 147:
+          case 148:
+            putText("\"");
+            break;
+          default: {
+            const char s[2] = { *a, '\0' };
+            putText(s);
+          }
+        }
+    }
+}
+
+
+void
+hugo_scrollwindowup()
+{
+    // Once the text reaches the bottom of the screen, the engine scrolls
+    // instead of printing a newline, so the scroll is our line break.
+    putText("\n");
+    TB_Scroll();
+}
+
+
+void
+hugo_font( int )
+{ }
+
+
+void
+hugo_settextcolor( int )
+{ }
+
+
+void
+hugo_setbackcolor( int )
+{ }
+
+
+int
+hugo_charwidth( char a )
+{
+    if (a == FORCED_SPACE) {
+        a = ' ';
+    }
+    if (static_cast<unsigned char>(a) < ' ') {
+        return 0;
+    }
+    return 1;
+}
+
+
+int
+hugo_textwidth( char* a )
+{
+    return hugo_strlen(a);
+}
+
+
+int
+hugo_strlen( char* a )
+{
+    size_t len = 0;
+    size_t slen = std::strlen(a);
+
+    for (size_t i = 0; i < slen; ++i) {
+        if (a[i] == COLOR_CHANGE) {
+            i += 2;
+        } else if (a[i] == FONT_CHANGE) {
+            ++i;
+        } else {
+            ++len;
+        }
+    }
+    return len;
+}
+
+
+int
+hugo_displaypicture( HUGO_FILE infile, long )
+{
+    hugo_fclose(infile);
+    return true;
+}
+
+
+int
+hugo_playmusic( HUGO_FILE infile, long, char )
+{
+    hugo_fclose(infile);
+    return true;
+}
+
+
+void
+hugo_musicvolume( int )
+{ }
+
+
+void
+hugo_stopmusic( void )
+{ }
+
+
+int
+hugo_playsample( HUGO_FILE infile, long, char )
+{
+    hugo_fclose(infile);
+    return true;
+}
+
+
+void
+hugo_samplevolume( int )
+{ }
+
+
+void
+hugo_stopsample( void )
+{ }
+
+
+int
+hugo_hasvideo( void )
+{
+    return false;
+}
+
+
+void
+hugo_stopvideo( void )
+{ }
+
+
+int
+hugo_playvideo( HUGO_FILE infile, long, char, char, int )
+{
+    hugo_fclose(infile);
+    return true;
+}
+
+
+void
+hugo_prewarmmedia( int )
+{ }
+
+
+void
+hugo_gameloaded( void )
+{ }
+
+
+int
+runHeadlessSession( const HeadlessOptions& opts, const char* gameFile )
+{
+    headlessOpts = opts;
+    if (opts.traceFile) {
+        HTracer::setThreadName("engine");
+        HTracer::start();
+    }
+    if (opts.profileFile) {
+        HProfiler::start(opts.profileFile);
+    }
+    if (opts.sampleFile) {
+        HProfiler::startSampling(opts.sampleFile,
+                                 opts.sampleRate > 0 ? opts.sampleRate : DEFAULT_SAMPLE_RATE);
+    }
+    char argv0[] = PROGRAM_NAME;
+    char* engineArgv[] = { argv0, const_cast<char*>(gameFile), nullptr };
+#if defined (HUGOR_SESSIONS)
+    std::jmp_buf jump;
+    int ret;
+    sessionExit = &jump;
+    if (setjmp(jump) == 0) {
+        ret = he_main(2, engineArgv);
+    } else {
+        // Not every way out of the engine cleans up after the game.
+        ret = sessionExitCode;
+        hugo_closefiles();
+        if (mem) {
+            hugo_blockfree(mem);
+            mem = nullptr;
+        }
+    }
+    sessionExit = nullptr;
+#else
+    const int ret = he_main(2, engineArgv);
+#endif
+    finishProfile();
+    std::fflush(headlessOpts.output);
+    return ret;
+}
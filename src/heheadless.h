@@ -0,0 +1,99 @@
+/* Copyright 2015 Nikos Chantziaras
+ *
+ * This file is part of Hugor.
+ *
+ * Hugor is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Hugor is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Hugor.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Additional permission under GNU GPL version 3 section 7
+ *
+ * If you modify this Program, or any covered work, by linking or combining it
+ * with the Hugo Engine (or a modified version of the Hugo Engine), containing
+ * parts covered by the terms of the Hugo License, the licensors of this
+ * Program grant you additional permission to convey the resulting work.
+ * Corresponding Source for a non-source form of such a combination shall
+ * include the source code for the parts of the Hugo Engine used as well as
+ * that of the covered work.
+ */
+#ifndef HEHEADLESS_H
+#define HEHEADLESS_H
+
+#include <cstdio>
+
+
+// Options of the headless interpreter. Set up by main() before the engine
+// starts.
+struct HeadlessOptions {
+    // Where game text goes, and where commands and keypresses come from.
+    FILE* output;
+    FILE* input;
+
+    // Screen size, in character cells.
+    int screenWidth;
+    int screenHeight;
+
+    // Also print text that games print into windows (like the status line.)
+    // By default, only the main text window is printed.
+    bool printWindows;
+
+    // Commands to play back before reading input, or null.
+    const char* playbackFile;
+
+    // Write a transcript to this file, or null. The engine writes it through
+    // hugo_writetoscript(), just like when a game turns scripting on.
+    const char* transcriptFile;
+
+    // Write a hash of each turn's transcript text to this file, or null. One
+    // "turn hash" line per turn, where a turn ends with the next input
+    // prompt. Needs a transcript.
+    const char* turnHashFile;
+
+    // End the game when it runs for this many seconds without asking for
+    // input, or 0 for no limit.
+    int watchdogSeconds;
+
+    // Statements the game runs between checks of the watchdog. In a
+    // HeadlessSession, the game also yields to the host after each of these
+    // slices. 0 for the default.
+    long statementSlice;
+
+    // Profile the game and write the report to this file, or null (see
+    // HProfiler.)
+    const char* profileFile;
+
+    // Sample the game this many times per second and write the samples to
+    // this file, or null.
+    const char* sampleFile;
+    int sampleRate;
+
+    // Capture a trace and write it to this file when the game ends, or null
+    // (see HTracer.)
+    const char* traceFile;
+};
+
+// Exit code of a game that the watchdog stopped.
+const int WATCHDOG_EXIT_CODE = 124;
+
+// Runs a game on the calling thread and returns its exit code.
+//
+// When built with HUGOR_REENTRANT, the engine state is thread-local and any
+// number of threads can run a game at the same time. The engine doesn't reset
+// all of its state when a game starts though, so each thread can only run a
+// single game.
+//
+// When built with HUGOR_SUSPENDABLE, use HeadlessSession instead.
+int
+runHeadlessSession( const HeadlessOptions& opts, const char* gameFile );
+
+
+#endif // HEHEADLESS_H
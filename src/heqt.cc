@@ -26,19 +26,28 @@
  * that of the covered work.
  */
 #include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
 #include <QFileInfo>
+#include <QMap>
 #include <QTextCodec>
 #include <QTextLayout>
 #include <QThread>
 #include <QTimer>
 #include <QTextCodec>
-#include <QMutexLocker>
 #include <cstdarg>
 
 #include "happlication.h"
 #include "hmainwindow.h"
 #include "hmarginwidget.h"
 #include "hframe.h"
+#include "hframepacer.h"
+#include "hgameindex.h"
+#include "hprofiler.h"
+#include "hcheckpoint.h"
+#include "hmetrics.h"
+#include "htracer.h"
 #include "settings.h"
 #include "hugodefs.h"
 #include "hugohandlers.h"
@@ -48,6 +57,7 @@
 
 extern "C" {
 #include "heheader.h"
+extern char skipping_more;
 }
 
 
@@ -56,15 +66,6 @@ extern "C" {
 static const char* CONTROL_FNAME = "HrCtlAPI";
 static const char* CHECK_FNAME = "HrCheck";
 
-// Exposes QThread::msleep(), which is protected.
-class SleepFuncs: public QThread {
-public:
-    using QThread::msleep;
-};
-
-// Used to wait on the GUI thread for a condition.
-static QMutex* waiterMutex = 0;
-
 // Buffer for the script file. We don't immediately write text to the script
 // file. We write to the buffer instead and flush it to the file when needed.
 static QString* scriptBuffer = 0;
@@ -81,6 +82,41 @@ static HugorFile ctrlFile(nullptr);
 // Opcode parser.
 static OpcodeParser opcodeParser;
 
+// The playback file we're fast-forwarding through, and whether a marker line
+// in it has stopped the fast-forward.
+static HUGO_FILE fastForwardFile = nullptr;
+static bool fastForwardMarkerHit = false;
+
+// Statements the engine runs between looking at how long the game has been
+// busy.
+static const long STATEMENT_SLICE = 100000;
+HUGO_TLS long hugo_statementsleft = STATEMENT_SLICE;
+
+// Time since the game last waited for input or for a timer.
+static QElapsedTimer busyClock;
+
+// Put around front end calls that block the engine for as long as the player
+// likes, like file dialogs and videos, or that wait for the media engines. The
+// time they take counts neither as the game being busy nor as time spent in
+// its code.
+class FrontEndWait {
+  public:
+    FrontEndWait()
+    { HProfiler::pause(); }
+
+    ~FrontEndWait()
+    {
+        HProfiler::resume();
+        busyClock.start();
+    }
+
+    FrontEndWait( const FrontEndWait& ) = delete;
+    FrontEndWait& operator =( const FrontEndWait& ) = delete;
+};
+
+// The checkpoint of the last quick save.
+static std::shared_ptr<const HCheckpoint> quickSave;
+
 
 /* Helper routine. Converts a Hugo color to a Qt color.
  */
@@ -116,6 +152,25 @@ hugoColorToQt( int color )
 }
 
 
+/* Fast-forward through command playback. Nothing is presented and MORE
+   prompts are skipped until the playback ends, a line in the playback file
+   starts with '#', or the game asks for a key.
+ */
+static void
+updateFastForward()
+{
+    if (::playback != fastForwardFile) {
+        fastForwardFile = ::playback;
+        fastForwardMarkerHit = false;
+    }
+    const bool enable = ::playback != nullptr and not fastForwardMarkerHit;
+    if (enable) {
+        skipping_more = true;
+    }
+    hFrame->setFastForward(enable);
+}
+
+
 static void
 flushScriptBuffer()
 {
@@ -172,6 +227,41 @@ flushScrollbackBuffer()
 }
 
 
+/* Quick save or load while the game waits for a line. The input line is
+   interrupted, a note is printed and the prompt is shown again with whatever
+   was typed so far.
+ */
+static void
+runCheckpointRequest( HFrame::CheckpointRequest req, char* prompt )
+{
+    runInMainThread([]{
+        hFrame->interruptInput();
+        hHandlers->endGetline();
+    });
+
+    const char* msg;
+    if (not HCheckpoint::atTurnPrompt()) {
+        msg = req == HFrame::QuickSaveRequest ? "[Can't quick save here.]" : "[Can't quick load here.]";
+    } else if (req == HFrame::QuickSaveRequest) {
+        quickSave = HCheckpoint::take(quickSave.get());
+        msg = "[Quick saved.]";
+    } else if (quickSave == nullptr or not quickSave->matchesGame()) {
+        msg = "[Nothing to quick load.]";
+    } else {
+        quickSave->restore();
+        msg = "[Quick loaded.]";
+    }
+    hugo_print(const_cast<char*>(msg));
+    hugo_print(const_cast<char*>("\r\n"));
+    hugo_sendtoscrollback(const_cast<char*>("\n"));
+    hugo_sendtoscrollback(const_cast<char*>(msg));
+    hugo_sendtoscrollback(const_cast<char*>("\n"));
+    hugo_sendtoscrollback(prompt);
+    flushScrollbackBuffer();
+    runInMainThread([prompt]{hHandlers->startGetline(prompt);});
+}
+
+
 void*
 hugo_blockalloc( long num )
 {
@@ -182,6 +272,9 @@ hugo_blockalloc( long num )
 void
 hugo_blockfree( void* block )
 {
+    if (block == mem) {
+        HGameIndex::unload();
+    }
     delete[] static_cast<char*>(block);
 }
 
@@ -258,6 +351,7 @@ hugo_makepath( char* path, char* drive, char* dir, char* fname, char* ext )
 void
 hugo_getfilename( char* a, char* b )
 {
+    FrontEndWait wait;
     runInMainThread([a, b]{hHandlers->getfilename(a, b);});
 }
 
@@ -330,7 +424,12 @@ hugo_fgetc( HUGO_FILE file )
         }
         return EOF;
     }
-    return std::fgetc(file->get());
+    static HCounter& bytesRead = HMetrics::counter("file.bytes_read");
+    const int c = std::fgetc(file->get());
+    if (c != EOF) {
+        bytesRead.add();
+    }
+    return c;
 }
 
 int
@@ -359,7 +458,10 @@ hugo_fread(void* ptr, size_t size, size_t nmemb, HUGO_FILE file)
         qDebug() << Q_FUNC_INFO;
         return 0;
     }
-    return std::fread(ptr, size, nmemb, file->get());
+    static HCounter& bytesRead = HMetrics::counter("file.bytes_read");
+    const size_t n = std::fread(ptr, size, nmemb, file->get());
+    bytesRead.add(n * size);
+    return n;
 }
 
 char*
@@ -369,6 +471,18 @@ hugo_fgets(char* s, int size, HUGO_FILE file )
         qDebug() << Q_FUNC_INFO;
         return nullptr;
     }
+    if (file == ::playback) {
+        // Marker lines aren't commands. They end the fast-forward, so that the
+        // rest of the playback is shown normally.
+        char* line;
+        while ((line = std::fgets(s, size, file->get())) != nullptr and line[0] == '#') {
+            fastForwardMarkerHit = true;
+        }
+        if (fastForwardMarkerHit) {
+            hFrame->setFastForward(false);
+        }
+        return line;
+    }
     return std::fgets(s, size, file->get());
 }
 
@@ -475,12 +589,15 @@ hugo_getkey( void )
     }
     flushScrollbackBuffer();
 
-    QMutexLocker mLocker(waiterMutex);
-    if (not hugo_iskeywaiting()) {
-        hFrame->keypressAvailableWaitCond.wait(waiterMutex);
+    // The player has to see what they're answering.
+    hFrame->setFastForward(false);
+    HProfiler::pause();
+    {
+        HTraceScope trace("key wait", "input");
+        hFrame->waitForKey();
     }
-    mLocker.unlock();
-
+    HProfiler::resume();
+    busyClock.start();
     int key = hFrame->getNextKey();
     if (key == 0) {
         // It's a mouse click.
@@ -493,6 +610,42 @@ hugo_getkey( void )
 }
 
 
+/* Start of the turn in progress, for turn latency metrics and the "turn"
+   spans in traces. A turn runs from the moment the player's input is read to
+   the next input prompt.
+*/
+static HTracer::Clock::time_point turnStart;
+
+
+/* Updates the metrics that are sampled once per turn.
+*/
+static void
+updateTurnMetrics()
+{
+    static HCounter& turns = HMetrics::counter("turn.count");
+    static HHistogram& latency = HMetrics::histogram("turn.latency_us");
+    // Undo operations the last turn recorded. MAXUNDO or more means the turn
+    // was too complex to undo.
+    static HGauge& undoOps = HMetrics::gauge("undo.turn_ops");
+    static HGauge& undoCapacity = HMetrics::gauge("undo.capacity");
+    static HGauge& tbUsed = HMetrics::gauge("textbuffer.cells_used");
+    static HGauge& tbCapacity = HMetrics::gauge("textbuffer.capacity");
+
+    const auto now = HTracer::Clock::now();
+    if (turnStart != HTracer::Clock::time_point()) {
+        turns.add();
+        latency.record(now - turnStart);
+        if (HTracer::isCapturing()) {
+            HTracer::record("turn", "engine", turnStart, now);
+        }
+    }
+    undoOps.set(undoturn);
+    undoCapacity.set(MAXUNDO);
+    tbUsed.set(tb_used);
+    tbCapacity.set(MAX_TEXTBUFFER_COUNT);
+}
+
+
 /* hugo_getline
 
     Gets a line of input from the keyboard, storing it in <buffer>.
@@ -500,6 +653,7 @@ hugo_getkey( void )
 void
 hugo_getline( char* p )
 {
+    updateTurnMetrics();
     if (::script != NULL) {
         hugo_writetoscript(p);
         flushScriptBuffer();
@@ -507,11 +661,24 @@ hugo_getline( char* p )
     hugo_sendtoscrollback(p);
     flushScrollbackBuffer();
 
-    QMutexLocker mLocker(waiterMutex);
+    // Playback is over; show everything it produced in one go.
+    updateFastForward();
+    HProfiler::pause();
     runInMainThread([p]{hHandlers->startGetline(p);});
-    hFrame->inputLineWaitCond.wait(waiterMutex);
+    {
+        HTraceScope trace("input wait", "input");
+        hFrame->waitForInputLine();
+        HFrame::CheckpointRequest req;
+        while ((req = hFrame->takeCheckpointRequest()) != HFrame::NoCheckpointRequest) {
+            runCheckpointRequest(req, p);
+            hFrame->waitForInputLine();
+        }
+    }
+    HProfiler::resume();
+    turnStart = HTracer::Clock::now();
     hFrame->getInput(::buffer, MAXBUFFER);
     runInMainThread([]{hHandlers->endGetline();});
+    busyClock.start();
 
     // Also copy the input to the script file (if there is one) and the
     // scrollback.
@@ -549,7 +716,10 @@ int
 hugo_iskeywaiting( void )
 {
     //qDebug(Q_FUNC_INFO);
-    runInMainThread([]{hFrame->updateGameScreen(false);});
+    // Games that poll in a loop call this a lot, so we don't wait for the GUI
+    // thread here. It presents what we've drawn so far on its own time.
+    hFrame->schedulePresent();
+    busyClock.start();
     return hFrame->hasKeyInQueue();
 }
 
@@ -562,14 +732,48 @@ int
 hugo_timewait( int n )
 {
     //qDebug() << Q_FUNC_INFO;
-    if (hApp->gameRunning() and n > 0) {
-        SleepFuncs::msleep(1000 / n);
-        runInMainThread([]{hFrame->updateGameScreen(false);});
+    if (hApp->gameRunning() and n > 0 and not hFrame->isFastForwarding()) {
+        // The frame the game just drew is done, so show it now and then wait
+        // for the next frame to begin. Presenting doesn't block us. Animated
+        // games might not poll for keys, so resizes are picked up here too.
+        hFrame->applyDisplayChanges();
+        hFrame->updateGameScreen(false);
+        HProfiler::pause();
+        HTraceScope trace("timewait", "input");
+        hFramePacer->wait(n);
+        HProfiler::resume();
     }
+    busyClock.start();
     return true;
 }
 
 
+/* Called by RunRoutine() every STATEMENT_SLICE statements. A game that runs
+   for longer than the watchdog allows without asking for input is probably
+   stuck in a loop, so we ask the player whether to stop it.
+*/
+void
+hugo_budgetexhausted( long addr )
+{
+    hugo_statementsleft = STATEMENT_SLICE;
+
+    // Show what the game printed so far and give the GUI some room.
+    hFrame->schedulePresent();
+    QThread::yieldCurrentThread();
+
+    const int limit = hApp->settings()->engineWatchdog;
+    if (limit <= 0 or busyClock.elapsed() < limit * 1000LL) {
+        return;
+    }
+    const int seconds = busyClock.elapsed() / 1000;
+    qWarning("Game busy for %d seconds, running the block at $%lX, code position $%lX",
+             seconds, addr, codeptr);
+    runInMainThread([addr, seconds]{hHandlers->reportRunawayGame(addr, seconds);});
+    // The player chose to wait. Ask again after another full period.
+    busyClock.start();
+}
+
+
 /* DISPLAY CONTROL:
 
    Briefly, the variables required to interface with the engine's output
@@ -608,9 +812,10 @@ hugo_timewait( int n )
 void
 hugo_init_screen( void )
 {
-    waiterMutex = new QMutex;
     scriptBuffer = new QString;
     scrollbackBuffer = new QByteArray;
+    hFramePacer = new HFramePacer;
+    busyClock.start();
 }
 
 
@@ -639,9 +844,10 @@ hugo_setgametitle( char* t )
 void
 hugo_cleanup_screen( void )
 {
-    delete waiterMutex;
     delete scriptBuffer;
     delete scrollbackBuffer;
+    delete hFramePacer;
+    hFramePacer = 0;
 }
 
 
@@ -651,7 +857,7 @@ hugo_cleanup_screen( void )
 void
 hugo_clearfullscreen( void )
 {
-    runInMainThread([]{hHandlers->clearfullscreen();});
+    hHandlers->clearfullscreen();
     currentpos = 0;
     currentline = 1;
     TB_Clear(0, 0, screenwidth, screenheight);
@@ -664,7 +870,7 @@ hugo_clearfullscreen( void )
 void
 hugo_clearwindow( void )
 {
-    runInMainThread([]{hHandlers->clearwindow();});
+    hHandlers->clearwindow();
     currentpos = 0;
     currentline = 1;
     TB_Clear(physical_windowleft, physical_windowtop,
@@ -706,7 +912,10 @@ hugo_clearwindow( void )
 void
 hugo_settextmode( void )
 {
-    runInMainThread([]{hHandlers->settextmode();});
+    // Pick up the current size of the window first. Setting up the text mode
+    // only involves the back buffer, so we don't need the GUI thread for it.
+    hFrame->applyDisplayChanges();
+    hHandlers->settextmode();
 }
 
 
@@ -784,11 +993,18 @@ printFatalError( char* a )
 */
 /* Output <a>, taking into account fore/background color,
    font, current window, etc.
+
+   Text is rendered into HFrame's back buffer right here on the engine
+   thread. The GUI thread only presents published frames, so we don't need
+   to block on it.
 */
 void
 hugo_print( char* a )
 {
-    runInMainThread([a]{hHandlers->print(a);});
+    if (::playback != nullptr) {
+        updateFastForward();
+    }
+    hHandlers->print(a);
 }
 
 
@@ -797,8 +1013,8 @@ hugo_print( char* a )
 void
 hugo_scrollwindowup()
 {
-    runInMainThread([]{hFrame->scrollUp(physical_windowleft, physical_windowtop, physical_windowright,
-                                        physical_windowbottom, lineheight);});
+    hFrame->scrollUp(physical_windowleft, physical_windowtop, physical_windowright,
+                     physical_windowbottom, lineheight);
     TB_Scroll();
 }
 
@@ -812,21 +1028,21 @@ hugo_scrollwindowup()
 void
 hugo_font( int f )
 {
-    runInMainThread([f]{hHandlers->font(f);});
+    hHandlers->font(f);
 }
 
 
 void
 hugo_settextcolor( int c )
 {
-    runInMainThread([c]{hHandlers->settextcolor(c);});
+    hHandlers->settextcolor(c);
 }
 
 
 void
 hugo_setbackcolor( int c )
 {
-    runInMainThread([c]{hHandlers->setbackcolor(c);});
+    hHandlers->setbackcolor(c);
 }
 
 
@@ -904,11 +1120,92 @@ hugo_strlen( char* a )
 }
 
 
+/* Add the files in <dir> to <files>, keyed by lower-case name.
+*/
+static void
+listFiles( const char* dir, QMap<QString, QString>& files )
+{
+    if (dir == nullptr or *dir == '\0') {
+        return;
+    }
+    const QDir qdir(QString::fromLocal8Bit(dir));
+    for (const QString& name : qdir.entryList(QDir::Files)) {
+        files.insert(name.toLower(), qdir.filePath(name));
+    }
+}
+
+
+/* Does the dictionary name a resource file we can find the way FindResource()
+   does? Resource files start with an 'r' or 'R'.
+*/
+static bool
+gameRefersToResourceFile()
+{
+    QMap<QString, QString> files;
+    listFiles(gamepath, files);
+    listFiles(getenv("HUGO_GAMES"), files);
+    listFiles(getenv("HUGO_OBJECT"), files);
+    if (files.isEmpty()) {
+        return false;
+    }
+
+    bool found = false;
+    unsigned int ptr = 0;
+    defseg = dicttable;
+    for (int i = 1; i <= dictcount and not found; ++i) {
+        const int len = Peek(ptr + 2);
+        if (len > 0) {
+            const QString& path = files.value(QString::fromLatin1(GetString(ptr + 2)).toLower());
+            QFile file(path);
+            char c;
+            found = not path.isEmpty() and file.open(QIODevice::ReadOnly) and file.getChar(&c)
+                    and (c == 'r' or c == 'R');
+        }
+        ptr += len + 1;
+    }
+    defseg = gameseg;
+    return found;
+}
+
+
+/* A game that refers to a resource file probably has music or sound in it.
+   Bring the sound engine up in the background now, so the first sound
+   doesn't have to wait for it. Text-only games never start it.
+*/
+void
+hugo_gameloaded( void )
+{
+    HTraceScope trace("media hint", "media");
+    const Settings* sett = hApp->settings();
+    if ((sett->enableMusic or sett->enableSoundEffects) and gameRefersToResourceFile()) {
+        hApp->prewarmMediaEngines(HApplication::SoundEngine);
+    }
+}
+
+
+/* The engine is about to look up a resource of type <restype> to play it.
+   Start the engine it needs in the background, so that it comes up while
+   FindResource() does its work; hugo_playmusic() and friends wait for it.
+*/
+void
+hugo_prewarmmedia( int restype )
+{
+    const Settings* sett = hApp->settings();
+    if ((restype == MUSIC_T and sett->enableMusic) or (restype == SOUND_T and sett->enableSoundEffects)) {
+        hApp->prewarmMediaEngines(HApplication::SoundEngine);
+    } else if (restype == VIDEO_T and sett->enableVideo) {
+        hApp->prewarmMediaEngines(HApplication::VideoEngine);
+    }
+}
+
+
 int
 hugo_displaypicture( HUGO_FILE infile, long len )
 {
+    // Image decoding and scaling happens on the engine thread too.
+    HTraceScope trace("displaypicture", "media");
     int result;
-    runInMainThread([infile, len, &result]{hHandlers->displaypicture(infile, len, &result);});
+    hHandlers->displaypicture(infile, len, &result);
     return result;
 }
 
@@ -916,6 +1213,12 @@ hugo_displaypicture( HUGO_FILE infile, long len )
 int
 hugo_playmusic( HUGO_FILE infile, long len, char loop_flag )
 {
+    HTraceScope trace("playmusic", "media");
+    if (hApp->settings()->enableMusic) {
+        // Wait for the sound engine here, not in the GUI thread.
+        FrontEndWait wait;
+        hApp->initMediaEngines(HApplication::SoundEngine);
+    }
     int result;
     runInMainThread([infile, len, loop_flag, &result]{hHandlers->playmusic(infile, len, loop_flag, &result);});
     return result;
@@ -939,6 +1242,11 @@ hugo_stopmusic( void )
 int
 hugo_playsample( HUGO_FILE infile, long len, char loop_flag )
 {
+    HTraceScope trace("playsample", "media");
+    if (hApp->settings()->enableSoundEffects) {
+        FrontEndWait wait;
+        hApp->initMediaEngines(HApplication::SoundEngine);
+    }
     int result;
     runInMainThread([infile, len, loop_flag, &result]{hHandlers->playsample(infile, len, loop_flag, &result);});
     return result;
@@ -989,7 +1297,15 @@ hugo_playvideo( HUGO_FILE infile, long, char, char, int )
 int
 hugo_hasvideo( void )
 {
-    if (hApp->settings()->enableVideo and not hApp->settings()->videoSysError) {
+    if (not hApp->settings()->enableVideo) {
+        return false;
+    }
+    // We only know whether video works once the video engine is up.
+    {
+        FrontEndWait wait;
+        hApp->initMediaEngines(HApplication::VideoEngine);
+    }
+    if (not hApp->settings()->videoSysError) {
         return true;
     }
     return false;
@@ -1006,6 +1322,12 @@ hugo_stopvideo( void )
 int
 hugo_playvideo( HUGO_FILE infile, long len, char loop, char bg, int vol )
 {
+    HTraceScope trace("playvideo", "media");
+    // Videos that don't play in the background only return once they're over.
+    FrontEndWait wait;
+    if (hApp->settings()->enableVideo) {
+        hApp->initMediaEngines(HApplication::VideoEngine);
+    }
     int result;
     runInMainThread([infile, len, loop, bg, vol, &result]{
         hHandlers->playvideo(infile, len, loop, bg, vol, &result);
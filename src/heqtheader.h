@@ -73,6 +73,77 @@ typedef struct HugorFile HugorFile;
 #define HUGO_FCLOSE
 #define HUGO_FSEEK hugo_fseek
 
+/* With HUGOR_REENTRANT, all engine state is thread-local, so that each thread
+ * can run a game of its own.
+ *
+ * With HUGOR_SUSPENDABLE, all engine state is kept together in the
+ * "hugo_state" section instead, so that HeadlessSession can swap it in and
+ * out when it suspends a game waiting for input and resumes another. This
+ * needs GCC or Clang and an ELF linker.
+ *
+ * Either way, exit() then only ends the current game; the front end
+ * implements hugo_exitsession() to unwind back to where it called he_main().
+ */
+#if defined (HUGOR_REENTRANT)
+#if defined (_MSC_VER)
+#define HUGO_TLS __declspec(thread)
+#else
+#define HUGO_TLS __thread
+#endif
+#elif defined (HUGOR_SUSPENDABLE)
+#define HUGO_TLS __attribute__((section("hugo_state")))
+#endif
+
+#if defined (HUGOR_REENTRANT) || defined (HUGOR_SUSPENDABLE)
+#define HUGOR_SESSIONS
+#if !defined (__cplusplus)
+#define exit(n) hugo_exitsession(n)
+#endif
+#endif
+
+#if !defined (HUGO_TLS)
+#define HUGO_TLS
+#endif
+
+/* RunRoutine() counts statements down from hugo_statementsleft and calls
+ * hugo_budgetexhausted() when it runs out. The front end decides what to do
+ * about a game that runs for long without asking for input, and sets a new
+ * budget. While sampling, the position of each statement is also handed to
+ * the sampler, which can't read codeptr from its own thread.
+ */
+#define HUGO_STATEMENT_HOOK(addr) \
+    do { \
+        if (--hugo_statementsleft < 0) hugo_budgetexhausted(addr); \
+        if (hugo_sampling) hugo_profilestatement(codeptr); \
+    } while (0)
+
+/* Profiling (see src/hprofiler.h.) While the profiler is off, the hooks only
+ * test a flag. Routine calls are also tracked when only sampling.
+ */
+#define HUGO_ENTER_HOOK(addr, call) \
+    do { if (hugo_tracecalls) hugo_profileenter(addr, call); } while (0)
+#define HUGO_LEAVE_HOOK(addr) \
+    do { if (hugo_tracecalls) hugo_profileleave(addr); } while (0)
+#define HUGO_TOKEN_HOOK(t) \
+    do { if (hugo_profiling) hugo_profiletoken(t); } while (0)
+
+/* Tracing (see src/htracer.h.) */
+#define HUGO_TRACE_BEGIN(name) hugo_tracebegin(name)
+#define HUGO_TRACE_END(name) hugo_traceend(name)
+
+/* Media backends are started on demand (see HApplication::prewarmMediaEngines.)
+ */
+#define HUGO_MEDIA_HOOK(restype) hugo_prewarmmedia(restype)
+
+/* Game index (see src/hgameindex.h.) The index is loaded before the front end
+ * gets to look at the game.
+ */
+#define HUGO_LOADED_HOOK() \
+    do { hugo_loadindex(); hugo_gameloaded(); } while (0)
+#define HUGO_FINDWORD_HOOK(a, ptr, i) hugo_indexfindword(a, ptr, i)
+#define HUGO_VERB_HOOK(word, ptr) ((ptr) = hugo_indexverb(word, ptr))
+#define HUGO_PROPADDR_HOOK(obj, p, ptr) hugo_indexpropaddr(obj, p, ptr)
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -98,6 +169,26 @@ int hugo_fputc(int c, HUGO_FILE file);
 int hugo_fputs(const char* s, HUGO_FILE file);
 int hugo_ferror(HUGO_FILE file);
 int hugo_fprintf(HUGO_FILE file, const char* format, ...);
+extern HUGO_TLS long hugo_statementsleft;
+void hugo_budgetexhausted(long addr);
+extern HUGO_TLS char hugo_profiling;
+extern HUGO_TLS char hugo_tracecalls;
+extern HUGO_TLS char hugo_sampling;
+void hugo_profilestatement(long pos);
+void hugo_profileenter(long addr, int call);
+void hugo_profileleave(long addr);
+void hugo_profiletoken(int t);
+void hugo_tracebegin(const char* name);
+void hugo_traceend(const char* name);
+void hugo_prewarmmedia(int restype);
+void hugo_gameloaded(void);
+void hugo_loadindex(void);
+int hugo_indexfindword(const char* a, unsigned int* ptr, int* i);
+unsigned int hugo_indexverb(unsigned int word, unsigned int ptr);
+int hugo_indexpropaddr(int obj, int p, unsigned int* ptr);
+#if defined (HUGOR_SESSIONS)
+void hugo_exitsession(int n);
+#endif
 #ifdef __cplusplus
 }
 #endif
@@ -33,6 +33,10 @@
 #include <QTimer>
 #include <QTextCodec>
 #include <QMenu>
+#include <QThread>
+#include <QScreen>
+#include <cmath>
+#include <cstring>
 
 extern "C" {
 #include "heheader.h"
@@ -44,15 +48,42 @@ extern "C" {
 #include "hugodefs.h"
 #include "settings.h"
 #include "hugohandlers.h"
+#include "hmetrics.h"
+#include "htracer.h"
 
 
 HFrame* hFrame = 0;
 
+// Maximum number of display list items. Games that draw a lot of small,
+// overlapping things without ever clearing the screen could otherwise make the
+// list grow without bound.
+static const int MAX_DISPLAY_ITEMS = 4096;
+
+// Maximum number of cell windows we keep track of, and of cached glyphs.
+static const int MAX_CELL_WINDOWS = 4;
+static const int MAX_GLYPHS = 4096;
+
+
+// Returns the font to use for the given Hugo font flags, based on the given
+// proportional and fixed fonts.
+static QFont
+fontForHugoFont( int hugoFont, const QFont& propFont, const QFont& fixedFont )
+{
+    QFont f((hugoFont & PROP_FONT) ? propFont : fixedFont);
+    f.setUnderline(hugoFont & UNDERLINE_FONT);
+    f.setItalic(hugoFont & ITALIC_FONT);
+    f.setBold(hugoFont & BOLD_FONT);
+    return f;
+}
+
 
 HFrame::HFrame( QWidget* parent )
     : QWidget(parent),
       fInputMode(NoInput),
       fInputReady(false),
+      fCheckpointRequest(NoCheckpointRequest),
+      fResizePending(false),
+      fDisplayChanges(0),
       fInputStartX(0),
       fInputStartY(0),
       fInputCurrentChar(0),
@@ -60,12 +91,28 @@ HFrame::HFrame( QWidget* parent )
       fCurHistIndex(0),
       fFgColor(16), // Default text color
       fBgColor(17), // Default background color
-      fUseFixedFont(false),
-      fUseUnderlineFont(false),
-      fUseItalicFont(false),
-      fUseBoldFont(false),
+      fHugoFont(PROP_FONT),
       fFontMetrics(QFont()),
-      fPixmap(1, 1),
+      fPropFont(hApp->settings()->propFont),
+      fFixedFont(hApp->settings()->fixedFont),
+      fFrameFgColor(16),
+      fFrameBgColor(17),
+      fFrameHugoFont(PROP_FONT),
+      fBackBuffer(1, 1, QImage::Format_ARGB32_Premultiplied),
+      fWidgetSize(1, 1),
+      fNewPropFont(fPropFont),
+      fNewFixedFont(fFixedFont),
+      fBackScrollDebt(0),
+      fPublishedScroll(0),
+      fScrollReset(false),
+      fFrameInterval(16),
+      fPresentScheduled(false),
+      fPresentTimer(new QTimer(this)),
+      fFastForward(false),
+      fScrollOffset(0),
+      fScrollTimer(new QTimer(this)),
+      fDisplayListValid(true),
+      fOpenCellWindow(-1),
       fFlushXPos(0),
       fFlushYPos(0),
       fCursorPos(0, 0),
@@ -84,7 +131,8 @@ HFrame::HFrame( QWidget* parent )
     //this->setCursorVisible(true);
 
     // Our initial height is the height of the current proportional font.
-    this->fHeight = QFontMetrics(hApp->settings()->propFont).height();
+    this->fHeight = QFontMetrics(fPropFont).height();
+    fFrameLineHeight = fHeight;
 
     // We need to check whether the application lost focus.
     connect(qApp, SIGNAL(focusChanged(QWidget*,QWidget*)), SLOT(fHandleFocusChange(QWidget*,QWidget*)));
@@ -92,12 +140,27 @@ HFrame::HFrame( QWidget* parent )
     fMinimizeTimer->setSingleShot(true);
     connect(fMinimizeTimer, SIGNAL(timeout()), SLOT(fHandleFocusLost()));
 
+    // Run the scrolling animation at the display's refresh rate.
+    const QScreen* screen = QGuiApplication::primaryScreen();
+    if (screen and screen->refreshRate() > 0) {
+        fFrameInterval = qMax(1, qRound(1000.0 / screen->refreshRate()));
+    }
+    fScrollTimer->setTimerType(Qt::PreciseTimer);
+    fScrollTimer->setInterval(fFrameInterval);
+    connect(fScrollTimer, SIGNAL(timeout()), SLOT(fAnimateScroll()));
+    fPresentTimer->setSingleShot(true);
+    fPresentTimer->setTimerType(Qt::PreciseTimer);
+    connect(fPresentTimer, SIGNAL(timeout()), SLOT(fHandlePresentRequest()));
+    fPublishClock.start();
+
     // Requesting scrollback simply triggers the scrollback window.
     // Since focus is lost, subsequent scrolling/paging events will work as expected.
     connect(this, SIGNAL(requestScrollback()), hMainWin, SLOT(showScrollback()));
 
     this->setAttribute(Qt::WA_InputMethodEnabled);
     this->setAttribute(Qt::WA_OpaquePaintEvent);
+    fBackBuffer.fill(hugoColorToQt(fBgColor));
+    fFrontBuffer = fBackBuffer;
     hFrame = this;
 }
 
@@ -105,20 +168,412 @@ HFrame::HFrame( QWidget* parent )
 void
 HFrame::fEnqueueKey(char key, QMouseEvent* e)
 {
-    QMutexLocker mKeyLocker(&fKeyQueueMutex);
-    QMutexLocker mClickLocker(&fClickQueueMutex);
-    // Only allow one keypress or click in the queue. No reason to use a queue
-    // for that, but we might still want the possibilty to change this to allow
-    // multiple keys/clicks to queue up, if the need for that arises.
-    if (fKeyQueue.empty()) {
-        fKeyQueue.enqueue(key);
-        if (e) {
-            fClickQueue.append(e->pos());
+    HInputEvent ev;
+    ev.type = e ? HInputEvent::Click : HInputEvent::Key;
+    ev.key = key;
+    if (e) {
+        ev.pos = e->pos();
+    }
+    ev.timestamp = QElapsedTimer::msecsSinceReference();
+    // If the queue is full, the game isn't reading input anyway.
+    fInputQueue.push(ev);
+}
+
+
+void
+HFrame::fSkipResizeEvents()
+{
+    HInputEvent ev;
+    while (fInputQueue.peek(&ev) and ev.type == HInputEvent::Resize) {
+        fInputQueue.pop(&ev);
+        fResizePending = false;
+    }
+}
+
+
+void
+HFrame::fFinishFrame()
+{
+    flushText();
+    QMutexLocker locker(&fBufferMutex);
+    fCommitCells();
+    fFrameFgColor = this->fFgColor;
+    fFrameBgColor = this->fBgColor;
+    fFrameHugoFont = this->fHugoFont;
+    fFrameLineHeight = this->fFontMetrics.height();
+}
+
+
+void
+HFrame::fFillRect( const QRect& rect )
+{
+    QMutexLocker locker(&fBufferMutex);
+    fDropCells(rect);
+    QPainter p(&fBackBuffer);
+    p.fillRect(rect, hugoColorToQt(this->fBgColor));
+    fNeedScreenUpdate = true;
+
+    DisplayItem item;
+    item.type = DisplayItem::Fill;
+    item.rect = rect;
+    item.bgColor = this->fBgColor;
+    fRecord(item);
+}
+
+
+void
+HFrame::fRecord( const DisplayItem& item )
+{
+    if (not fDisplayListValid or item.rect.isEmpty()) {
+        return;
+    }
+
+    // Drop everything the new item paints over. Images might be transparent,
+    // so they don't cover anything.
+    if (item.type != DisplayItem::Image or not item.image.hasAlphaChannel()) {
+        int j = 0;
+        for (int i = 0; i < fDisplayList.size(); ++i) {
+            const DisplayItem& old = fDisplayList.at(i);
+            const QRect visible = old.clip.isNull() ? old.rect : old.rect & old.clip;
+            if (not item.rect.contains(visible)) {
+                if (i != j) {
+                    fDisplayList[j] = old;
+                }
+                ++j;
+            }
+        }
+        fDisplayList.resize(j);
+    }
+
+    if (fDisplayList.size() >= MAX_DISPLAY_ITEMS) {
+        fDisplayListValid = false;
+        fDisplayList.clear();
+        return;
+    }
+    fDisplayList.append(item);
+    if (item.type == DisplayItem::Text and fDisplayList.size() > 1) {
+        const DisplayItem& prev = fDisplayList.at(fDisplayList.size() - 2);
+        fDisplayList.last().continues = prev.type == DisplayItem::Text
+                                        and prev.rect.top() == item.rect.top()
+                                        and prev.rect.right() + 1 == item.rect.left();
+    }
+}
+
+
+void
+HFrame::fScrollDisplayList( const QRect& rect, int h )
+{
+    if (not fDisplayListValid) {
+        return;
+    }
+    int j = 0;
+    for (int i = 0; i < fDisplayList.size(); ++i) {
+        DisplayItem& item = fDisplayList[i];
+        const QRect visible = item.clip.isNull() ? item.rect : item.rect & item.clip;
+        if (visible.intersects(rect)) {
+            if (not rect.contains(visible)) {
+                // Part of the item scrolls and part of it doesn't. We can't
+                // represent that.
+                fDisplayListValid = false;
+                fDisplayList.clear();
+                return;
+            }
+            item.rect.translate(0, -h);
+            item.clip = visible.translated(0, -h) & rect;
+            if (item.clip.isEmpty()) {
+                // Scrolled out completely.
+                continue;
+            }
+        }
+        if (i != j) {
+            fDisplayList[j] = item;
+        }
+        ++j;
+    }
+    fDisplayList.resize(j);
+}
+
+
+void
+HFrame::fRenderDisplayList( QImage& img )
+{
+    // Text items are kept at their position, except for those that continue
+    // a previous one; those are moved to wherever the previous one ends with
+    // the current font.
+    QPainter p(&img);
+    p.setBackgroundMode(Qt::OpaqueMode);
+    int nextX = 0;
+    for (int i = 0; i < fDisplayList.size(); ++i) {
+        DisplayItem& item = fDisplayList[i];
+        if (item.type == DisplayItem::Text) {
+            const QFont f(fontForHugoFont(item.hugoFont, fPropFont, fFixedFont));
+            const QFontMetrics m(f, &img);
+            const int x = item.continues ? nextX : item.rect.left();
+            const QRect newRect(x, item.rect.top(), m.width(item.text), m.height());
+            if (not item.clip.isNull()) {
+                item.clip.translate(newRect.left() - item.rect.left(), 0);
+            }
+            item.rect = newRect;
+            nextX = newRect.left() + newRect.width();
+            if (item.clip.isNull()) {
+                p.setClipping(false);
+            } else {
+                p.setClipRect(item.clip);
+            }
+            p.setFont(f);
+            p.setPen(hugoColorToQt(item.fgColor));
+            p.setBackground(QBrush(hugoColorToQt(item.bgColor)));
+            p.drawText(item.rect.left(), item.rect.top() + m.ascent(), item.text);
+            continue;
+        }
+        if (item.clip.isNull()) {
+            p.setClipping(false);
+        } else {
+            p.setClipRect(item.clip);
+        }
+        if (item.type == DisplayItem::Fill) {
+            p.fillRect(item.rect, hugoColorToQt(item.bgColor));
+        } else {
+            p.drawImage(item.rect.topLeft(), item.image);
+        }
+    }
+}
+
+
+bool
+HFrame::fOpenCells( const QRect& rect )
+{
+    fCommitCells();
+    if (FIXEDCHARWIDTH <= 0 or FIXEDLINEHEIGHT <= 0 or this->fBgColor > 0xff
+        or rect.left() % FIXEDCHARWIDTH != 0 or rect.top() % FIXEDLINEHEIGHT != 0
+        or rect.width() < FIXEDCHARWIDTH or rect.height() < FIXEDLINEHEIGHT)
+    {
+        return false;
+    }
+
+    // Windows that overlap this one are going to be painted over.
+    int index = -1;
+    for (int i = fCellWindows.size() - 1; i >= 0; --i) {
+        if (fCellWindows.at(i).rect == rect) {
+            index = i;
+        } else if (fCellWindows.at(i).rect.intersects(rect)) {
+            fCellWindows.removeAt(i);
+            if (index > i) {
+                --index;
+            }
+        }
+    }
+    if (index < 0) {
+        if (fCellWindows.size() >= MAX_CELL_WINDOWS) {
+            fCellWindows.removeFirst();
+        }
+        CellWindow w;
+        w.rect = rect;
+        w.cols = rect.width() / FIXEDCHARWIDTH;
+        w.rows = rect.height() / FIXEDLINEHEIGHT;
+        w.shownValid = false;
+        w.shownClearColor = -1;
+        fCellWindows.append(w);
+        index = fCellWindows.size() - 1;
+    }
+    CellWindow& w = fCellWindows[index];
+    w.clearColor = this->fBgColor;
+    w.pending.fill(fCellKey(' ', 0, this->fBgColor, 0), w.cols * w.rows);
+    fOpenCellWindow = index;
+    return true;
+}
+
+
+bool
+HFrame::fPrintCells()
+{
+    if (fOpenCellWindow < 0 or (this->fHugoFont & (PROP_FONT | ITALIC_FONT))
+        or this->fFgColor > 0xff or this->fBgColor > 0xff)
+    {
+        return false;
+    }
+    CellWindow& w = fCellWindows[fOpenCellWindow];
+    const int x = this->fFlushXPos - w.rect.left();
+    const int y = this->fFlushYPos - w.rect.top();
+    if (x < 0 or y < 0 or x % FIXEDCHARWIDTH != 0 or y % FIXEDLINEHEIGHT != 0) {
+        return false;
+    }
+    const int col = x / FIXEDCHARWIDTH;
+    const int row = y / FIXEDLINEHEIGHT;
+    const int len = this->fPrintBuffer.length();
+    if (row >= w.rows or col + len > w.cols
+        or currentFontMetrics().width(this->fPrintBuffer) != len * FIXEDCHARWIDTH
+        or currentFontMetrics().height() != FIXEDLINEHEIGHT)
+    {
+        return false;
+    }
+    for (int i = 0; i < len; ++i) {
+        w.pending[row * w.cols + col + i] = fCellKey(this->fPrintBuffer.at(i).unicode(),
+                                                     this->fFgColor, this->fBgColor,
+                                                     this->fHugoFont);
+    }
+    return true;
+}
+
+
+void
+HFrame::fCommitCells()
+{
+    if (fOpenCellWindow < 0) {
+        return;
+    }
+    CellWindow& w = fCellWindows[fOpenCellWindow];
+    fOpenCellWindow = -1;
+
+    QPainter p(&fBackBuffer);
+    if (not w.shownValid or w.shownClearColor != w.clearColor) {
+        p.fillRect(w.rect, hugoColorToQt(w.clearColor));
+        w.shown.fill(fCellKey(' ', 0, w.clearColor, 0), w.cols * w.rows);
+        w.shownValid = true;
+        w.shownClearColor = w.clearColor;
+    }
+    // Text is drawn one pixel below its position (see flushText()), so we do
+    // the same with the cells.
+    for (int i = 0; i < w.pending.size(); ++i) {
+        if (w.pending.at(i) != w.shown.at(i)) {
+            p.drawImage(w.rect.left() + (i % w.cols) * FIXEDCHARWIDTH,
+                        w.rect.top() + (i / w.cols) * FIXEDLINEHEIGHT + 1, fGlyph(w.pending.at(i)));
+            w.shown[i] = w.pending.at(i);
+        }
+    }
+    fNeedScreenUpdate = true;
+}
+
+
+void
+HFrame::fDropCells( const QRect& rect )
+{
+    fCommitCells();
+    for (int i = fCellWindows.size() - 1; i >= 0; --i) {
+        if (fCellWindows.at(i).rect.intersects(rect)) {
+            fCellWindows.removeAt(i);
         }
     }
-    mKeyLocker.unlock();
-    mClickLocker.unlock();
-    keypressAvailableWaitCond.wakeAll();
+}
+
+
+quint64
+HFrame::fCellKey( ushort ch, int fgColor, int bgColor, int hugoFont ) const
+{
+    // All blank cells of the same background color look the same.
+    if (ch == ' ' and not (hugoFont & UNDERLINE_FONT)) {
+        fgColor = 0;
+        hugoFont = 0;
+    }
+    return quint64(ch) | (quint64(fgColor) << 16) | (quint64(bgColor) << 24)
+           | (quint64(hugoFont) << 32);
+}
+
+
+const QImage&
+HFrame::fGlyph( quint64 key )
+{
+    QHash<quint64, QImage>::const_iterator it = fGlyphCache.constFind(key);
+    if (it != fGlyphCache.constEnd()) {
+        return it.value();
+    }
+    if (fGlyphCache.size() >= MAX_GLYPHS) {
+        fGlyphCache.clear();
+    }
+
+    const QChar ch(ushort(key & 0xffff));
+    const int fgColor = (key >> 16) & 0xff;
+    const int bgColor = (key >> 24) & 0xff;
+    const int hugoFont = (key >> 32) & 0xff;
+    QImage img(FIXEDCHARWIDTH, FIXEDLINEHEIGHT, QImage::Format_ARGB32_Premultiplied);
+    img.fill(hugoColorToQt(bgColor));
+    if (ch != QLatin1Char(' ') or (hugoFont & UNDERLINE_FONT)) {
+        const QFont f(fontForHugoFont(hugoFont, fPropFont, fFixedFont));
+        QPainter p(&img);
+        p.setFont(f);
+        p.setPen(hugoColorToQt(fgColor));
+        p.drawText(0, QFontMetrics(f, &img).ascent(), QString(ch));
+    }
+    return fGlyphCache.insert(key, img).value();
+}
+
+
+HStaticTextCache&
+HFrame::fTextCache()
+{
+    if (QThread::currentThread() == this->thread()) {
+        return fGuiTextCache;
+    }
+    return fEngineTextCache;
+}
+
+
+void
+HFrame::fPresentFrame()
+{
+    static HCounter& framesPresented = HMetrics::counter("frames.presented");
+    framesPresented.add();
+
+    // Pick up any scrolling that happened in the frames published since the
+    // last time we were called.
+    fBufferMutex.lock();
+    if (fScrollReset) {
+        fScrollOffset = 0;
+        fScrollReset = false;
+    }
+    fScrollOffset += fPublishedScroll;
+    fPublishedScroll = 0;
+    fScrollOffset = qMin(fScrollOffset, qreal(fFrontScrollStrip.height()));
+    const int bgColor = fFrameBgColor;
+    this->fHeight = fFrameLineHeight;
+    fBufferMutex.unlock();
+
+    if (fScrollOffset > 0 and not fScrollTimer->isActive()) {
+        fScrollClock.start();
+        fScrollTimer->start();
+    }
+
+    hApp->updateMargins(bgColor);
+    hApp->marginWidget()->update();
+    update();
+}
+
+
+void
+HFrame::fHandlePresentRequest()
+{
+    fBufferMutex.lock();
+    const qint64 remaining = fFrameInterval - fPublishClock.elapsed();
+    fBufferMutex.unlock();
+    if (remaining > 0) {
+        fPresentTimer->start(remaining);
+        return;
+    }
+    // Clear the flag first, so that anything drawn after we publish will
+    // request another frame. The engine thread has already drawn everything
+    // that was pending when it asked for this.
+    fPresentScheduled = false;
+    publishFrame(false);
+}
+
+
+void
+HFrame::fAnimateScroll()
+{
+    const qreal elapsed = fScrollClock.restart();
+
+    // Scroll at least as fast as one text line every 12ms, which is the speed
+    // at which the engine used to scroll line by line. If we fall further
+    // behind (because a lot of text arrived at once), catch up
+    // exponentially.
+    const qreal minStep = elapsed * fHeight / 12.0;
+    const qreal step = fScrollOffset * (1.0 - std::exp(-elapsed / 60.0));
+    fScrollOffset -= qMax(step, minStep);
+    if (fScrollOffset <= 0) {
+        fScrollOffset = 0;
+        fScrollTimer->stop();
+    }
+    update();
 }
 
 
@@ -183,7 +638,6 @@ HFrame::fHandleFocusLost()
 void
 HFrame::fEndInputMode( bool addToHistory )
 {
-    this->fInputReady = true;
     this->fInputMode = NoInput;
     // The current command only needs to be appended to the history if
     // it's not empty and differs from the previous command in the history.
@@ -201,9 +655,10 @@ HFrame::fEndInputMode( bool addToHistory )
         }
     }
     this->fCurHistIndex = 0;
-    // Make the input text part of the display pixmap.
-    printText(fInputBuf.toLatin1().constData(), fInputStartX, fInputStartY);
-    inputLineWaitCond.wakeAll();
+    // The engine thread prints the input text when it picks it up in
+    // getInput().
+    fInputReady = true;
+    fInputQueue.notify();
 }
 
 
@@ -211,29 +666,73 @@ void
 HFrame::paintEvent( QPaintEvent* e )
 {
     //qDebug(Q_FUNC_INFO);
+    HTraceScope trace("paint", "gui");
+    // Take a reference to the current frame. The engine thread might publish
+    // a new one while we're painting; that's fine, since we only hold a
+    // shallow copy and it will schedule another update anyway.
+    fBufferMutex.lock();
+    const QImage frame(fFrontBuffer);
+    const QImage strip(fFrontScrollStrip);
+    const QRect scrollRect(fFrontScrollRect);
+    const int fgColor = fFrameFgColor;
+    const int bgColor = fFrameBgColor;
+    const int hugoFont = fFrameHugoFont;
+    fBufferMutex.unlock();
+    const int offset = qBound(0, qRound(fScrollOffset), strip.height());
+
     QPainter p(this);
     p.setClipRegion(e->region());
-    p.drawPixmap(e->rect(), fPixmap, e->rect());
+
+    // After a resize, the frame doesn't fit us until the engine thread gets
+    // to draw a new one. Whatever it doesn't cover is filled with the
+    // background color.
+    if (frame.size() != this->size()) {
+        p.fillRect(e->rect(), hugoColorToQt(bgColor));
+    }
+
+    if (offset == 0) {
+        p.drawImage(e->rect(), frame, e->rect());
+    } else {
+        // Everything outside the scrolling region is drawn as-is.
+        p.setClipRegion(e->region() - scrollRect);
+        p.drawImage(e->rect(), frame, e->rect());
+
+        // The region itself is drawn shifted down by the current offset. The
+        // gap at its top is filled with rows that were already scrolled out.
+        p.setClipRegion(e->region() & scrollRect);
+        p.drawImage(QPoint(scrollRect.left(), scrollRect.top() + offset), frame,
+                    QRect(scrollRect.left(), scrollRect.top(), scrollRect.width(),
+                          scrollRect.height() - offset));
+        p.drawImage(scrollRect.topLeft(), strip,
+                    QRect(0, strip.height() - offset, strip.width(), offset));
+        p.setClipRegion(e->region());
+
+        // The input line and caret need to move along with the text.
+        if (scrollRect.contains(this->fCursorPos)) {
+            p.translate(0, offset);
+        }
+    }
 
     // Draw our current input. We need to do this here, after the pixmap
     // has already been painted, so that the input gets painted on top.
     // Otherwise, we could not erase text during editing.
     if (this->fInputMode == NormalInput and not this->fInputBuf.isEmpty()) {
-        QFont f(this->fUseFixedFont ? hApp->settings()->fixedFont : hApp->settings()->propFont);
-        f.setUnderline(this->fUseUnderlineFont);
-        f.setItalic(this->fUseItalicFont);
-        f.setBold(this->fUseBoldFont);
+        QFont f(fontForHugoFont(hugoFont, hApp->settings()->propFont,
+                                hApp->settings()->fixedFont));
         QFontMetrics m(f);
         p.setFont(f);
-        p.setPen(hugoColorToQt(this->fFgColor));
-        p.setBackgroundMode(Qt::OpaqueMode);
-        p.setBackground(QBrush(hugoColorToQt(this->fBgColor)));
-        p.drawText(this->fInputStartX, this->fInputStartY + m.ascent() + 1, this->fInputBuf);
+        p.setPen(hugoColorToQt(fgColor));
+        // Static text is always drawn transparently, so we fill in the
+        // background ourselves.
+        p.fillRect(this->fInputStartX, this->fInputStartY + 1, m.width(this->fInputBuf), m.height(),
+                   hugoColorToQt(bgColor));
+        p.drawStaticText(this->fInputStartX, this->fInputStartY + 1,
+                         fTextCache().get(this->fInputBuf, f));
     }
 
     // Likewise, the input caret needs to be painted on top of the input text.
     if (this->fCursorVisible and this->fBlinkVisible) {
-        p.setPen(hugoColorToQt(this->fFgColor));
+        p.setPen(hugoColorToQt(fgColor));
         p.drawLine(this->fCursorPos.x(), this->fCursorPos.y() + 1,
                    this->fCursorPos.x(), this->fCursorPos.y() + 1 + this->fHeight);
     }
@@ -250,25 +749,37 @@ HFrame::resizeEvent( QResizeEvent* e )
         return;
     }
 
-    // Save a copy of the current pixmaps.
-    const QPixmap& tmp = fPixmap.copy();
-
     // Adjust the margins so that we get our final size.
     hApp->updateMargins(-1);
 
-    // Create new pixmaps, using the new size and fill it with the default
-    // background color.
-    QPixmap newPixmap(size());
-    newPixmap.fill(hugoColorToQt(fBgColor));
-
-    // Draw the saved pixmaps into the new ones and use them as our new
-    // display.
-    QPainter p(&newPixmap);
-    p.drawPixmap(0, 0, tmp);
-    fPixmap = newPixmap;
-
-    hHandlers->settextmode();
-    display_needs_repaint = true;
+    // Only the engine thread draws, so resizing the back buffer and setting
+    // up the text mode for the new size are left to it. Until it's done, we
+    // keep presenting the last frame.
+    fBufferMutex.lock();
+    fWidgetSize = size();
+    fBufferMutex.unlock();
+    fDisplayChanges.fetch_or(ResizeChange);
+
+    // Scrolled out rows no longer line up with anything. Stop scrolling.
+    fScrollOffset = 0;
+    fScrollTimer->stop();
+
+    // Let the engine thread know, unless it hasn't picked up the last resize
+    // yet. If it's waiting for an input line, it won't look at the queue, so
+    // it needs waking up either way.
+    if (fResizePending.exchange(true)) {
+        fInputQueue.notify();
+        return;
+    }
+    HInputEvent ev;
+    ev.type = HInputEvent::Resize;
+    ev.key = 0;
+    ev.pos = QPoint(width(), height());
+    ev.timestamp = QElapsedTimer::msecsSinceReference();
+    if (not fInputQueue.push(ev)) {
+        fResizePending = false;
+        fInputQueue.notify();
+    }
 }
 
 
@@ -527,12 +1038,84 @@ HFrame::startInput( int xPos, int yPos )
     this->fInputMode = NormalInput;
     this->fInputStartX = xPos;
     this->fInputStartY = yPos;
-    this->fInputCurrentChar = 0;
+    // The buffer isn't empty if the previous input was interrupted.
+    this->fInputCurrentChar = this->fInputBuf.size();
+
+    // Insert whatever was typed while the game wasn't reading a line. The
+    // engine thread is blocked while we're called, so it's safe to consume
+    // the queue here. Clicks and resizes mean nothing to line input. We stop
+    // at the first Return; anything after it is left for the next line.
+    HInputEvent ev;
+    while (fInputQueue.pop(&ev)) {
+        if (ev.type == HInputEvent::Resize) {
+            fResizePending = false;
+            continue;
+        }
+        if (ev.type != HInputEvent::Key) {
+            continue;
+        }
+        if (ev.key == '\r' or ev.key == '\n') {
+            this->updateCursorPos();
+            fEndInputMode(true);
+            return;
+        }
+        const QChar c = QChar::fromLatin1(ev.key);
+        if (c.isPrint()) {
+            this->fInputBuf.insert(this->fInputCurrentChar, c);
+            ++this->fInputCurrentChar;
+        }
+    }
+    if (not this->fInputBuf.isEmpty()) {
+        this->updateCursorPos();
+    }
+}
 
-    QMutexLocker mKeyLocker(&fKeyQueueMutex);
-    QMutexLocker mClickLocker(&fClickQueueMutex);
-    fKeyQueue.clear();
-    fClickQueue.clear();
+
+void
+HFrame::waitForInputLine()
+{
+    do {
+        fInputQueue.wait([this]{
+            return fInputReady.load() or fCheckpointRequest.load() != NoCheckpointRequest
+                   or fDisplayChanges.load() != 0;
+        });
+    } while (applyDisplayChanges());
+}
+
+
+void
+HFrame::requestCheckpoint( CheckpointRequest req )
+{
+    // Only while reading a line. Requests at other times would be picked up
+    // at some later, unexpected point.
+    if (this->fInputMode != NormalInput or fInputReady) {
+        return;
+    }
+    fCheckpointRequest = req;
+    fInputQueue.notify();
+}
+
+
+HFrame::CheckpointRequest
+HFrame::takeCheckpointRequest()
+{
+    return static_cast<CheckpointRequest>(fCheckpointRequest.exchange(NoCheckpointRequest));
+}
+
+
+void
+HFrame::interruptInput()
+{
+    this->fInputMode = NoInput;
+    this->update();
+}
+
+
+void
+HFrame::waitForKey()
+{
+    updateGameScreen(false);
+    fInputQueue.wait([this]{ return hasKeyInQueue(); });
 }
 
 
@@ -540,6 +1123,8 @@ void
 HFrame::getInput(char* buf, size_t buflen)
 {
     Q_ASSERT(buf != 0);
+    // Make the input text part of the display.
+    printText(this->fInputBuf, fInputStartX, fInputStartY);
     qstrncpy(buf, this->fInputBuf.toLatin1(), buflen);
     fInputBuf.clear();
 }
@@ -549,26 +1134,32 @@ int
 HFrame::getNextKey()
 {
     //qDebug() << Q_FUNC_INFO;
-    QMutexLocker mLocker(&fKeyQueueMutex);
-    Q_ASSERT(not fKeyQueue.isEmpty());
-    return fKeyQueue.dequeue();
+    fSkipResizeEvents();
+    HInputEvent ev;
+    bool ok = fInputQueue.pop(&ev);
+    Q_ASSERT(ok);
+    Q_UNUSED(ok);
+    if (ev.type == HInputEvent::Click) {
+        this->fLastClick = ev.pos;
+        return 0;
+    }
+    return ev.key;
 }
 
 
 QPoint
 HFrame::getNextClick()
 {
-    QMutexLocker mLocker(&fClickQueueMutex);
-    Q_ASSERT(not this->fClickQueue.isEmpty());
-    return this->fClickQueue.dequeue();
+    return this->fLastClick;
 }
 
 
 bool
 HFrame::hasKeyInQueue()
 {
-    QMutexLocker mLocker(&fKeyQueueMutex);
-    return not fKeyQueue.isEmpty();
+    applyDisplayChanges();
+    fSkipResizeEvents();
+    return not fInputQueue.isEmpty();
 }
 
 
@@ -577,17 +1168,53 @@ HFrame::clearRegion( int left, int top, int right, int bottom )
 {
     //qDebug(Q_FUNC_INFO);
     flushText();
-    fNeedScreenUpdate = true;
     if (left == 0 and top == 0 and right == 0 and bottom == 0) {
-        fPixmap.fill(hugoColorToQt(this->fBgColor));
+        QMutexLocker locker(&fBufferMutex);
+        fBackBuffer.fill(hugoColorToQt(this->fBgColor));
+        fNeedScreenUpdate = true;
+        fBackScrollDebt = fPublishedScroll = 0;
+        fScrollReset = true;
+
+        // Nothing that was on the screen before matters anymore, so this is
+        // also where we get to start over with a usable display list.
+        fDisplayList.clear();
+        fDisplayListValid = true;
+        fCellWindows.clear();
+        fOpenCellWindow = -1;
+        DisplayItem item;
+        item.type = DisplayItem::Fill;
+        item.rect = fBackBuffer.rect();
+        item.bgColor = this->fBgColor;
+        fRecord(item);
         return;
     }
-    QPainter p(&fPixmap);
     QRect rect(left, top, right - left + 1, bottom - top + 1);
-    p.fillRect(rect, hugoColorToQt(this->fBgColor));
+    fBufferMutex.lock();
+    if (fOpenCells(rect)) {
+        // The window is actually cleared once we know what's printed into it.
+        DisplayItem item;
+        item.type = DisplayItem::Fill;
+        item.rect = rect;
+        item.bgColor = this->fBgColor;
+        fRecord(item);
+        fBufferMutex.unlock();
+    } else {
+        fBufferMutex.unlock();
+        fFillRect(rect);
+    }
+
+    // If the region we're smooth scrolling was cleared, what scrolled out of
+    // it no longer belongs above it.
+    fBufferMutex.lock();
+    if (rect.intersects(fBackScrollRect)) {
+        fBackScrollDebt = fPublishedScroll = 0;
+        fScrollReset = true;
+    }
+    fBufferMutex.unlock();
 
-    // If this was a fullscreen clear, then also clear the margin color.
-    if (rect == fPixmap.rect()) {
+    // If this was a fullscreen clear, then also clear the margin color. When
+    // called from the engine thread, this happens when the frame is presented.
+    if (rect == fBackBuffer.rect() and QThread::currentThread() == this->thread()) {
         hApp->updateMargins(fBgColor);
     }
 }
@@ -613,19 +1240,86 @@ void
 HFrame::setFontType( int hugoFont )
 {
     this->flushText();
-    this->fUseFixedFont = not (hugoFont & PROP_FONT);
-    this->fUseUnderlineFont = hugoFont & UNDERLINE_FONT;
-    this->fUseItalicFont = hugoFont & ITALIC_FONT;
-    this->fUseBoldFont = hugoFont & BOLD_FONT;
+    this->fHugoFont = hugoFont;
+
+    QFont f(fontForHugoFont(hugoFont, fPropFont, fFixedFont));
+    fBufferMutex.lock();
+    this->fFontMetrics = QFontMetrics(f, &fBackBuffer);
+    fBufferMutex.unlock();
+}
+
 
-    QFont f(this->fUseFixedFont ? hApp->settings()->fixedFont : hApp->settings()->propFont);
-    f.setUnderline(this->fUseUnderlineFont);
-    f.setItalic(this->fUseItalicFont);
-    f.setBold(this->fUseBoldFont);
-    this->fFontMetrics = QFontMetrics(f, &fPixmap);
+void
+HFrame::requestFontChange()
+{
+    fBufferMutex.lock();
+    fNewPropFont = hApp->settings()->propFont;
+    fNewFixedFont = hApp->settings()->fixedFont;
+    fBufferMutex.unlock();
+    fDisplayChanges.fetch_or(FontChange);
+    fInputQueue.notify();
+}
+
+
+bool
+HFrame::applyDisplayChanges()
+{
+    const int changes = fDisplayChanges.exchange(0);
+    if (changes == 0) {
+        return false;
+    }
+
+    HTraceScope trace("applyDisplayChanges", "render");
+    flushText();
+    QMutexLocker locker(&fBufferMutex);
+
+    // The fixed font might have changed, and with it the cell size.
+    fCommitCells();
+    fCellWindows.clear();
+    if (changes & FontChange) {
+        fPropFont = fNewPropFont;
+        fFixedFont = fNewFixedFont;
+        fGlyphCache.clear();
+    }
 
-    // Adjust text caret for new font.
-    this->setCursorHeight(this->fFontMetrics.height());
+    // Draw the current contents into a new buffer of the widget's size. If
+    // we have a usable display list, we draw from that; the game then
+    // doesn't need to repaint anything. Otherwise, we keep the old pixels and
+    // let the game know.
+    QImage newBuffer(fWidgetSize, QImage::Format_ARGB32_Premultiplied);
+    newBuffer.fill(hugoColorToQt(fBgColor));
+    const bool needRepaint = not fDisplayListValid;
+    if (fDisplayListValid) {
+        fRenderDisplayList(newBuffer);
+    } else {
+        QPainter p(&newBuffer);
+        p.drawImage(0, 0, fBackBuffer);
+    }
+    fBackBuffer = newBuffer;
+    fNeedScreenUpdate = true;
+
+    // Scrolled out rows no longer line up with anything, or were drawn with
+    // the old font.
+    fBackScrollRect = QRect();
+    fBackScrollStrip = QImage();
+    fBackScrollDebt = fPublishedScroll = 0;
+    fScrollReset = true;
+    locker.unlock();
+
+    // The text mode depends on both the size of the screen and the fonts.
+    if (changes & FontChange) {
+        setFontType(this->fHugoFont);
+    }
+    if (changes & ResizeChange) {
+        hHandlers->settextmode();
+    } else {
+        hHandlers->calcFontDimensions();
+    }
+    if (needRepaint) {
+        display_needs_repaint = true;
+    }
+    updateGameScreen(false);
+    return true;
 }
 
 
@@ -644,9 +1338,17 @@ void
 HFrame::printImage( const QImage& img, int x, int y )
 {
     this->flushText();
-    QPainter p(&fPixmap);
+    QMutexLocker locker(&fBufferMutex);
+    fDropCells(QRect(QPoint(x, y), img.size()));
+    QPainter p(&fBackBuffer);
     p.drawImage(x, y, img);
     fNeedScreenUpdate = true;
+
+    DisplayItem item;
+    item.type = DisplayItem::Image;
+    item.rect = QRect(QPoint(x, y), img.size());
+    item.image = img;
+    fRecord(item);
 }
 
 
@@ -657,27 +1359,59 @@ HFrame::scrollUp( int left, int top, int right, int bottom, int h )
         return;
     }
 
+    HTraceScope trace("scrollUp", "render");
     flushText();
-    QRegion exposed;
-    ++right;
-    ++bottom;
-    fPixmap.scroll(0, -h, left, top, right - left, bottom - top, &exposed);
-    fNeedScreenUpdate = true;
+    QMutexLocker locker(&fBufferMutex);
+    const QRect rect = QRect(left, top, right - left + 1, bottom - top + 1) & fBackBuffer.rect();
+    if (rect.isEmpty()) {
+        return;
+    }
+    if (h > rect.height()) {
+        h = rect.height();
+    }
+    fDropCells(rect);
+
+    // QImage has no scroll(), but the format is fixed at 32 bits per pixel,
+    // so we can simply move the scanlines ourselves. bits() detaches the
+    // buffer from the published frame.
+    const int bpl = fBackBuffer.bytesPerLine();
+    uchar* bits = fBackBuffer.bits() + rect.left() * 4;
+
+    if (hApp->settings()->softTextScrolling and not fFastForward) {
+        // Remember the rows we're about to scroll out, so that the
+        // presentation side can draw them while animating.
+        if (rect != fBackScrollRect) {
+            fBackScrollRect = rect;
+            fBackScrollStrip = QImage(rect.size(), QImage::Format_ARGB32_Premultiplied);
+            fBackScrollStrip.fill(hugoColorToQt(this->fBgColor));
+            fBackScrollDebt = fPublishedScroll = 0;
+            fScrollReset = true;
+        }
+        const int sbpl = fBackScrollStrip.bytesPerLine();
+        uchar* sbits = fBackScrollStrip.bits();
+        const int keep = rect.height() - h;
+        std::memmove(sbits, sbits + h * sbpl, keep * sbpl);
+        for (int i = 0; i < h; ++i) {
+            std::memcpy(sbits + (keep + i) * sbpl, bits + (rect.top() + i) * bpl, rect.width() * 4);
+        }
+        fBackScrollDebt += h;
+    }
+
+    for (int y = rect.top(); y + h <= rect.bottom(); ++y) {
+        std::memmove(bits + y * bpl, bits + (y + h) * bpl, rect.width() * 4);
+    }
+    fScrollDisplayList(rect, h);
+    const bool publish = fPublishClock.hasExpired(fFrameInterval);
+    locker.unlock();
 
     // Fill exposed region.
-    const QRect& r = exposed.boundingRect();
-    this->clearRegion(r.left(), r.top(), r.left() + r.width(), r.top() + r.bottom());
-
-    if (hApp->settings()->softTextScrolling) {
-        QEventLoop idleLoop;
-        QTimer timer;
-        timer.setSingleShot(true);
-        QObject::connect(&timer, SIGNAL(timeout()), &idleLoop, SLOT(quit()));
-        QObject::connect(hApp, SIGNAL(gameQuitting()), &idleLoop, SLOT(quit()));
-        timer.start(12);
-        idleLoop.exec();
+    fFillRect(QRect(rect.left(), rect.bottom() - h + 1, rect.width(), h));
+
+    // Don't publish a frame for every scrolled line. The GUI can't present
+    // them any faster than the display refreshes anyway.
+    if (publish) {
+        updateGameScreen(false);
     }
-    updateGameScreen(false);
 }
 
 
@@ -687,32 +1421,107 @@ HFrame::flushText()
     if (this->fPrintBuffer.isEmpty())
         return;
 
-    QFont f(this->fUseFixedFont ? hApp->settings()->fixedFont : hApp->settings()->propFont);
-    f.setUnderline(this->fUseUnderlineFont);
-    f.setItalic(this->fUseItalicFont);
-    f.setBold(this->fUseBoldFont);
-    QPainter p(&fPixmap);
-    p.setFont(f);
-    p.setPen(hugoColorToQt(this->fFgColor));
-    p.setBackgroundMode(Qt::OpaqueMode);
-    p.setBackground(QBrush(hugoColorToQt(this->fBgColor)));
-    p.drawText(this->fFlushXPos, this->fFlushYPos + currentFontMetrics().ascent() + 1,
-               this->fPrintBuffer);
+    HTraceScope trace("flushText", "render");
+    DisplayItem item;
+    item.type = DisplayItem::Text;
+    item.rect = QRect(this->fFlushXPos, this->fFlushYPos + 1,
+                      currentFontMetrics().width(this->fPrintBuffer),
+                      currentFontMetrics().height());
+
+    QMutexLocker locker(&fBufferMutex);
+    if (not fPrintCells()) {
+        fDropCells(item.rect);
+        QFont f(fontForHugoFont(this->fHugoFont, fPropFont, fFixedFont));
+        QPainter p(&fBackBuffer);
+        p.setFont(f);
+        p.setPen(hugoColorToQt(this->fFgColor));
+        // Same as in paintEvent(), the background needs to be filled first.
+        p.fillRect(item.rect, hugoColorToQt(this->fBgColor));
+        p.drawStaticText(item.rect.topLeft(), fTextCache().get(this->fPrintBuffer, f));
+        fNeedScreenUpdate = true;
+    }
+
+    item.bgColor = this->fBgColor;
+    item.fgColor = this->fFgColor;
+    item.hugoFont = this->fHugoFont;
+    item.text = this->fPrintBuffer;
+    item.continues = false;
+    fRecord(item);
     this->fPrintBuffer.clear();
-    fNeedScreenUpdate = true;
 }
 
 
 void
 HFrame::updateGameScreen(bool force)
 {
-    flushText();
-    if (fNeedScreenUpdate or force) {
-        //qDebug(Q_FUNC_INFO);
-        hApp->updateMargins(this->fBgColor);
-        fNeedScreenUpdate = false;
-        hApp->marginWidget()->update();
-        update();
+    if (fFastForward and not force) {
+        return;
+    }
+    fFinishFrame();
+    publishFrame(force);
+}
+
+
+void
+HFrame::publishFrame( bool force )
+{
+    QMutexLocker locker(&fBufferMutex);
+    if (not fNeedScreenUpdate and not force) {
+        return;
+    }
+    //qDebug(Q_FUNC_INFO);
+    fNeedScreenUpdate = false;
+    fFrontBuffer = fBackBuffer;
+    fFrontScrollRect = fBackScrollRect;
+    fFrontScrollStrip = fBackScrollStrip;
+    fPublishedScroll += fBackScrollDebt;
+    fBackScrollDebt = 0;
+    fPublishClock.restart();
+    locker.unlock();
+
+    if (QThread::currentThread() == this->thread()) {
+        fPresentFrame();
+    } else {
+        QMetaObject::invokeMethod(this, "fPresentFrame", Qt::QueuedConnection);
+    }
+}
+
+
+void
+HFrame::setFastForward( bool enable )
+{
+    if (enable == fFastForward) {
+        return;
+    }
+    fFastForward = enable;
+    if (enable) {
+        return;
+    }
+
+    // Whatever scrolled while fast-forwarding wasn't kept, so don't animate.
+    fBufferMutex.lock();
+    fBackScrollRect = QRect();
+    fBackScrollStrip = QImage();
+    fBackScrollDebt = 0;
+    fScrollReset = true;
+    fBufferMutex.unlock();
+    updateGameScreen(true);
+}
+
+
+void
+HFrame::schedulePresent()
+{
+    if (fFastForward) {
+        return;
+    }
+    // The GUI thread only publishes what's already in the back buffer, so
+    // everything pending has to be drawn into it here.
+    fFinishFrame();
+    if (not fPresentScheduled.load(std::memory_order_relaxed)
+        and not fPresentScheduled.exchange(true))
+    {
+        QMetaObject::invokeMethod(this, "fHandlePresentRequest", Qt::QueuedConnection);
     }
 }
 
@@ -736,7 +1545,13 @@ HFrame::updateCursorPos()
         this->fBlinkCursor();
     }
 
-    int xOffs = this->currentFontMetrics().width(this->fInputBuf.left(this->fInputCurrentChar));
+    // The engine thread's font metrics aren't ours to read.
+    fBufferMutex.lock();
+    const int hugoFont = fFrameHugoFont;
+    fBufferMutex.unlock();
+    const QFontMetrics m(fontForHugoFont(hugoFont, hApp->settings()->propFont,
+                                         hApp->settings()->fixedFont));
+    int xOffs = m.width(this->fInputBuf.left(this->fInputCurrentChar));
     this->moveCursorPos(QPoint(this->fInputStartX + xOffs, this->fInputStartY));
 
     // Blink-in.
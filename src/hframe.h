@@ -29,13 +29,18 @@
 #define HFRAME_H
 
 #include <QWidget>
-#include <QQueue>
 #include <QList>
+#include <QVector>
+#include <QHash>
 #include <QFontMetrics>
+#include <QImage>
 #include <QMutex>
-#include <QWaitCondition>
+#include <QElapsedTimer>
+#include <atomic>
 
 #include "happlication.h"
+#include "hstatictextcache.h"
+#include "hinputqueue.h"
 
 
 extern class HFrame* hFrame;
@@ -58,19 +63,35 @@ class HFrame: public QWidget {
     // The input-mode we are currently in.
     InputMode fInputMode;
 
-    // We have a finished user input.
-    bool fInputReady;
+    // We have a finished user input. The engine thread waits for this.
+    std::atomic<bool> fInputReady;
 
-    // Keypress input queue. If an element is 0, it means the input was
-    // a mouse click.
-    QQueue<char> fKeyQueue;
+    // Pending CheckpointRequest. The engine thread waits for this too.
+    std::atomic<int> fCheckpointRequest;
 
-    // Mouse click input queue.
-    QQueue<QPoint> fClickQueue;
+    // Keypresses, clicks and resizes, in the order they happened. Everything
+    // the user types while the game isn't reading a line is kept here, so
+    // that it's not lost when the game does start reading one. The engine
+    // thread is the consumer.
+    HInputQueue fInputQueue;
 
-    // The keypress and click queues are also accessed from the engine thread.
-    QMutex fKeyQueueMutex;
-    QMutex fClickQueueMutex;
+    // Position of the click most recently returned by getNextKey().
+    QPoint fLastClick;
+
+    // We only keep one resize event in the queue at a time.
+    std::atomic<bool> fResizePending;
+
+    // Changes to the screen that the GUI thread leaves to the engine thread,
+    // since only the engine thread draws into the back buffer and sets up the
+    // text mode. See applyDisplayChanges().
+    enum DisplayChange {
+        // The widget was resized.
+        ResizeChange = 1,
+
+        // The fonts were changed in the preferences.
+        FontChange = 2
+    };
+    std::atomic<int> fDisplayChanges;
 
     // Input buffer.
     QString fInputBuf;
@@ -101,18 +122,178 @@ class HFrame: public QWidget {
     int fFgColor;
     int fBgColor;
 
-    // Current font attributes.
-    bool fUseFixedFont;
-    bool fUseUnderlineFont;
-    bool fUseItalicFont;
-    bool fUseBoldFont;
+    // Current font attributes, as Hugo font flags.
+    int fHugoFont;
 
     // Current font metrics.
     QFontMetrics fFontMetrics;
 
-    // We render game output into a pixmap first instead or painting directly
-    // on the widget. We then draw the pixmap in our paintEvent().
-    QPixmap fPixmap;
+    // The proportional and fixed fonts from the preferences. The engine
+    // thread draws with these copies, since the GUI thread changes the
+    // settings while the preferences dialog is open. Engine thread only.
+    QFont fPropFont;
+    QFont fFixedFont;
+
+    // The colors, font and line height that were current when the engine
+    // thread last finished a frame. The GUI thread draws the input line, the
+    // caret and the margins with these, since the current ones above belong
+    // to the engine thread. Protected by fBufferMutex.
+    int fFrameFgColor;
+    int fFrameBgColor;
+    int fFrameHugoFont;
+    int fFrameLineHeight;
+
+    // We render game output into an image first instead of painting directly
+    // on the widget. Unlike a QPixmap, a QImage can be painted on from the
+    // engine thread, so printing doesn't need to block on the GUI thread.
+    //
+    // fBackBuffer is the image we render into. fFrontBuffer is the most
+    // recently published frame, which is what paintEvent() presents.
+    // Publishing is a shallow copy of the implicitly shared image data; the
+    // next paint operation on the back buffer detaches it.
+    QImage fBackBuffer;
+    QImage fFrontBuffer;
+
+    // Protects both buffers as well as fNeedScreenUpdate and the scroll
+    // bookkeeping below. Only the engine thread writes to the back buffer; the
+    // GUI thread publishes and presents it.
+    QMutex fBufferMutex;
+
+    // The size of the widget as of the last resizeEvent(). The back buffer
+    // is resized to it once the engine thread gets to it. Protected by
+    // fBufferMutex.
+    QSize fWidgetSize;
+
+    // The fonts as of the last requestFontChange(). They replace fPropFont
+    // and fFixedFont once the engine thread gets to it. Protected by
+    // fBufferMutex.
+    QFont fNewPropFont;
+    QFont fNewFixedFont;
+
+    // Smooth scrolling is done on the presentation side. The engine scrolls
+    // the back buffer at full speed and only records how far it scrolled.
+    // The GUI thread then draws the scrolled region with a vertical offset
+    // that it animates towards zero.
+    //
+    // The region of the most recent scroll, and the rows that were scrolled
+    // out of its top (most recent ones at the bottom.) We need those to fill
+    // the gap above the region while it's still being drawn with an offset.
+    QRect fBackScrollRect;
+    QImage fBackScrollStrip;
+    QRect fFrontScrollRect;
+    QImage fFrontScrollStrip;
+
+    // Pixels scrolled since the last published frame.
+    int fBackScrollDebt;
+
+    // Pixels scrolled in published frames that the animation hasn't picked up
+    // yet.
+    int fPublishedScroll;
+
+    // Set when the scrolled region was cleared. Any running animation is
+    // stopped, since the rows above the region are no longer meaningful.
+    bool fScrollReset;
+
+    // Measures the time since the last published frame. Frames published by
+    // scrolling are throttled to the display refresh rate.
+    QElapsedTimer fPublishClock;
+
+    // Display refresh interval in milliseconds.
+    int fFrameInterval;
+
+    // Set while a presentation requested with schedulePresent() is pending,
+    // so that we only ever have one of them queued.
+    std::atomic<bool> fPresentScheduled;
+
+    // Delays scheduled presentations to the display refresh rate.
+    class QTimer* fPresentTimer;
+
+    // While fast-forwarding, frames are neither published nor animated.
+    std::atomic<bool> fFastForward;
+
+    // GUI thread only. The current offset of the scrolled region, and the
+    // timer that animates it.
+    qreal fScrollOffset;
+    class QTimer* fScrollTimer;
+    QElapsedTimer fScrollClock;
+
+    // Retained display list. Everything we draw into the back buffer is also
+    // recorded here, so that we can draw the screen again ourselves after a
+    // resize or a font change instead of asking the game to repaint it.
+    //
+    // Items that are completely covered by a later item are dropped, so the
+    // list only holds what is actually visible. Scrolling moves the items
+    // along with the pixels.
+    struct DisplayItem {
+        enum Type { Fill, Text, Image };
+
+        DisplayItem()
+            : bgColor(0), fgColor(0), hugoFont(0), continues(false)
+        { }
+
+        Type type;
+
+        // The area the item covers, and the part of it that is still visible
+        // after scrolling. A null clip means the item is fully visible.
+        QRect rect;
+        QRect clip;
+
+        // Fill color, or text background color.
+        int bgColor;
+
+        // Text only.
+        int fgColor;
+        int hugoFont;
+        QString text;
+        // The text was printed right where the previous text item ended.
+        // When the font changes, it's kept that way.
+        bool continues;
+
+        // Image only.
+        QImage image;
+    };
+    QVector<DisplayItem> fDisplayList;
+
+    // Cleared when something happened that the display list can't represent
+    // (like scrolling a region that only partially contains an item.) We then
+    // fall back to keeping pixels until the next full clear.
+    bool fDisplayListValid;
+
+    // Windows that are printed to in the fixed font only (typically the
+    // status line) are tracked as a grid of character cells. Clearing such a
+    // window doesn't touch the back buffer right away; the text printed into
+    // it afterwards goes into the grid, and once the window is done, only the
+    // cells that differ from what's already on screen are drawn.
+    //
+    // A cell holds the character, colors and font flags, packed by
+    // fCellKey(). The same value is used as the key of the glyph cache.
+    struct CellWindow {
+        QRect rect;
+        int cols;
+        int rows;
+        // The background color the window was cleared with.
+        int clearColor;
+        // What we last drew into the back buffer. Not valid until the window
+        // has been drawn once.
+        QVector<quint64> shown;
+        bool shownValid;
+        int shownClearColor;
+        // What the game has printed since it last cleared the window.
+        QVector<quint64> pending;
+    };
+    QList<CellWindow> fCellWindows;
+
+    // Index of the window in fCellWindows that was cleared last and is
+    // still being printed to. -1 if there is none.
+    int fOpenCellWindow;
+
+    // Pre-rendered fixed font glyphs, one cell in size each.
+    QHash<quint64, QImage> fGlyphCache;
+
+    // Pre-shaped text for flushText() and for drawing the input line. One
+    // cache per thread; see textCache().
+    HStaticTextCache fEngineTextCache;
+    HStaticTextCache fGuiTextCache;
 
     // We buffer text printed with printText() so that we can draw
     // whole strings rather than single characters at a time.
@@ -125,7 +306,8 @@ class HFrame: public QWidget {
     // Position of the text cursor.
     QPoint fCursorPos;
 
-    // Height of the text cursor in pixels.
+    // Height of the text cursor in pixels. GUI thread only; it's taken from
+    // fFrameLineHeight when a frame is presented.
     unsigned fHeight;
 
     // Last position of the text cursor.
@@ -152,6 +334,66 @@ class HFrame: public QWidget {
     void
     fEnqueueKey(char key, QMouseEvent* e);
 
+    // Remove resize events from the front of the input queue. Engine thread
+    // only.
+    void
+    fSkipResizeEvents();
+
+    // Draw everything that's still pending into the back buffer and take
+    // note of the attributes the GUI thread needs for presenting it. Engine
+    // thread only.
+    void
+    fFinishFrame();
+
+    // Fill a rectangle of the back buffer with the current background color.
+    void
+    fFillRect( const QRect& rect );
+
+    // Add an item to the display list. fBufferMutex must be locked.
+    void
+    fRecord( const DisplayItem& item );
+
+    // Move the display list items in 'rect' up by 'h' pixels. fBufferMutex
+    // must be locked.
+    void
+    fScrollDisplayList( const QRect& rect, int h );
+
+    // Draw the display list into 'img' using the current font settings.
+    // fBufferMutex must be locked.
+    void
+    fRenderDisplayList( QImage& img );
+
+    // The cell window functions below all require fBufferMutex to be locked.
+
+    // Start tracking 'rect' as a cell window that was just cleared. Returns
+    // false if it isn't aligned to the fixed font's cells.
+    bool
+    fOpenCells( const QRect& rect );
+
+    // Put the text in the print buffer into the open cell window. Returns
+    // false if it doesn't fit the cells exactly.
+    bool
+    fPrintCells();
+
+    // Draw the cells of the open cell window that have changed.
+    void
+    fCommitCells();
+
+    // Commit the open cell window, then forget about any cell windows that
+    // intersect 'rect', since their contents are about to be painted over.
+    void
+    fDropCells( const QRect& rect );
+
+    quint64
+    fCellKey( ushort ch, int fgColor, int bgColor, int hugoFont ) const;
+
+    const QImage&
+    fGlyph( quint64 key );
+
+    // Returns the text cache for the calling thread.
+    HStaticTextCache&
+    fTextCache();
+
   private slots:
     // Called by the timer to blink the text cursor.
     void
@@ -169,6 +411,20 @@ class HFrame: public QWidget {
     void
     fEndInputMode( bool addToHistory );
 
+    // Present the most recently published frame. Must run on the GUI thread.
+    void
+    fPresentFrame();
+
+    // Publish and present the back buffer in response to schedulePresent(),
+    // once a refresh interval has passed since the last published frame.
+    // Nothing is drawn here; schedulePresent() already did that.
+    void
+    fHandlePresentRequest();
+
+    // Called by the scroll timer to advance the smooth scrolling animation.
+    void
+    fAnimateScroll();
+
   protected:
     virtual void
     paintEvent(QPaintEvent* e);
@@ -204,22 +460,48 @@ class HFrame: public QWidget {
   public:
     HFrame( QWidget* parent );
 
-    // The engine thread waits on this until an input line has been entered.
-    QWaitCondition inputLineWaitCond;
+    // Start reading an input line. Keys typed ahead of time are inserted
+    // right away, and if one of them was Return, the line is entered.
+    void
+    startInput( int xPos, int yPos );
+
+    // Block the engine thread until an input line has been entered, or a
+    // checkpoint was requested. Resizes and font changes are applied while
+    // waiting.
+    void
+    waitForInputLine();
+
+    // Quick save and load. The GUI thread requests them while a line is being
+    // read, and the engine thread picks them up when waitForInputLine()
+    // returns without a line.
+    enum CheckpointRequest {
+        NoCheckpointRequest,
+        QuickSaveRequest,
+        QuickLoadRequest
+    };
+
+    void
+    requestCheckpoint( CheckpointRequest req );
 
-    // The engine thread waits on this until a keypress is available.
-    QWaitCondition keypressAvailableWaitCond;
+    CheckpointRequest
+    takeCheckpointRequest();
 
-    // Start reading an input line.
+    // Stop reading the current input line without entering it. What was
+    // typed so far is kept and shows up again at the next startInput().
     void
-    startInput( int xPos, int yPos );
+    interruptInput();
+
+    // Block the engine thread until a keypress or click is available.
+    void
+    waitForKey();
 
-    // Get the most recently entered input line and clear it.
+    // Get the most recently entered input line and clear it. The line is
+    // also printed, so that it becomes part of the screen.
     void
     getInput(char* buf, size_t buflen);
 
-    // Returns the next character waiting in the queue. If the queue is
-    // empty, it will wait for a character to become available.
+    // Returns the next character waiting in the queue. The queue must not be
+    // empty; use waitForKey() first.
     // Note: if this returns 0, it means the next "key" is a mouse click;
     // call getNextClick() to get the position of the mouse click.
     int
@@ -228,6 +510,7 @@ class HFrame: public QWidget {
     QPoint
     getNextClick();
 
+    // Engine thread only. Also applies any resizes and font changes.
     bool
     hasKeyInQueue();
 
@@ -246,10 +529,36 @@ class HFrame: public QWidget {
     void
     setFontType( int hugoFont );
 
+    // Hand the fonts from the preferences over to the engine thread and ask
+    // it to draw the screen again with them. Called by the GUI thread when
+    // the preferences have changed.
+    void
+    requestFontChange();
+
+    // Apply the resizes and font changes the GUI thread asked for: resize the
+    // back buffer, draw the screen again from the display list and set up the
+    // text mode for the new size and fonts. Returns false if there was
+    // nothing to do. Engine thread only; it calls this whenever it waits for
+    // input.
+    bool
+    applyDisplayChanges();
+
+    // Size of the screen the engine thread draws to. It only changes when
+    // applyDisplayChanges() picks up a resize. Engine thread only.
+    QSize
+    screenSize() const
+    { return this->fBackBuffer.size(); }
+
+    // Engine thread only.
     const QFontMetrics&
     currentFontMetrics() const
     { return this->fFontMetrics; }
 
+    // The fixed font the engine thread draws with. Engine thread only.
+    const QFont&
+    fixedFont() const
+    { return this->fFixedFont; }
+
     // Print text using the current foreground and background colors.
     // The Text is might not be printed immediately; call flushText()
     // to flush the accumulated text to the screen.
@@ -266,11 +575,6 @@ class HFrame: public QWidget {
     moveCursorPos( const QPoint& pos )
     { this->fCursorPos = pos; }
 
-    // Set the height of the text cursor in pixels.
-    void
-    setCursorHeight( unsigned height )
-    { this->fHeight = height; }
-
     // Show/hide the text cursor.
     void
     setCursorVisible( bool visible )
@@ -299,6 +603,31 @@ class HFrame: public QWidget {
     QList<const QAction*>
     getGameContextMenuEntries( class QMenu& dst );
 
+    // Fast-forward mode, used when playing back recorded commands. The back
+    // buffer is still drawn into, but nothing is shown until fast-forwarding
+    // is turned off again, at which point the screen is updated once.
+    void
+    setFastForward( bool enable );
+
+    bool
+    isFastForwarding() const
+    { return this->fFastForward; }
+
+    // Like updateGameScreen(false), but leaves the publishing to the GUI
+    // thread, which does it at most once per display refresh. Meant for the
+    // engine thread when it polls for input in a loop; pending text is still
+    // drawn right away, but unless a request is already pending, scheduling
+    // is only an atomic load.
+    void
+    schedulePresent();
+
+    // Publish what has already been drawn into the back buffer as the new
+    // frame and schedule it to be presented, if needed. Unlike
+    // updateGameScreen(), this doesn't draw pending text, so the GUI thread
+    // can call it while the engine thread is running.
+    void
+    publishFrame( bool force );
+
   public slots:
     // Flush any pending text drawing.
     void
@@ -308,7 +637,10 @@ class HFrame: public QWidget {
     void
     scrollUp( int left, int top, int right, int bottom, int h );
 
-    // Update the game screen, if needed.
+    // Draw any pending text into the back buffer, then publish it as the new
+    // frame and schedule it to be presented, if needed. Only the engine thread
+    // draws, so this must be called from it, or from the GUI thread while the
+    // engine thread is blocked on it.
     void
     updateGameScreen(bool force);
 };
@@ -0,0 +1,81 @@
+/* Copyright 2015 Nikos Chantziaras
+ *
+ * This file is part of Hugor.
+ *
+ * Hugor is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Hugor is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Hugor.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Additional permission under GNU GPL version 3 section 7
+ *
+ * If you modify this Program, or any covered work, by linking or combining it
+ * with the Hugo Engine (or a modified version of the Hugo Engine), containing
+ * parts covered by the terms of the Hugo License, the licensors of this
+ * Program grant you additional permission to convey the resulting work.
+ * Corresponding Source for a non-source form of such a combination shall
+ * include the source code for the parts of the Hugo Engine used as well as
+ * that of the covered work.
+ */
+#include <thread>
+
+#include "hframepacer.h"
+#include "hmetrics.h"
+
+
+HFramePacer* hFramePacer = 0;
+
+
+HFramePacer::HFramePacer()
+    : fRate(0)
+{ }
+
+
+void
+HFramePacer::wait( int rate )
+{
+    using std::chrono::nanoseconds;
+    static HCounter& frames = HMetrics::counter("pacer.frames");
+    static HCounter& missedDeadlines = HMetrics::counter("pacer.missed_deadlines");
+    static HHistogram& work = HMetrics::histogram("pacer.work_us");
+    static HHistogram& lateness = HMetrics::histogram("pacer.lateness_us");
+
+    if (rate <= 0) {
+        return;
+    }
+    const Clock::time_point now = Clock::now();
+    const nanoseconds period(1000000000LL / rate);
+
+    // Start over if the rate changed or the game hasn't been waiting for a
+    // while; there's no point in trying to catch up with frames from a
+    // previous animation.
+    if (rate != fRate or fDeadline == Clock::time_point() or now - fDeadline > 4 * period) {
+        fRate = rate;
+        fDeadline = now;
+    } else {
+        frames.add();
+        work.record(now - fLastWake);
+    }
+
+    fDeadline += period;
+    if (fDeadline <= now) {
+        // The frame took longer than a whole period. Don't sleep, and don't
+        // try to make up for it by rushing the next frame either.
+        missedDeadlines.add();
+        fDeadline = now;
+        fLastWake = now;
+        return;
+    }
+
+    std::this_thread::sleep_until(fDeadline);
+    fLastWake = Clock::now();
+    lateness.record(fLastWake - fDeadline);
+}
@@ -0,0 +1,68 @@
+/* Copyright 2015 Nikos Chantziaras
+ *
+ * This file is part of Hugor.
+ *
+ * Hugor is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Hugor is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Hugor.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Additional permission under GNU GPL version 3 section 7
+ *
+ * If you modify this Program, or any covered work, by linking or combining it
+ * with the Hugo Engine (or a modified version of the Hugo Engine), containing
+ * parts covered by the terms of the Hugo License, the licensors of this
+ * Program grant you additional permission to convey the resulting work.
+ * Corresponding Source for a non-source form of such a combination shall
+ * include the source code for the parts of the Hugo Engine used as well as
+ * that of the covered work.
+ */
+#ifndef HFRAMEPACER_H
+#define HFRAMEPACER_H
+
+#include <chrono>
+
+
+extern class HFramePacer* hFramePacer;
+
+
+// Paces the frames of games that animate by calling hugo_timewait() in a
+// loop.
+//
+// Rather than sleeping for a whole frame period after each frame, we keep an
+// absolute deadline for the end of the current frame and sleep until then.
+// The time the game spent drawing the frame is thus not added on top of the
+// frame period, and rounding errors don't accumulate over time.
+//
+// For tuning, frames are counted in the "pacer.frames" and
+// "pacer.missed_deadlines" metrics. "pacer.work_us" is the time the game spent
+// between two waits and "pacer.lateness_us" how much later than the deadline
+// we woke up.
+class HFramePacer {
+  public:
+    typedef std::chrono::steady_clock Clock;
+
+  private:
+    Clock::time_point fDeadline;
+    Clock::time_point fLastWake;
+    int fRate;
+
+  public:
+    HFramePacer();
+
+    // Sleep until the end of the current frame, for a game that runs at
+    // 'rate' frames per second.
+    void
+    wait( int rate );
+};
+
+
+#endif
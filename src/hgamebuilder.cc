@@ -0,0 +1,601 @@
+/* Copyright 2015 Nikos Chantziaras
+ *
+ * This file is part of Hugor.
+ *
+ * Hugor is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Hugor is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Hugor.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Additional permission under GNU GPL version 3 section 7
+ *
+ * If you modify this Program, or any covered work, by linking or combining it
+ * with the Hugo Engine (or a modified version of the Hugo Engine), containing
+ * parts covered by the terms of the Hugo License, the licensors of this
+ * Program grant you additional permission to convey the resulting work.
+ * Corresponding Source for a non-source form of such a combination shall
+ * include the source code for the parts of the Hugo Engine used as well as
+ * that of the covered work.
+ */
+#include <algorithm>
+#include <cstring>
+#include <map>
+
+#include "hgamebuilder.h"
+
+extern "C" {
+#include "heheader.h"
+}
+
+// Routine addresses are multiples of this in game version 3.1, and the data
+// tables start at multiples of 16.
+static const int ADDRESS_SCALE = 16;
+
+// Size of an object in the object table, in game version 2.1 and later: four
+// sets of 32 attributes, the parent, sibling and child, and the offset of the
+// object's properties.
+static const int OBJECT_SIZE = 24;
+
+// The engine's "noun" property (see he.c.)
+static const int NOUN_PROPERTY = 3;
+
+// The engine's "prompt" global.
+static const int PROMPT_GLOBAL = 9;
+
+// Where the compiler puts the grammar table.
+static const int GRAMMAR_START = 64;
+
+
+static void
+putWord( std::vector<unsigned char>& img, size_t pos, unsigned value )
+{
+    img[pos] = value & 0xFF;
+    img[pos + 1] = (value >> 8) & 0xFF;
+}
+
+
+static void
+appendWord( std::vector<unsigned char>& img, unsigned value )
+{
+    img.push_back(value & 0xFF);
+    img.push_back((value >> 8) & 0xFF);
+}
+
+
+// Pads the image to the next 16 byte boundary and returns that boundary as
+// a segment.
+static unsigned
+alignSegment( std::vector<unsigned char>& img )
+{
+    while (img.size() % 16) {
+        img.push_back(0);
+    }
+    return img.size() / 16;
+}
+
+
+HGameExpr&
+HGameExpr::value( int v )
+{
+    fCode.push_back(VALUE_T);
+    fCode.push_back(v & 0xFF);
+    fCode.push_back((v >> 8) & 0xFF);
+    ++fTerms;
+    return *this;
+}
+
+
+HGameExpr&
+HGameExpr::global( int g )
+{
+    fCode.push_back(VAR_T);
+    fCode.push_back(g);
+    ++fTerms;
+    return *this;
+}
+
+
+HGameExpr&
+HGameExpr::op( Op o )
+{
+    static const unsigned char tokens[] = { PLUS_T, MINUS_T, ASTERISK_T, FORWARD_SLASH_T };
+    fCode.push_back(tokens[o]);
+    return *this;
+}
+
+
+HGameBuilder::HGameBuilder()
+    : fGlobals(MAXGLOBALS, 0),
+      fJunctions(PERFORM + 1, -1),
+      fTextBankSize(0)
+{ }
+
+
+void
+HGameBuilder::addWord( const std::string& word )
+{
+    if (word.empty()) {
+        return;
+    }
+    for (const auto& w : fWords) {
+        if (w == word) {
+            return;
+        }
+    }
+    fWords.push_back(word);
+}
+
+
+int
+HGameBuilder::addObject( const std::string& noun, int parent )
+{
+    addWord(noun);
+    Object obj;
+    obj.parent = fObjects.empty() ? -1 : parent;
+    obj.noun = noun;
+    fObjects.push_back(obj);
+    return fObjects.size() - 1;
+}
+
+
+void
+HGameBuilder::setProperty( int obj, int prop, const std::vector<unsigned>& values )
+{
+    auto& props = fObjects[obj].props;
+    for (auto& p : props) {
+        if (p.first == prop) {
+            p.second = values;
+            return;
+        }
+    }
+    props.emplace_back(prop, values);
+}
+
+
+void
+HGameBuilder::setGlobal( int global, int value )
+{
+    fGlobals[global] = value;
+}
+
+
+void
+HGameBuilder::setPrompt( const std::string& prompt )
+{
+    addWord(prompt);
+    fPrompt = prompt;
+}
+
+
+int
+HGameBuilder::addRoutine()
+{
+    fRoutines.push_back(Routine());
+    fRoutines.back().addr = 0;
+    return fRoutines.size() - 1;
+}
+
+
+void
+HGameBuilder::setJunction( Junction junction, int routine )
+{
+    fJunctions[junction] = routine;
+}
+
+
+void
+HGameBuilder::addVerb( const std::vector<std::string>& words, int routine,
+                       const std::vector<std::string>& syntax, bool xverb )
+{
+    for (const auto& w : words) {
+        addWord(w);
+    }
+    for (const auto& w : syntax) {
+        addWord(w);
+    }
+    fVerbs.push_back({ words, syntax, routine, xverb });
+}
+
+
+void
+HGameBuilder::addEvent( int routine, int object )
+{
+    fEvents.emplace_back(object, routine);
+}
+
+
+void
+HGameBuilder::print( int routine, const std::string& text )
+{
+    // Text lives in the text bank. The statement has its 24 bit address.
+    auto& code = fRoutines[routine].code;
+    code.push_back(TEXTDATA_T);
+    code.push_back((fTextBankSize >> 16) & 0xFF);
+    code.push_back(fTextBankSize & 0xFF);
+    code.push_back((fTextBankSize >> 8) & 0xFF);
+    fTexts.push_back(text);
+    fTextBankSize += 2 + text.size();
+}
+
+
+void
+HGameBuilder::call( int routine, int callee )
+{
+    auto& r = fRoutines[routine];
+    r.code.push_back(ROUTINE_T);
+    r.calls.emplace_back(r.code.size(), callee);
+    appendWord(r.code, 0);
+}
+
+
+void
+HGameBuilder::assign( int routine, int global, const HGameExpr& expr )
+{
+    auto& code = fRoutines[routine].code;
+    code.push_back(VAR_T);
+    code.push_back(global);
+    code.push_back(EQUALS_T);
+    fAppendExpr(routine, expr);
+}
+
+
+void
+HGameBuilder::runEvents( int routine )
+{
+    fRoutines[routine].code.push_back(RUNEVENTS_T);
+}
+
+
+void
+HGameBuilder::returnValue( int routine, const HGameExpr& expr )
+{
+    fRoutines[routine].code.push_back(RETURN_T);
+    fAppendExpr(routine, expr);
+}
+
+
+void
+HGameBuilder::quit( int routine )
+{
+    fRoutines[routine].code.push_back(QUIT_T);
+}
+
+
+void
+HGameBuilder::fAppendExpr( int routine, const HGameExpr& expr )
+{
+    auto& code = fRoutines[routine].code;
+    code.insert(code.end(), expr.fCode.begin(), expr.fCode.end());
+    code.push_back(EOL_T);
+    if (expr.terms() > MAX_EXPRESSION_TERMS and fError.empty()) {
+        fError = "expression with more than " + std::to_string(MAX_EXPRESSION_TERMS) + " terms";
+    }
+}
+
+
+unsigned
+HGameBuilder::routineAddress( int routine ) const
+{
+    return fRoutines[routine].addr;
+}
+
+
+bool
+HGameBuilder::build( std::vector<unsigned char>& image )
+{
+    if (not fError.empty()) {
+        return false;
+    }
+
+    // Word 0 is the empty word at dictionary address 0. The others follow it
+    // as a length and the characters.
+    std::map<std::string, unsigned> wordAddrs;
+    unsigned dictPos = 1;
+    for (const auto& word : fWords) {
+        wordAddrs[word] = dictPos;
+        dictPos += word.size() + 1;
+    }
+    if (dictPos > 0xFFFF) {
+        fError = "the dictionary is larger than 64K";
+        return false;
+    }
+
+    std::vector<unsigned char>& img = image;
+    img.assign(GRAMMAR_START, 0);
+    img[H_GAMEVERSION] = HEVERSION * 10 + HEREVISION;
+    img[H_ID] = 'H';
+    img[H_ID + 1] = 'B';
+    std::memcpy(&img[H_SERIAL], "00-00-00", 8);
+
+    // Each verb has a single syntax line: the verb, the words of its syntax,
+    // and the routine. The routine addresses are filled in below.
+    std::vector<std::pair<size_t, int>> grammarCalls;
+    for (const auto& verb : fVerbs) {
+        img.push_back(verb.xverb ? XVERB_T : VERB_T);
+        img.push_back(verb.words.size());
+        for (const auto& w : verb.words) {
+            appendWord(img, wordAddrs[w]);
+        }
+        img.push_back(ASTERISK_T);
+        img.push_back(4 + 3 * verb.syntax.size());
+        for (const auto& w : verb.syntax) {
+            img.push_back(DICTENTRY_T);
+            appendWord(img, wordAddrs[w]);
+        }
+        img.push_back(ROUTINE_T);
+        grammarCalls.emplace_back(img.size(), verb.routine);
+        appendWord(img, 0);
+    }
+    img.push_back(0xFF);
+
+    // An empty routine for Init and Main if the game doesn't have them, then
+    // the game's routines.
+    alignSegment(img);
+    putWord(img, H_CODESTART, img.size());
+    const unsigned emptyRoutine = img.size() / ADDRESS_SCALE;
+    img.push_back(CLOSE_BRACE_T);
+    std::vector<size_t> routineStarts;
+    for (auto& r : fRoutines) {
+        alignSegment(img);
+        if (img.size() / ADDRESS_SCALE > 0xFFFF) {
+            fError = "the code is larger than 1M";
+            return false;
+        }
+        r.addr = img.size();
+        routineStarts.push_back(img.size());
+        img.insert(img.end(), r.code.begin(), r.code.end());
+        img.push_back(CLOSE_BRACE_T);
+    }
+    for (size_t i = 0; i < fRoutines.size(); ++i) {
+        for (const auto& c : fRoutines[i].calls) {
+            putWord(img, routineStarts[i] + c.first, fRoutines[c.second].addr / ADDRESS_SCALE);
+        }
+    }
+    for (const auto& c : grammarCalls) {
+        putWord(img, c.first, fRoutines[c.second].addr / ADDRESS_SCALE);
+    }
+    for (int j = INIT; j <= PERFORM; ++j) {
+        unsigned addr = 0;
+        if (fJunctions[j] >= 0) {
+            addr = fRoutines[fJunctions[j]].addr / ADDRESS_SCALE;
+        } else if (j == INIT or j == MAIN) {
+            addr = emptyRoutine;
+        }
+        putWord(img, H_INIT + j * 2, addr);
+    }
+
+    // Objects. Every object is the youngest child of its parent.
+    const size_t objCount = fObjects.size();
+    putWord(img, H_OBJTABLE, alignSegment(img));
+    appendWord(img, objCount);
+    const size_t objects = img.size();
+    img.resize(objects + objCount * OBJECT_SIZE, 0);
+    std::vector<int> youngest(objCount, -1);
+    for (size_t obj = 1; obj < objCount; ++obj) {
+        const int parent = fObjects[obj].parent;
+        putWord(img, objects + obj * OBJECT_SIZE + 16, parent);
+        if (youngest[parent] < 0) {
+            putWord(img, objects + parent * OBJECT_SIZE + 20, obj);
+        } else {
+            putWord(img, objects + youngest[parent] * OBJECT_SIZE + 18, obj);
+        }
+        youngest[parent] = obj;
+    }
+
+    // Property defaults and flags, then each object's properties: the noun
+    // first, then the others in the order they were set.
+    int properties = FIRST_PROPERTY;
+    for (const auto& obj : fObjects) {
+        for (const auto& p : obj.props) {
+            properties = std::max(properties, p.first + 1);
+        }
+    }
+    putWord(img, H_PROPTABLE, alignSegment(img));
+    const size_t propStart = img.size();
+    appendWord(img, properties);
+    for (int p = 0; p < properties; ++p) {
+        appendWord(img, 0);
+    }
+    img.resize(img.size() + properties, 0);
+    for (size_t obj = 0; obj < objCount; ++obj) {
+        if (img.size() - propStart > 0xFFFF) {
+            fError = "the property table is larger than 64K";
+            return false;
+        }
+        putWord(img, objects + obj * OBJECT_SIZE + 22, img.size() - propStart);
+        img.push_back(NOUN_PROPERTY);
+        img.push_back(1);
+        appendWord(img, wordAddrs[fObjects[obj].noun]);
+        for (const auto& p : fObjects[obj].props) {
+            img.push_back(p.first);
+            img.push_back(p.second.size());
+            for (unsigned v : p.second) {
+                appendWord(img, v);
+            }
+        }
+        img.push_back(PROP_END);
+    }
+
+    putWord(img, H_EVENTTABLE, alignSegment(img));
+    appendWord(img, fEvents.size());
+    for (const auto& e : fEvents) {
+        appendWord(img, e.first);
+        appendWord(img, fRoutines[e.second].addr / ADDRESS_SCALE);
+    }
+
+    // The globals' initial values, and no arrays.
+    putWord(img, H_ARRAYTABLE, alignSegment(img));
+    for (int g = 0; g < MAXGLOBALS; ++g) {
+        appendWord(img, g == PROMPT_GLOBAL ? wordAddrs[fPrompt] : fGlobals[g]);
+    }
+
+    putWord(img, H_DICTTABLE, alignSegment(img));
+    appendWord(img, 1 + fWords.size());
+    img.push_back(0);
+    for (const auto& word : fWords) {
+        img.push_back(word.size());
+        for (char c : word) {
+            img.push_back(c + CHAR_TRANSLATION);
+        }
+    }
+
+    // No synonyms, compounds or removals.
+    putWord(img, H_SYNTABLE, alignSegment(img));
+    appendWord(img, 0);
+
+    // The text bank ends the part of the image that's saved. A game without
+    // any text still gets an empty string, so that the file doesn't end where
+    // the text bank starts.
+    const unsigned textbank = alignSegment(img);
+    if (textbank > 0xFFFF) {
+        fError = "the game is larger than 1M, not counting text";
+        return false;
+    }
+    putWord(img, H_TEXTBANK, textbank);
+    for (const auto& text : fTexts) {
+        appendWord(img, text.size());
+        for (char c : text) {
+            img.push_back(c + CHAR_TRANSLATION);
+        }
+    }
+    if (fTexts.empty()) {
+        appendWord(img, 0);
+    }
+    return true;
+}
+
+
+// Dictionary words that don't all start with the same letter or have the
+// same length, so that FindWord() has to work like it does with real games.
+static std::string
+makeWord( int n )
+{
+    std::string word;
+    unsigned bits = static_cast<unsigned>(n + 1) * 2654435761u;
+    const int prefix = 2 + n % 5;
+    for (int i = 0; i < prefix; ++i) {
+        word += static_cast<char>('a' + bits % 26);
+        bits /= 26;
+    }
+    // Make it unique.
+    int m = n;
+    do {
+        word += static_cast<char>('a' + m % 26);
+        m /= 26;
+    } while (m > 0);
+    return word;
+}
+
+
+bool
+makeSyntheticGame( const HSyntheticGameSpec& spec, HSyntheticGame& game, std::string& error )
+{
+    // Globals the expression reads, which start out as their own number so
+    // that none of them is 0, and the ones the game writes to.
+    const int FIRST_TERM_GLOBAL = 20;
+    const int TERM_GLOBALS = 100;
+    const int RESULT_GLOBAL = 200;
+    const int EVENT_COUNT_GLOBAL = 201;
+
+    if (spec.callDepth < 1 or spec.callDepth > HGameBuilder::MAX_CALL_DEPTH) {
+        error = "call depth must be between 1 and " + std::to_string(HGameBuilder::MAX_CALL_DEPTH);
+        return false;
+    }
+
+    HGameBuilder b;
+    b.setPrompt(">");
+    const int init = b.addRoutine();
+    b.print(init, "Synthetic game: " + std::to_string(spec.objects) + " objects, "
+                  + std::to_string(spec.dictionaryWords) + " words, "
+                  + std::to_string(spec.events) + " events.");
+    b.setJunction(HGameBuilder::INIT, init);
+    const int main = b.addRoutine();
+    b.runEvents(main);
+    b.setJunction(HGameBuilder::MAIN, main);
+
+    // x * y + 17 - z / 3 * ..., with some of the values being globals.
+    HGameExpr expr;
+    static const HGameExpr::Op ops[] = { HGameExpr::MUL, HGameExpr::ADD, HGameExpr::SUB,
+                                         HGameExpr::DIV };
+    for (int i = 0; i < spec.expressionTerms; ++i) {
+        if (i > 0) {
+            expr.op(ops[i % 4]);
+        }
+        if (i % 3 == 2) {
+            expr.global(FIRST_TERM_GLOBAL + i % TERM_GLOBALS);
+        } else {
+            expr.value(3 + i % 11);
+        }
+    }
+    for (int g = FIRST_TERM_GLOBAL; g < FIRST_TERM_GLOBAL + TERM_GLOBALS; ++g) {
+        b.setGlobal(g, g);
+    }
+    const int compute = b.addRoutine();
+    b.assign(compute, RESULT_GLOBAL, expr);
+    b.print(compute, "Computed.");
+    b.returnValue(compute, HGameExpr().value(1));
+
+    // A chain of routines, each calling the next.
+    std::vector<int> chain;
+    for (int i = 0; i < spec.callDepth; ++i) {
+        chain.push_back(b.addRoutine());
+        if (i > 0) {
+            b.call(chain[i - 1], chain[i]);
+        }
+    }
+    const int recurse = b.addRoutine();
+    b.call(recurse, chain.front());
+    b.print(recurse, "Returned from " + std::to_string(spec.callDepth) + " calls.");
+    b.returnValue(recurse, HGameExpr().value(1));
+
+    const int wait = b.addRoutine();
+    b.print(wait, "Time passes.");
+    b.returnValue(wait, HGameExpr().value(1));
+
+    const int quit = b.addRoutine();
+    b.quit(quit);
+
+    b.addVerb({ "recurse" }, recurse);
+    b.addVerb({ "compute" }, compute);
+    b.addVerb({ "wait", "z" }, wait);
+    b.addVerb({ "quit", "q" }, quit, std::vector<std::string>(), true);
+
+    game.words.clear();
+    for (int i = 0; i < spec.dictionaryWords; ++i) {
+        game.words.push_back(makeWord(i));
+        b.addWord(game.words.back());
+    }
+
+    // Objects, in a flat list under object 0.
+    const int properties = HGameBuilder::FIRST_PROPERTY + spec.propertiesPerObject;
+    game.lastProperty = properties - 1;
+    for (int obj = 0; obj < spec.objects; ++obj) {
+        b.addObject(game.words.empty() ? std::string() : game.words[obj % game.words.size()]);
+        for (int p = HGameBuilder::FIRST_PROPERTY; p < properties; ++p) {
+            b.setProperty(obj, p, { static_cast<unsigned>(obj * p) });
+        }
+    }
+
+    for (int i = 0; i < spec.events; ++i) {
+        const int event = b.addRoutine();
+        b.assign(event, EVENT_COUNT_GLOBAL,
+                 HGameExpr().global(EVENT_COUNT_GLOBAL).op(HGameExpr::ADD).value(1));
+        b.addEvent(event);
+    }
+
+    if (not b.build(game.image)) {
+        error = b.errorString();
+        return false;
+    }
+    // After "<result> =".
+    game.expressionAddr = b.routineAddress(compute) + 3;
+    return true;
+}
@@ -0,0 +1,246 @@
+/* Copyright 2015 Nikos Chantziaras
+ *
+ * This file is part of Hugor.
+ *
+ * Hugor is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Hugor is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Hugor.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Additional permission under GNU GPL version 3 section 7
+ *
+ * If you modify this Program, or any covered work, by linking or combining it
+ * with the Hugo Engine (or a modified version of the Hugo Engine), containing
+ * parts covered by the terms of the Hugo License, the licensors of this
+ * Program grant you additional permission to convey the resulting work.
+ * Corresponding Source for a non-source form of such a combination shall
+ * include the source code for the parts of the Hugo Engine used as well as
+ * that of the covered work.
+ */
+#ifndef HGAMEBUILDER_H
+#define HGAMEBUILDER_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+
+// An arithmetic expression, made of values and globals with operators between
+// them. The engine evaluates it left to right with the usual precedence.
+class HGameExpr {
+  public:
+    enum Op { ADD, SUB, MUL, DIV };
+
+    HGameExpr()
+        : fTerms(0)
+    { }
+
+    HGameExpr& value( int v );
+    HGameExpr& global( int g );
+    HGameExpr& op( Op o );
+
+    int
+    terms() const
+    { return fTerms; }
+
+  private:
+    friend class HGameBuilder;
+
+    std::vector<unsigned char> fCode;
+    int fTerms;
+};
+
+
+// Assembles game files (.hex) that LoadGame() accepts, without the Hugo
+// compiler. Games are made of a dictionary, objects with properties, globals,
+// verbs, events and routines. Routines are lists of simple statements; there
+// are no conditionals or loops.
+//
+// Objects are numbered from 0 in the order they're added, and routines are
+// referred to by the number addRoutine() returns. Nothing is checked until
+// build(), which fails if the game doesn't fit into the limits of the file
+// format.
+class HGameBuilder {
+  public:
+    // Properties and globals that the engine reserves come before these.
+    static const int FIRST_PROPERTY = 6;
+    static const int FIRST_GLOBAL = 12;
+
+    // Routines can nest this deep before the engine runs out of stack.
+    static const int MAX_CALL_DEPTH = 240;
+
+    // The engine can't evaluate expressions with more terms than this.
+    static const int MAX_EXPRESSION_TERMS = 60;
+
+    enum Junction { INIT, MAIN, PARSE, PARSE_ERROR, FIND_OBJECT, END_GAME, SPEAK_TO, PERFORM };
+
+    HGameBuilder();
+
+    // Adds a word to the dictionary, if it's not in it yet. Words are
+    // lowercase, like the parser makes the player's input. The empty word is
+    // always there.
+    void
+    addWord( const std::string& word );
+
+    // Adds an object with 'noun' as its noun property, inside 'parent', which
+    // has to be an object added before. The first object is the root of the
+    // object tree, and its parent is ignored. Returns the object's number.
+    int
+    addObject( const std::string& noun, int parent = 0 );
+
+    void
+    setProperty( int obj, int prop, const std::vector<unsigned>& values );
+
+    // Initial value of a global. Globals start out as 0.
+    void
+    setGlobal( int global, int value );
+
+    // The prompt the parser shows when it waits for input. The default is
+    // none.
+    void
+    setPrompt( const std::string& prompt );
+
+    // Adds an empty routine and returns its number.
+    int
+    addRoutine();
+
+    // Junction routines that aren't set are left out, except for Init and
+    // Main, which the engine always runs.
+    void
+    setJunction( Junction junction, int routine );
+
+    // Adds a verb that runs 'routine' when the input is one of 'words'
+    // followed by 'syntax' (a list of specific words.)
+    void
+    addVerb( const std::vector<std::string>& words, int routine,
+             const std::vector<std::string>& syntax = std::vector<std::string>(),
+             bool xverb = false );
+
+    // Adds an event that runs 'routine' every turn. Events of objects other
+    // than 0 only run while the object is near the player.
+    void
+    addEvent( int routine, int object = 0 );
+
+    // Statements, appended to 'routine'. Printed text can be up to 1024
+    // characters long.
+    void
+    print( int routine, const std::string& text );
+
+    void
+    call( int routine, int callee );
+
+    void
+    assign( int routine, int global, const HGameExpr& expr );
+
+    void
+    runEvents( int routine );
+
+    void
+    returnValue( int routine, const HGameExpr& expr );
+
+    void
+    quit( int routine );
+
+    // Assembles the game. Returns false and sets errorString() if it doesn't
+    // fit into the file format.
+    bool
+    build( std::vector<unsigned char>& image );
+
+    const std::string&
+    errorString() const
+    { return fError; }
+
+    // Where the code of a routine starts, once the game is built.
+    unsigned
+    routineAddress( int routine ) const;
+
+  private:
+    struct Object {
+        int parent;
+        std::string noun;
+        std::vector<std::pair<int, std::vector<unsigned>>> props;
+    };
+
+    // A routine's code, and where in it routine addresses go once they're
+    // known.
+    struct Routine {
+        std::vector<unsigned char> code;
+        std::vector<std::pair<size_t, int>> calls;
+        unsigned addr;
+    };
+
+    struct Verb {
+        std::vector<std::string> words;
+        std::vector<std::string> syntax;
+        int routine;
+        bool xverb;
+    };
+
+    std::vector<std::string> fWords;
+    std::vector<Object> fObjects;
+    std::vector<int> fGlobals;
+    std::string fPrompt;
+    std::vector<Routine> fRoutines;
+    std::vector<int> fJunctions;
+    std::vector<Verb> fVerbs;
+    std::vector<std::pair<int, int>> fEvents;
+    std::vector<std::string> fTexts;
+    unsigned long fTextBankSize;
+    std::string fError;
+
+    void
+    fAppendExpr( int routine, const HGameExpr& expr );
+};
+
+
+// Size of a synthetic game made by makeSyntheticGame().
+struct HSyntheticGameSpec {
+    int objects;
+    // Value properties of each object, on top of its noun.
+    int propertiesPerObject;
+    int dictionaryWords;
+    // How deep "recurse" nests routine calls.
+    int callDepth;
+    // Terms of the expression "compute" evaluates.
+    int expressionTerms;
+    // Events that run every turn.
+    int events;
+};
+
+
+// A synthetic game, and where things are in it.
+struct HSyntheticGame {
+    std::vector<unsigned char> image;
+
+    // Code address of the expression "compute" evaluates, which ends with an
+    // end-of-line token.
+    unsigned expressionAddr;
+
+    // The last property of every object, which PropAddr() has to walk the
+    // whole property list to find.
+    int lastProperty;
+
+    // The dictionary words made up for the game, in the order they appear in
+    // the dictionary.
+    std::vector<std::string> words;
+};
+
+
+// Makes a playable game of the given size: the objects are in a flat list,
+// each with a noun from the dictionary and value properties, and every turn
+// runs the events. It understands "recurse", "compute", "wait" (or "z") and
+// "quit" (or "q"). The same spec always gives the same game. Returns false
+// and sets 'error' if the game doesn't fit into the file format.
+bool
+makeSyntheticGame( const HSyntheticGameSpec& spec, HSyntheticGame& game, std::string& error );
+
+
+#endif // HGAMEBUILDER_H
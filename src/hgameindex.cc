@@ -0,0 +1,612 @@
+/* Copyright 2015 Nikos Chantziaras
+ *
+ * This file is part of Hugor.
+ *
+ * Hugor is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Hugor is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Hugor.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Additional permission under GNU GPL version 3 section 7
+ *
+ * If you modify this Program, or any covered work, by linking or combining it
+ * with the Hugo Engine (or a modified version of the Hugo Engine), containing
+ * parts covered by the terms of the Hugo License, the licensors of this
+ * Program grant you additional permission to convey the resulting work.
+ * Corresponding Source for a non-source form of such a combination shall
+ * include the source code for the parts of the Hugo Engine used as well as
+ * that of the covered work.
+ */
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <sys/stat.h>
+
+#include "hgameindex.h"
+#include "htracer.h"
+
+extern "C" {
+#include "heheader.h"
+}
+
+// After the engine's header, since windows.h turns some of the engine's
+// function names (like GetProp) into macros.
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// Identifies index files. The version goes up whenever the layout changes.
+static const std::uint32_t INDEX_MAGIC = 0x58444948; // "HIDX"
+static const std::uint32_t INDEX_VERSION = 2;
+
+// Property slots per object; one for each property number but PROP_END.
+static const std::uint32_t PROP_SLOTS = 256;
+
+// Games with more objects than this get no property table, so that the index
+// stays below 16MB.
+static const std::uint32_t MAX_INDEXED_OBJECTS = 32768;
+
+// Start of an index file. The tables follow it; their offsets are from the
+// start of the file, and all values are in the byte order of the machine that
+// wrote them (the magic number doesn't match otherwise.)
+struct IndexHeader {
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint64_t fileSize;
+
+    // What the index was built from.
+    std::uint64_t gameSize;
+    std::uint64_t gameHash;
+
+    // Dictionary: an open addressing hash table of the addresses of the first
+    // dictCount entries, plus one (0 is an empty slot.) dictEnd is the address
+    // after them.
+    std::uint32_t dictCount;
+    std::uint32_t dictEnd;
+    std::uint32_t dictSlots;
+    std::uint32_t dictOffset;
+
+    // Grammar: (word << 16 | header address) for each dictionary word of each
+    // verb header, sorted, and the addresses of the verb headers that also
+    // match objects. grammarEnd is the address of the end of the grammar
+    // table, or 0 if the grammar isn't indexed.
+    std::uint32_t verbCount;
+    std::uint32_t verbOffset;
+    std::uint32_t objectVerbCount;
+    std::uint32_t objectVerbOffset;
+    std::uint32_t grammarEnd;
+
+    // Properties: what PropAddr(obj, p, 0) returns, PROP_SLOTS per object.
+    // 0 objects if the properties aren't indexed.
+    std::uint32_t objectCount;
+    std::uint32_t propOffset;
+    std::uint32_t reserved;
+};
+
+
+// The index of the running game, either built in memory or mapped from a
+// file.
+class GameIndex {
+  public:
+    explicit GameIndex( const unsigned char* game )
+        : fGame(game),
+          fBase(nullptr),
+          fSize(0),
+          fMapped(false)
+    { }
+
+    ~GameIndex()
+    { this->fUnmap(); }
+
+    bool
+    map( const std::string& file );
+
+    void
+    adopt( std::vector<char>& data )
+    {
+        this->fUnmap();
+        this->fData.swap(data);
+        this->fBase = this->fData.data();
+        this->fSize = this->fData.size();
+    }
+
+    const IndexHeader&
+    header() const
+    { return *reinterpret_cast<const IndexHeader*>(this->fBase); }
+
+    const char*
+    data() const
+    { return this->fBase; }
+
+    std::size_t
+    size() const
+    { return this->fSize; }
+
+    template <typename T>
+    const T*
+    table( std::uint32_t offset ) const
+    { return reinterpret_cast<const T*>(this->fBase + offset); }
+
+    // Memory of the game this index belongs to.
+    const unsigned char*
+    game() const
+    { return this->fGame; }
+
+  private:
+    const unsigned char* fGame;
+    std::vector<char> fData;
+    const char* fBase;
+    std::size_t fSize;
+    bool fMapped;
+
+    void
+    fUnmap();
+};
+
+static std::string cacheDir;
+
+// Part of the engine's state, so each game (or session) has its own.
+static HUGO_TLS GameIndex* currentIndex = nullptr;
+
+
+bool
+GameIndex::map( const std::string& file )
+{
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(file.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+                                nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER size;
+    HANDLE mapping = nullptr;
+    if (GetFileSizeEx(handle, &size) and size.QuadPart > 0) {
+        mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    }
+    CloseHandle(handle);
+    if (mapping == nullptr) {
+        return false;
+    }
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (view == nullptr) {
+        return false;
+    }
+    this->fSize = static_cast<std::size_t>(size.QuadPart);
+#else
+    const int fd = ::open(file.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    void* view = MAP_FAILED;
+    if (::fstat(fd, &st) == 0 and st.st_size > 0) {
+        view = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    ::close(fd);
+    if (view == MAP_FAILED) {
+        return false;
+    }
+    this->fSize = st.st_size;
+#endif
+    this->fBase = static_cast<const char*>(view);
+    this->fMapped = true;
+    return true;
+}
+
+
+void
+GameIndex::fUnmap()
+{
+    if (not this->fMapped) {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(this->fBase);
+#else
+    ::munmap(const_cast<char*>(this->fBase), this->fSize);
+#endif
+    this->fMapped = false;
+    this->fBase = nullptr;
+    this->fSize = 0;
+}
+
+
+static std::uint64_t
+fnv1a( const unsigned char* p, std::size_t len, std::uint64_t h = 14695981039346656037ULL )
+{
+    for (std::size_t i = 0; i < len; ++i) {
+        h = (h ^ p[i]) * 1099511628211ULL;
+    }
+    return h;
+}
+
+
+static std::uint32_t
+wordHash( const char* word, std::size_t len )
+{
+    return static_cast<std::uint32_t>(fnv1a(reinterpret_cast<const unsigned char*>(word), len));
+}
+
+
+// Does the dictionary entry at 'addr' hold 'word'?
+static bool
+entryIs( unsigned int addr, const char* word, std::size_t len )
+{
+    const long base = dicttable * 16L + addr + 2;
+    if (MEM(base) != len) {
+        return false;
+    }
+    for (std::size_t i = 0; i < len; ++i) {
+        if (static_cast<unsigned char>(MEM(base + 1 + i) - CHAR_TRANSLATION)
+            != static_cast<unsigned char>(word[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+static std::string
+absolutePath( const char* path )
+{
+#ifdef _WIN32
+    char buf[_MAX_PATH];
+    if (_fullpath(buf, path, sizeof buf) != nullptr) {
+        return buf;
+    }
+#else
+    char* buf = realpath(path, nullptr);
+    if (buf != nullptr) {
+        std::string ret(buf);
+        std::free(buf);
+        return ret;
+    }
+#endif
+    return path;
+}
+
+
+// Appends 'len' bytes to 'out', aligned to 8 bytes. Returns their offset.
+static std::uint32_t
+appendTable( std::vector<char>& out, const void* data, std::size_t len )
+{
+    out.resize((out.size() + 7) & ~std::size_t(7));
+    const std::uint32_t offset = out.size();
+    out.insert(out.end(), static_cast<const char*>(data), static_cast<const char*>(data) + len);
+    return offset;
+}
+
+
+// Walks the tables of the game in memory. Anything that runs past the end of
+// the game is left out of the index.
+static std::vector<char>
+buildIndex( std::uint64_t gameSize, std::uint64_t gameHash )
+{
+    IndexHeader hdr;
+    std::memset(&hdr, 0, sizeof hdr);
+    hdr.magic = INDEX_MAGIC;
+    hdr.version = INDEX_VERSION;
+    hdr.gameSize = gameSize;
+    hdr.gameHash = gameHash;
+
+    // Dictionary. The table is at most half full. Words that appear twice
+    // are found at their first entry, like FindWord() does.
+    std::vector<unsigned int> entries;
+    unsigned int ptr = 0;
+    int count = 0;
+    for (; count < dictcount and dicttable * 16L + ptr + 2 < codeend; ++count) {
+        const int len = MEM(dicttable * 16L + ptr + 2);
+        if (len > 0) {
+            entries.push_back(ptr);
+        }
+        ptr += len + 1;
+    }
+    std::uint32_t slots = 16;
+    while (slots < entries.size() * 2) {
+        slots *= 2;
+    }
+    std::vector<std::uint32_t> dict(slots, 0);
+    char word[256];
+    for (unsigned int addr : entries) {
+        const long base = dicttable * 16L + addr + 2;
+        const int len = MEM(base);
+        for (int i = 0; i < len; ++i) {
+            word[i] = static_cast<char>(MEM(base + 1 + i) - CHAR_TRANSLATION);
+        }
+        std::uint32_t slot = wordHash(word, len) & (slots - 1);
+        while (dict[slot] != 0 and not entryIs(dict[slot] - 1, word, len)) {
+            slot = (slot + 1) & (slots - 1);
+        }
+        if (dict[slot] == 0) {
+            dict[slot] = addr + 1;
+        }
+    }
+    hdr.dictCount = count;
+    hdr.dictEnd = ptr;
+    hdr.dictSlots = slots;
+
+    // Grammar, walked the way MatchCommand() does. Verb headers with object
+    // entries (0xffff and a value) have to be looked at for every verb, since
+    // the object's nouns can change; their remaining words aren't indexed.
+    std::vector<std::uint32_t> verbs;
+    std::vector<std::uint32_t> objectVerbs;
+    const long grammar = gameseg * 16L;
+    ptr = 64;
+    bool grammarOk = true;
+    while (grammarOk and MEM(grammar + ptr) != 255) {
+        const int token = MEM(grammar + ptr);
+        if (token == VERB_T or token == XVERB_T) {
+            const int numverbs = MEM(grammar + ptr + 1);
+            for (int i = 0; i < numverbs; ++i) {
+                const long at = grammar + ptr + 2 + i * 2;
+                const unsigned int w = MEM(at) + MEM(at + 1) * 256;
+                if (w == 0xffff) {
+                    objectVerbs.push_back(ptr);
+                    break;
+                }
+                verbs.push_back(w << 16 | ptr);
+            }
+            ptr += 2 + numverbs * 2;
+        } else {
+            ptr += MEM(grammar + ptr + 1) + 1;
+        }
+        grammarOk = ptr <= 0xffff and grammar + ptr < codeend;
+    }
+    if (grammarOk) {
+        std::sort(verbs.begin(), verbs.end());
+        verbs.erase(std::unique(verbs.begin(), verbs.end()), verbs.end());
+        hdr.verbCount = verbs.size();
+        hdr.objectVerbCount = objectVerbs.size();
+        hdr.grammarEnd = ptr;
+    }
+
+    // Properties, walked the way PropAddr() does.
+    std::vector<std::uint16_t> props;
+    if (objects > 0 and objects <= static_cast<int>(MAX_INDEXED_OBJECTS)) {
+        props.assign(objects * PROP_SLOTS, 0);
+        const long propBase = proptable * 16L;
+        bool propsOk = true;
+        for (int obj = 0; obj < objects and propsOk; ++obj) {
+            const long at = objtable * 16L + object_size * (obj + 1);
+            ptr = MEM(at) + MEM(at + 1) * 256;
+            bool seen[PROP_SLOTS] = {};
+            while (propsOk and MEM(propBase + ptr) != PROP_END) {
+                const int p = MEM(propBase + ptr);
+                if (not seen[p]) {
+                    seen[p] = true;
+                    props[obj * PROP_SLOTS + p] = ptr;
+                }
+                int proplen = MEM(propBase + ptr + 1);
+                if (proplen == PROP_ROUTINE) {
+                    proplen = 1;
+                }
+                ptr += proplen * 2 + 2;
+                propsOk = ptr <= 0xffff and propBase + ptr < codeend;
+            }
+        }
+        if (propsOk) {
+            hdr.objectCount = objects;
+        }
+    }
+
+    std::vector<char> out(sizeof hdr);
+    hdr.dictOffset = appendTable(out, dict.data(), dict.size() * sizeof dict[0]);
+    if (hdr.grammarEnd != 0) {
+        hdr.verbOffset = appendTable(out, verbs.data(), verbs.size() * sizeof verbs[0]);
+        hdr.objectVerbOffset = appendTable(out, objectVerbs.data(),
+                                           objectVerbs.size() * sizeof objectVerbs[0]);
+    }
+    if (hdr.objectCount != 0) {
+        hdr.propOffset = appendTable(out, props.data(), props.size() * sizeof props[0]);
+    }
+    hdr.fileSize = out.size();
+    std::memcpy(out.data(), &hdr, sizeof hdr);
+    return out;
+}
+
+
+// Is the index file well-formed, and for a game with the same tables as the
+// one in memory?
+static bool
+fitsGame( const GameIndex& index )
+{
+    if (index.size() < sizeof(IndexHeader)) {
+        return false;
+    }
+    const IndexHeader& hdr = index.header();
+    const std::uint64_t size = index.size();
+    auto fits = [size]( std::uint32_t offset, std::uint64_t len ) {
+        return offset % 8 == 0 and offset + len <= size;
+    };
+    return hdr.magic == INDEX_MAGIC and hdr.version == INDEX_VERSION and hdr.fileSize == size
+           and hdr.dictSlots >= 16 and (hdr.dictSlots & (hdr.dictSlots - 1)) == 0
+           and fits(hdr.dictOffset, hdr.dictSlots * 4ULL)
+           and fits(hdr.verbOffset, hdr.verbCount * 4ULL)
+           and fits(hdr.objectVerbOffset, hdr.objectVerbCount * 4ULL)
+           and fits(hdr.propOffset, hdr.objectCount * PROP_SLOTS * 2ULL)
+           and static_cast<int>(hdr.dictCount) == dictcount
+           and (hdr.objectCount == 0 or static_cast<int>(hdr.objectCount) == objects);
+}
+
+
+// Writes the index next to where it goes and moves it there, so that other
+// instances never map a partly written file.
+static void
+writeIndex( const std::string& file, const GameIndex& index )
+{
+    const std::string tmp = file + ".tmp";
+    std::FILE* out = std::fopen(tmp.c_str(), "wb");
+    if (out == nullptr) {
+        return;
+    }
+    const bool ok = std::fwrite(index.data(), 1, index.size(), out) == index.size();
+    if (std::fclose(out) != 0 or not ok) {
+        std::remove(tmp.c_str());
+        return;
+    }
+#ifdef _WIN32
+    std::remove(file.c_str());
+#endif
+    if (std::rename(tmp.c_str(), file.c_str()) != 0) {
+        std::remove(tmp.c_str());
+    }
+}
+
+
+void
+HGameIndex::setCacheDir( const std::string& dir )
+{
+    cacheDir = dir;
+}
+
+
+void
+HGameIndex::load()
+{
+    HGameIndex::unload();
+    if (mem == nullptr) {
+        return;
+    }
+    HTraceScope trace("game index", "startup");
+
+    struct stat st;
+    const bool haveStat = ::stat(gamefile, &st) == 0;
+    const std::uint64_t gameSize = haveStat ? st.st_size : 0;
+    const std::uint64_t gameHash = fnv1a(mem, codeend);
+    GameIndex* index = new GameIndex(mem);
+
+    std::string file;
+    if (haveStat and not cacheDir.empty()) {
+        const std::string path = absolutePath(gamefile);
+        char name[32];
+        std::snprintf(name, sizeof name, "%016llx.idx", static_cast<unsigned long long>(
+                          fnv1a(reinterpret_cast<const unsigned char*>(path.data()), path.size())));
+        file = cacheDir + '/' + name;
+        // Not keyed on the modification time: copies and unpacked archives can
+        // keep the one of a different game.
+        if (index->map(file) and fitsGame(*index) and index->header().gameSize == gameSize
+            and index->header().gameHash == gameHash)
+        {
+            currentIndex = index;
+            return;
+        }
+    }
+
+    std::vector<char> data = buildIndex(gameSize, gameHash);
+    index->adopt(data);
+    if (not file.empty()) {
+        writeIndex(file, *index);
+    }
+    currentIndex = index;
+}
+
+
+void
+HGameIndex::unload()
+{
+    delete currentIndex;
+    currentIndex = nullptr;
+}
+
+
+// Engine side. Each lookup first makes sure the index is of the game in
+// memory.
+static const GameIndex*
+indexOfGame()
+{
+    if (currentIndex == nullptr or currentIndex->game() != mem) {
+        return nullptr;
+    }
+    return currentIndex;
+}
+
+
+void
+hugo_loadindex( void )
+{
+    HGameIndex::load();
+}
+
+
+int
+hugo_indexfindword( const char* a, unsigned int* ptr, int* i )
+{
+    const GameIndex* index = indexOfGame();
+    if (index == nullptr or dictcount < static_cast<int>(index->header().dictCount)) {
+        return false;
+    }
+    const IndexHeader& hdr = index->header();
+    const std::uint32_t* dict = index->table<std::uint32_t>(hdr.dictOffset);
+    const std::size_t len = std::strlen(a);
+    for (std::uint32_t slot = wordHash(a, len) & (hdr.dictSlots - 1); dict[slot] != 0;
+         slot = (slot + 1) & (hdr.dictSlots - 1))
+    {
+        if (entryIs(dict[slot] - 1, a, len)) {
+            *ptr = dict[slot] - 1;
+            return true;
+        }
+    }
+    // It can only be one of the words the game added since.
+    *ptr = hdr.dictEnd;
+    *i = hdr.dictCount + 1;
+    return false;
+}
+
+
+unsigned int
+hugo_indexverb( unsigned int word, unsigned int ptr )
+{
+    const GameIndex* index = indexOfGame();
+    if (index == nullptr or index->header().grammarEnd == 0 or word > 0xffff
+        or ptr > index->header().grammarEnd)
+    {
+        return ptr;
+    }
+    const IndexHeader& hdr = index->header();
+    unsigned int next = hdr.grammarEnd;
+    const std::uint32_t* verbs = index->table<std::uint32_t>(hdr.verbOffset);
+    const std::uint32_t* verbsEnd = verbs + hdr.verbCount;
+    const std::uint32_t* v = std::lower_bound(verbs, verbsEnd, word << 16 | ptr);
+    if (v != verbsEnd and *v >> 16 == word) {
+        next = std::min(next, *v & 0xffff);
+    }
+    const std::uint32_t* objectVerbs = index->table<std::uint32_t>(hdr.objectVerbOffset);
+    const std::uint32_t* objectVerbsEnd = objectVerbs + hdr.objectVerbCount;
+    const std::uint32_t* o = std::lower_bound(objectVerbs, objectVerbsEnd, ptr);
+    if (o != objectVerbsEnd) {
+        next = std::min(next, *o);
+    }
+    return next;
+}
+
+
+int
+hugo_indexpropaddr( int obj, int p, unsigned int* ptr )
+{
+    const GameIndex* index = indexOfGame();
+    if (index == nullptr or obj >= static_cast<int>(index->header().objectCount) or p < 0
+        or p >= PROP_END)
+    {
+        return false;
+    }
+    *ptr = index->table<std::uint16_t>(index->header().propOffset)[obj * PROP_SLOTS + p];
+    return true;
+}
@@ -0,0 +1,69 @@
+/* Copyright 2015 Nikos Chantziaras
+ *
+ * This file is part of Hugor.
+ *
+ * Hugor is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Hugor is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Hugor.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Additional permission under GNU GPL version 3 section 7
+ *
+ * If you modify this Program, or any covered work, by linking or combining it
+ * with the Hugo Engine (or a modified version of the Hugo Engine), containing
+ * parts covered by the terms of the Hugo License, the licensors of this
+ * Program grant you additional permission to convey the resulting work.
+ * Corresponding Source for a non-source form of such a combination shall
+ * include the source code for the parts of the Hugo Engine used as well as
+ * that of the covered work.
+ */
+#ifndef HGAMEINDEX_H
+#define HGAMEINDEX_H
+
+#include <string>
+
+
+// Lookup structures for a game: a hash table of the dictionary, the verb
+// headers of the grammar table by verb word, and the address of each property
+// of each object. The engine looks things up in them (through the HUGO_*_HOOK
+// macros) instead of scanning the dictionary in FindWord(), the grammar table
+// in MatchCommand() and property lists in PropAddr(). The index only holds
+// what can't change while the game runs; dictionary words the game adds later
+// are still found by scanning.
+//
+// Building the index means walking all of the game's tables, so it's kept in
+// a cache directory, in a file named after the game's path, and mapped into
+// memory the next time the game is loaded. The file is used as long as the
+// game's size and a hash of its contents match the ones it was built from.
+// Hashing is one pass over the game, which is much cheaper than building the
+// index.
+//
+// The index belongs to the game that runs on the calling thread (or in the
+// calling HeadlessSession.) It's dropped when the game's memory is freed.
+class HGameIndex {
+  public:
+    // Directory to keep indexes in. Without one, indexes are built each time
+    // a game is loaded. The directory has to exist. Set it before running
+    // any games.
+    static void
+    setCacheDir( const std::string& dir );
+
+    // Loads the index of the game that LoadGame() has just loaded, or builds
+    // it if it isn't in the cache.
+    static void
+    load();
+
+    static void
+    unload();
+};
+
+
+#endif // HGAMEINDEX_H
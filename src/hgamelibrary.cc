@@ -0,0 +1,400 @@
+/* Copyright 2015 Nikos Chantziaras
+ *
+ * This file is part of Hugor.
+ *
+ * Hugor is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Hugor is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Hugor.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Additional permission under GNU GPL version 3 section 7
+ *
+ * If you modify this Program, or any covered work, by linking or combining it
+ * with the Hugo Engine (or a modified version of the Hugo Engine), containing
+ * parts covered by the terms of the Hugo License, the licensors of this
+ * Program grant you additional permission to convey the resulting work.
+ * Corresponding Source for a non-source form of such a combination shall
+ * include the source code for the parts of the Hugo Engine used as well as
+ * that of the covered work.
+ */
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QMap>
+#include <QSaveFile>
+#include <QThread>
+#include <QXmlStreamReader>
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include "hgamelibrary.h"
+#include "htracer.h"
+extern "C" {
+#include "heheader.h"
+}
+
+// Identifies cache files. The version goes up whenever the layout changes.
+static const quint32 LIBRARY_MAGIC = 0x42494c48; // "HLIB"
+static const quint32 LIBRARY_VERSION = 1;
+
+const int HGameLibrary::COVER_SIZE;
+
+
+// Little endian word at 'addr', the way games and resource files store them.
+static unsigned int
+peekWord( const QByteArray& data, int addr )
+{
+    if (addr < 0 or addr + 1 >= data.size()) {
+        return 0;
+    }
+    return static_cast<unsigned char>(data[addr]) | static_cast<unsigned char>(data[addr + 1]) << 8;
+}
+
+
+// Adds the files in 'dir' to 'files', keyed by lower-case name, like
+// listFiles() in heqt.cc.
+static void
+listFiles( const QString& dir, QMap<QString, QString>& files )
+{
+    if (dir.isEmpty()) {
+        return;
+    }
+    const QDir qdir(dir);
+    for (const QString& name : qdir.entryList(QDir::Files)) {
+        files.insert(name.toLower(), qdir.filePath(name));
+    }
+}
+
+
+// The words in the game's dictionary. 'data' holds the game up to its text
+// bank.
+static QStringList
+dictionaryWords( const QByteArray& data )
+{
+    QStringList words;
+    const int dict = peekWord(data, H_DICTTABLE) * 16;
+    const unsigned int count = peekWord(data, dict);
+    int ptr = dict + 2;
+    for (unsigned int i = 1; i <= count and ptr < data.size(); ++i) {
+        const int len = static_cast<unsigned char>(data[ptr]);
+        if (ptr + len >= data.size()) {
+            break;
+        }
+        QByteArray word = data.mid(ptr + 1, len);
+        for (char& c : word) {
+            c -= CHAR_TRANSLATION;
+        }
+        if (len > 0) {
+            words.append(QString::fromLatin1(word));
+        }
+        ptr += len + 1;
+    }
+    return words;
+}
+
+
+// The "cover" resource in the resource file at 'path', if it is a resource file
+// and has one. The directory is read the same way FindResource() does.
+static QImage
+readCover( const QString& path )
+{
+    QFile file(path);
+    if (not file.open(QIODevice::ReadOnly)) {
+        return QImage();
+    }
+    const QByteArray header = file.read(6);
+    if (header.size() < 6 or (header[0] != 'r' and header[0] != 'R')) {
+        return QImage();
+    }
+    // 'R' is the old format, with 24 bit positions and lengths.
+    const int numberSize = header[0] == 'r' ? 4 : 3;
+    const unsigned int count = peekWord(header, 2);
+    const unsigned int startOfData = peekWord(header, 4);
+    const QByteArray dir = file.read(startOfData > 6 ? startOfData - 6 : 0);
+
+    int ptr = 0;
+    for (unsigned int i = 1; i <= count and ptr < dir.size(); ++i) {
+        const int len = static_cast<unsigned char>(dir[ptr]);
+        if (ptr + 1 + len + numberSize * 2 > dir.size()) {
+            break;
+        }
+        const QString name = QString::fromLatin1(dir.mid(ptr + 1, len));
+        ptr += 1 + len;
+        qint64 position = 0;
+        qint64 length = 0;
+        for (int b = numberSize - 1; b >= 0; --b) {
+            position = position << 8 | static_cast<unsigned char>(dir[ptr + b]);
+            length = length << 8 | static_cast<unsigned char>(dir[ptr + numberSize + b]);
+        }
+        ptr += numberSize * 2;
+
+        // Resources are usually named after the file they were made from, so
+        // "cover.jpg" counts too.
+        if (name.section(QChar::fromLatin1('.'), 0, 0).compare(QString::fromLatin1("cover"), Qt::CaseInsensitive)
+            != 0)
+        {
+            continue;
+        }
+        QImage cover;
+        if (file.seek(startOfData + position)) {
+            cover.loadFromData(file.read(length));
+        }
+        return cover;
+    }
+    return QImage();
+}
+
+
+// The title in the iFiction record at 'path'.
+static QString
+readTitle( const QString& path )
+{
+    QFile file(path);
+    if (not file.open(QIODevice::ReadOnly)) {
+        return QString();
+    }
+    QXmlStreamReader xml(&file);
+    while (not xml.atEnd()) {
+        if (xml.readNext() == QXmlStreamReader::StartElement and xml.name() == QLatin1String("title")) {
+            return xml.readElementText().simplified();
+        }
+    }
+    return QString();
+}
+
+
+// Fills in what the library shows for 'game'. 'gameDirFiles' are the files in
+// the game's directory, and 'searchFiles' those in the other directories the
+// engine looks for resource files in.
+static void
+readGame( HGameLibrary::Game& game, const QMap<QString, QString>& gameDirFiles,
+          const QMap<QString, QString>& searchFiles )
+{
+    HTraceScope trace("read game", "library");
+    const QFileInfo info(game.path);
+    game.version = 0;
+    game.playable = false;
+    game.title = info.completeBaseName();
+
+    QFile file(game.path);
+    if (not file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+    QByteArray data = file.read(H_TEXTBANK + 2);
+    if (data.size() < H_TEXTBANK + 2) {
+        return;
+    }
+
+    // Same as LoadGame().
+    game.version = static_cast<unsigned char>(data[H_GAMEVERSION]);
+    if (game.version == 1 or game.version == 2) {
+        game.version *= 10;
+    }
+    game.playable = game.version >= HEVERSION and game.version <= HEVERSION * 10 + HEREVISION;
+    game.id = QString::fromLatin1(data.mid(H_ID, 2).constData());
+    game.serial = QString::fromLatin1(data.mid(H_SERIAL, 8).constData());
+
+    const QString& iFiction = gameDirFiles.value(game.title.toLower() + QString::fromLatin1(".ifiction"));
+    if (not iFiction.isEmpty()) {
+        const QString& title = readTitle(iFiction);
+        if (not title.isEmpty()) {
+            game.title = title;
+        }
+    }
+
+    // The cover is in one of the resource files the game refers to, and those
+    // are named in the dictionary. Pre-v2.5 games have no performaddr in the
+    // header, so the address of their text bank comes earlier.
+    if (not game.playable) {
+        return;
+    }
+    const qint64 codeEnd = peekWord(data, game.version >= 25 ? H_TEXTBANK : H_TEXTBANK - 2) * 16LL;
+    if (not file.seek(0)) {
+        return;
+    }
+    data = file.read(std::min(codeEnd, file.size()));
+    QMap<QString, QString> files = searchFiles;
+    for (auto i = gameDirFiles.constBegin(); i != gameDirFiles.constEnd(); ++i) {
+        files.insert(i.key(), i.value());
+    }
+    for (const QString& word : dictionaryWords(data)) {
+        const QString& path = files.value(word.toLower());
+        if (path.isEmpty() or path == game.path) {
+            continue;
+        }
+        const QImage& cover = readCover(path);
+        if (not cover.isNull()) {
+            if (cover.width() > HGameLibrary::COVER_SIZE or cover.height() > HGameLibrary::COVER_SIZE) {
+                game.cover = cover.scaled(HGameLibrary::COVER_SIZE, HGameLibrary::COVER_SIZE, Qt::KeepAspectRatio,
+                                          Qt::SmoothTransformation);
+            } else {
+                game.cover = cover;
+            }
+            return;
+        }
+    }
+}
+
+
+HGameLibrary::HGameLibrary( const QString& cacheFile )
+    : fCacheFile(cacheFile)
+{ }
+
+
+bool
+HGameLibrary::load()
+{
+    this->fGames.clear();
+    QFile file(this->fCacheFile);
+    if (not file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_0);
+    quint32 magic, version, count;
+    in >> magic >> version >> count;
+    if (in.status() != QDataStream::Ok or magic != LIBRARY_MAGIC or version != LIBRARY_VERSION) {
+        return false;
+    }
+    QVector<Game> games;
+    for (quint32 i = 0; i < count and in.status() == QDataStream::Ok; ++i) {
+        Game game;
+        qint32 gameVersion;
+        in >> game.path >> game.size >> game.modified >> gameVersion >> game.id >> game.serial >> game.playable
+           >> game.title >> game.cover;
+        game.version = gameVersion;
+        games.append(game);
+    }
+    if (in.status() != QDataStream::Ok) {
+        return false;
+    }
+    this->fGames = games;
+    return true;
+}
+
+
+bool
+HGameLibrary::scan( const QStringList& dirs, const std::atomic<bool>* cancel )
+{
+    HTraceScope trace("library scan", "library");
+    QHash<QString, int> cached;
+    for (int i = 0; i < this->fGames.size(); ++i) {
+        cached.insert(this->fGames.at(i).path, i);
+    }
+
+    // Games that haven't changed are kept as they are; the rest are read
+    // below.
+    QVector<Game> games;
+    std::vector<int> stale;
+    for (const QString& dir : dirs) {
+        QDirIterator it(dir, QDir::Files, QDirIterator::Subdirectories);
+        while (it.hasNext()) {
+            it.next();
+            const QFileInfo& info = it.fileInfo();
+            if (info.suffix().compare(QString::fromLatin1("hex"), Qt::CaseInsensitive) != 0) {
+                continue;
+            }
+            Game game;
+            game.path = info.absoluteFilePath();
+            game.size = info.size();
+            game.modified = info.lastModified().toMSecsSinceEpoch();
+            const auto c = cached.constFind(game.path);
+            if (c != cached.constEnd() and this->fGames.at(*c).size == game.size
+                and this->fGames.at(*c).modified == game.modified)
+            {
+                games.append(this->fGames.at(*c));
+            } else {
+                stale.push_back(games.size());
+                games.append(game);
+            }
+        }
+    }
+    if (stale.empty() and games.size() == this->fGames.size()) {
+        return false;
+    }
+
+    QMap<QString, QString> searchFiles;
+    listFiles(QString::fromLocal8Bit(qgetenv("HUGO_GAMES")), searchFiles);
+    listFiles(QString::fromLocal8Bit(qgetenv("HUGO_OBJECT")), searchFiles);
+    // Many games can share a directory, so each one is only listed once.
+    QHash<QString, QMap<QString, QString>> dirFiles;
+    for (int i : stale) {
+        const QString& dir = QFileInfo(games.at(i).path).path();
+        if (not dirFiles.contains(dir)) {
+            listFiles(dir, dirFiles[dir]);
+        }
+    }
+
+    // Each thread takes the next game nobody has taken yet. They only write
+    // to their own games and 'done' entries.
+    Game* const gameData = games.data();
+    std::vector<char> done(stale.size(), false);
+    std::atomic<size_t> next(0);
+    auto work = [&] {
+        HTracer::setThreadName("library");
+        for (size_t i = next++; i < stale.size(); i = next++) {
+            if (cancel != nullptr and *cancel) {
+                break;
+            }
+            Game& game = gameData[stale[i]];
+            readGame(game, dirFiles.constFind(QFileInfo(game.path).path()).value(), searchFiles);
+            done[i] = true;
+        }
+    };
+    const size_t threadCount = std::min(static_cast<size_t>(std::max(QThread::idealThreadCount(), 1)), stale.size());
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < threadCount; ++i) {
+        threads.emplace_back(work);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    this->fGames.clear();
+    size_t s = 0;
+    for (int i = 0; i < games.size(); ++i) {
+        if (s < stale.size() and stale[s] == i) {
+            if (not done[s++]) {
+                continue;
+            }
+        }
+        this->fGames.append(games.at(i));
+    }
+    std::sort(this->fGames.begin(), this->fGames.end(), [](const Game& a, const Game& b) {
+        const int cmp = QString::compare(a.title, b.title, Qt::CaseInsensitive);
+        return cmp < 0 or (cmp == 0 and a.path < b.path);
+    });
+    return true;
+}
+
+
+bool
+HGameLibrary::save() const
+{
+    QDir().mkpath(QFileInfo(this->fCacheFile).path());
+    QSaveFile file(this->fCacheFile);
+    if (not file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << LIBRARY_MAGIC << LIBRARY_VERSION << static_cast<quint32>(this->fGames.size());
+    for (const Game& game : this->fGames) {
+        out << game.path << game.size << game.modified << static_cast<qint32>(game.version) << game.id << game.serial
+            << game.playable << game.title << game.cover;
+    }
+    return out.status() == QDataStream::Ok and file.commit();
+}
@@ -0,0 +1,108 @@
+/* Copyright 2015 Nikos Chantziaras
+ *
+ * This file is part of Hugor.
+ *
+ * Hugor is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Hugor is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Hugor.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Additional permission under GNU GPL version 3 section 7
+ *
+ * If you modify this Program, or any covered work, by linking or combining it
+ * with the Hugo Engine (or a modified version of the Hugo Engine), containing
+ * parts covered by the terms of the Hugo License, the licensors of this
+ * Program grant you additional permission to convey the resulting work.
+ * Corresponding Source for a non-source form of such a combination shall
+ * include the source code for the parts of the Hugo Engine used as well as
+ * that of the covered work.
+ */
+#ifndef HGAMELIBRARY_H
+#define HGAMELIBRARY_H
+
+#include <QImage>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <atomic>
+
+
+// A collection of games, for picking one to play from a list instead of a
+// file dialog. What's shown for each game is read from the game file itself
+// and the files next to it, without running it:
+//
+//   - the version, id and serial number from the header, as LoadGame() reads
+//     them;
+//   - a cover picture: a resource named "cover" in a resource file the game
+//     refers to;
+//   - a title: the one in an iFiction file with the same base name as the
+//     game, if there is one. Hugo games don't carry their title anywhere they
+//     don't print it from, so otherwise it's the file's base name.
+//
+// Reading all that is slow for hundreds of games, so it's kept in a cache
+// file. A scan only reads games that are new or have changed since they were
+// cached, and reads them in parallel.
+class HGameLibrary {
+  public:
+    struct Game {
+        QString path;
+
+        // What the cached information was read from.
+        qint64 size;
+        qint64 modified;
+
+        // Header of the game, like the engine's game_version, id and serial.
+        // 'playable' is false when the engine would refuse to load the file.
+        int version;
+        QString id;
+        QString serial;
+        bool playable;
+
+        QString title;
+        QImage cover;
+    };
+
+    // Size of the cover pictures kept in the cache; larger ones are scaled
+    // down to fit.
+    static const int COVER_SIZE = 160;
+
+    explicit
+    HGameLibrary( const QString& cacheFile );
+
+    // Reads the games from the cache file. Returns false when there's no
+    // usable cache, which leaves the library empty.
+    bool
+    load();
+
+    // Looks for .hex files in 'dirs' and their subdirectories and reads the
+    // ones that aren't in the library yet or have changed. Games that are no
+    // longer there are dropped. Setting 'cancel' stops the scan early; the
+    // games that weren't read by then are left out. Returns whether the
+    // library changed.
+    bool
+    scan( const QStringList& dirs, const std::atomic<bool>* cancel = nullptr );
+
+    // Writes the games to the cache file.
+    bool
+    save() const;
+
+    // Sorted by title.
+    const QVector<Game>&
+    games() const
+    { return this->fGames; }
+
+  private:
+    QString fCacheFile;
+    QVector<Game> fGames;
+};
+
+
+#endif // HGAMELIBRARY_H
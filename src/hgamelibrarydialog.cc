@@ -0,0 +1,155 @@
+/* Copyright 2015 Nikos Chantziaras
+ *
+ * This file is part of Hugor.
+ *
+ * Hugor is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Hugor is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Hugor.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Additional permission under GNU GPL version 3 section 7
+ *
+ * If you modify this Program, or any covered work, by linking or combining it
+ * with the Hugo Engine (or a modified version of the Hugo Engine), containing
+ * parts covered by the terms of the Hugo License, the licensors of this
+ * Program grant you additional permission to convey the resulting work.
+ * Corresponding Source for a non-source form of such a combination shall
+ * include the source code for the parts of the Hugo Engine used as well as
+ * that of the covered work.
+ */
+#include <QDialogButtonBox>
+#include <QIcon>
+#include <QLabel>
+#include <QListWidget>
+#include <QPixmap>
+#include <QPushButton>
+#include <QVBoxLayout>
+
+#include "hgamelibrarydialog.h"
+#include "htracer.h"
+
+
+HGameLibraryDialog::HGameLibraryDialog( const QStringList& dirs, const QString& cacheFile, QWidget* parent )
+    : QDialog(parent),
+      fLibrary(cacheFile),
+      fCancelScan(false),
+      fList(new QListWidget),
+      fStatus(new QLabel(tr("Looking for new games..."))),
+      fOpenButton(0)
+{
+    this->setWindowTitle(tr("Choose a Game"));
+    this->fList->setViewMode(QListView::IconMode);
+    this->fList->setIconSize(QSize(HGameLibrary::COVER_SIZE, HGameLibrary::COVER_SIZE));
+    this->fList->setGridSize(QSize(HGameLibrary::COVER_SIZE + 40, HGameLibrary::COVER_SIZE + 60));
+    this->fList->setResizeMode(QListView::Adjust);
+    this->fList->setMovement(QListView::Static);
+    this->fList->setWordWrap(true);
+
+    QDialogButtonBox* buttons = new QDialogButtonBox(QDialogButtonBox::Open | QDialogButtonBox::Cancel);
+    this->fOpenButton = buttons->button(QDialogButtonBox::Open);
+    connect(buttons, SIGNAL(accepted()), SLOT(accept()));
+    connect(buttons, SIGNAL(rejected()), SLOT(reject()));
+    connect(this->fList, SIGNAL(itemActivated(QListWidgetItem*)), SLOT(accept()));
+    connect(this->fList, SIGNAL(currentItemChanged(QListWidgetItem*, QListWidgetItem*)), SLOT(fUpdateOpenButton()));
+
+    QVBoxLayout* layout = new QVBoxLayout(this);
+    layout->addWidget(this->fList);
+    layout->addWidget(this->fStatus);
+    layout->addWidget(buttons);
+    this->resize(800, 600);
+
+    {
+        HTraceScope trace("library load", "library");
+        this->fLibrary.load();
+    }
+    this->fFillList();
+
+    // The scan works on a copy, so that the list can show this one meanwhile.
+    this->fScanned.reset(new HGameLibrary(this->fLibrary));
+    HGameLibrary* scanned = this->fScanned.get();
+    this->fScan = std::async(std::launch::async, [this, scanned, dirs] {
+        const bool changed = scanned->scan(dirs, &this->fCancelScan);
+        if (changed) {
+            scanned->save();
+        }
+        QMetaObject::invokeMethod(this, "fScanFinished", Qt::QueuedConnection, Q_ARG(bool, changed));
+    });
+}
+
+
+HGameLibraryDialog::~HGameLibraryDialog()
+{
+    this->fCancelScan = true;
+    if (this->fScan.valid()) {
+        this->fScan.wait();
+    }
+}
+
+
+void
+HGameLibraryDialog::fFillList()
+{
+    const QString& current = this->selectedGame();
+    this->fList->clear();
+    for (const HGameLibrary::Game& game : this->fLibrary.games()) {
+        const QIcon& icon = game.cover.isNull() ? this->windowIcon() : QIcon(QPixmap::fromImage(game.cover));
+        QListWidgetItem* item = new QListWidgetItem(icon, game.title, this->fList);
+        item->setData(Qt::UserRole, game.path);
+        QString tip = game.path + QChar::fromLatin1('\n');
+        if (game.playable) {
+            tip += tr("Hugo %1.%2, id \"%3\", serial %4")
+                       .arg(game.version / 10).arg(game.version % 10).arg(game.id, game.serial);
+        } else {
+            // The engine would refuse to load it.
+            item->setFlags(item->flags() & ~Qt::ItemIsEnabled);
+            tip += tr("Not a game this version of Hugor can play.");
+        }
+        item->setToolTip(tip);
+        if (game.path == current) {
+            this->fList->setCurrentItem(item);
+        }
+    }
+    this->fUpdateOpenButton();
+}
+
+
+void
+HGameLibraryDialog::fScanFinished( bool changed )
+{
+    if (changed) {
+        this->fLibrary = *this->fScanned;
+        this->fFillList();
+    }
+    this->fScanned.reset();
+    if (this->fList->count() == 0) {
+        this->fStatus->setText(tr("No games were found."));
+    } else {
+        this->fStatus->hide();
+    }
+}
+
+
+void
+HGameLibraryDialog::fUpdateOpenButton()
+{
+    this->fOpenButton->setEnabled(not this->selectedGame().isEmpty());
+}
+
+
+QString
+HGameLibraryDialog::selectedGame() const
+{
+    const QListWidgetItem* item = this->fList->currentItem();
+    if (item == nullptr or not (item->flags() & Qt::ItemIsEnabled)) {
+        return QString();
+    }
+    return item->data(Qt::UserRole).toString();
+}
@@ -0,0 +1,84 @@
+/* Copyright 2015 Nikos Chantziaras
+ *
+ * This file is part of Hugor.
+ *
+ * Hugor is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Hugor is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Hugor.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Additional permission under GNU GPL version 3 section 7
+ *
+ * If you modify this Program, or any covered work, by linking or combining it
+ * with the Hugo Engine (or a modified version of the Hugo Engine), containing
+ * parts covered by the terms of the Hugo License, the licensors of this
+ * Program grant you additional permission to convey the resulting work.
+ * Corresponding Source for a non-source form of such a combination shall
+ * include the source code for the parts of the Hugo Engine used as well as
+ * that of the covered work.
+ */
+#ifndef HGAMELIBRARYDIALOG_H
+#define HGAMELIBRARYDIALOG_H
+
+#include <QDialog>
+#include <atomic>
+#include <future>
+#include <memory>
+
+#include "hgamelibrary.h"
+
+
+// Lets the player pick a game from a library (see HGameLibrary.) The games in
+// the library's cache are listed right away; the directories are scanned for
+// new and changed games in the background, and the list is updated when
+// that's done.
+class HGameLibraryDialog: public QDialog {
+    Q_OBJECT
+
+  private:
+    // What the list shows.
+    HGameLibrary fLibrary;
+
+    // The library the background scan works on, while it runs.
+    std::unique_ptr<HGameLibrary> fScanned;
+    std::future<void> fScan;
+    std::atomic<bool> fCancelScan;
+
+    class QListWidget* fList;
+    class QLabel* fStatus;
+    class QPushButton* fOpenButton;
+
+    void
+    fFillList();
+
+  private slots:
+    // Called in the GUI thread once the background scan is done. 'changed'
+    // tells whether it found anything new.
+    void
+    fScanFinished( bool changed );
+
+    void
+    fUpdateOpenButton();
+
+  public:
+    HGameLibraryDialog( const QStringList& dirs, const QString& cacheFile, QWidget* parent = 0 );
+
+    // Stops the background scan. What it has read by then is still cached.
+    virtual
+    ~HGameLibraryDialog();
+
+    // Path of the chosen game.
+    QString
+    selectedGame() const;
+};
+
+
+#endif // HGAMELIBRARYDIALOG_H
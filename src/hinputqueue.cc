@@ -0,0 +1,117 @@
+/* Copyright 2015 Nikos Chantziaras
+ *
+ * This file is part of Hugor.
+ *
+ * Hugor is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Hugor is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Hugor.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Additional permission under GNU GPL version 3 section 7
+ *
+ * If you modify this Program, or any covered work, by linking or combining it
+ * with the Hugo Engine (or a modified version of the Hugo Engine), containing
+ * parts covered by the terms of the Hugo License, the licensors of this
+ * Program grant you additional permission to convey the resulting work.
+ * Corresponding Source for a non-source form of such a combination shall
+ * include the source code for the parts of the Hugo Engine used as well as
+ * that of the covered work.
+ */
+#include "hinputqueue.h"
+
+
+HInputQueue::HInputQueue()
+    : fPushPos(0),
+      fPopPos(0),
+      fWaiters(0)
+{
+    for (size_t i = 0; i < SIZE; ++i) {
+        fSlots[i].seq.store(i, std::memory_order_relaxed);
+    }
+}
+
+
+bool
+HInputQueue::push( const HInputEvent& ev )
+{
+    size_t pos = fPushPos.load(std::memory_order_relaxed);
+    Slot* slot;
+    for (;;) {
+        slot = &fSlots[pos % SIZE];
+        const size_t seq = slot->seq.load(std::memory_order_acquire);
+        const std::ptrdiff_t diff = std::ptrdiff_t(seq) - std::ptrdiff_t(pos);
+        if (diff == 0) {
+            // The slot is free. Claim it, unless another producer beat us to
+            // it.
+            if (fPushPos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // The consumer hasn't emptied this slot yet; we're full.
+            return false;
+        } else {
+            pos = fPushPos.load(std::memory_order_relaxed);
+        }
+    }
+    slot->ev = ev;
+    slot->seq.store(pos + 1, std::memory_order_release);
+    notify();
+    return true;
+}
+
+
+bool
+HInputQueue::pop( HInputEvent* ev )
+{
+    const size_t pos = fPopPos.load(std::memory_order_relaxed);
+    Slot& slot = fSlots[pos % SIZE];
+    if (slot.seq.load(std::memory_order_acquire) != pos + 1) {
+        return false;
+    }
+    *ev = slot.ev;
+    // Hand the slot back to the producers for the next time around.
+    slot.seq.store(pos + SIZE, std::memory_order_release);
+    fPopPos.store(pos + 1, std::memory_order_relaxed);
+    return true;
+}
+
+
+bool
+HInputQueue::peek( HInputEvent* ev ) const
+{
+    const size_t pos = fPopPos.load(std::memory_order_relaxed);
+    const Slot& slot = fSlots[pos % SIZE];
+    if (slot.seq.load(std::memory_order_acquire) != pos + 1) {
+        return false;
+    }
+    *ev = slot.ev;
+    return true;
+}
+
+
+bool
+HInputQueue::isEmpty() const
+{
+    const size_t pos = fPopPos.load(std::memory_order_relaxed);
+    return fSlots[pos % SIZE].seq.load(std::memory_order_acquire) != pos + 1;
+}
+
+
+void
+HInputQueue::notify()
+{
+    // Pairs with the increment of fWaiters in wait(): either the consumer sees
+    // our change when it checks its condition, or we see it waiting.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (fWaiters.load() > 0) {
+        fWakeup.release();
+    }
+}
@@ -0,0 +1,130 @@
+/* Copyright 2015 Nikos Chantziaras
+ *
+ * This file is part of Hugor.
+ *
+ * Hugor is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Hugor is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Hugor.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Additional permission under GNU GPL version 3 section 7
+ *
+ * If you modify this Program, or any covered work, by linking or combining it
+ * with the Hugo Engine (or a modified version of the Hugo Engine), containing
+ * parts covered by the terms of the Hugo License, the licensors of this
+ * Program grant you additional permission to convey the resulting work.
+ * Corresponding Source for a non-source form of such a combination shall
+ * include the source code for the parts of the Hugo Engine used as well as
+ * that of the covered work.
+ */
+#ifndef HINPUTQUEUE_H
+#define HINPUTQUEUE_H
+
+#include <QPoint>
+#include <QSemaphore>
+#include <atomic>
+#include <cstddef>
+
+
+// An input event, as produced by the GUI thread.
+struct HInputEvent {
+    enum Type {
+        // A keypress. 'key' is the Hugo key code.
+        Key,
+
+        // A mouse click at 'pos'.
+        Click,
+
+        // The game screen was resized.
+        Resize
+    };
+
+    Type type;
+    int key;
+    QPoint pos;
+
+    // Time the event was queued, as returned by
+    // QElapsedTimer::msecsSinceReference().
+    qint64 timestamp;
+};
+
+
+// A bounded, lock-free queue of input events with any number of producers
+// and a single consumer.
+//
+// The consumer (normally the engine thread) can block until an event arrives
+// or some other condition becomes true. Producers only pay for a wakeup when
+// the consumer is actually blocked.
+class HInputQueue {
+  private:
+    enum { SIZE = 256 };
+
+    // Every slot carries a sequence number that says whose turn it is. A
+    // slot at position 'pos' is free for a producer when its sequence is
+    // 'pos', and holds an event for the consumer when it's 'pos + 1'.
+    struct Slot {
+        std::atomic<size_t> seq;
+        HInputEvent ev;
+    };
+    Slot fSlots[SIZE];
+
+    std::atomic<size_t> fPushPos;
+    std::atomic<size_t> fPopPos;
+
+    // Number of consumers currently blocked, and where they block.
+    std::atomic<int> fWaiters;
+    QSemaphore fWakeup;
+
+  public:
+    HInputQueue();
+
+    // Adds an event to the queue and wakes the consumer. Can be called from
+    // any thread. Returns false (and drops the event) if the queue is full.
+    bool
+    push( const HInputEvent& ev );
+
+    // The functions below may only be called by the consumer.
+
+    // Removes the oldest event from the queue and stores it in 'ev'. Returns
+    // false if the queue is empty.
+    bool
+    pop( HInputEvent* ev );
+
+    // Like pop(), but leaves the event in the queue.
+    bool
+    peek( HInputEvent* ev ) const;
+
+    bool
+    isEmpty() const;
+
+    // Blocks until 'done' returns true. 'done' is evaluated again each time
+    // an event is pushed or notify() is called.
+    template <typename Pred>
+    void
+    wait( Pred done )
+    {
+        while (not done()) {
+            fWaiters.fetch_add(1);
+            if (not done()) {
+                fWakeup.acquire();
+            }
+            fWaiters.fetch_sub(1);
+        }
+    }
+
+    // Wakes up the consumer if it's blocked in wait(). Can be called from any
+    // thread, after changing whatever the consumer is waiting for.
+    void
+    notify();
+};
+
+
+#endif
@@ -36,6 +36,8 @@
 #include <QLabel>
 #include <QWindowStateChangeEvent>
 #include <QErrorMessage>
+#include <QDir>
+#include <QStandardPaths>
 
 #include "hmainwindow.h"
 #include "happlication.h"
@@ -46,6 +48,7 @@
 #include "aboutdialog.h"
 #include "settings.h"
 #include "hugodefs.h"
+#include "htracer.h"
 extern "C" {
 #include "heheader.h"
 }
@@ -73,6 +76,29 @@ HMainWindow::HMainWindow( QWidget* parent )
     QMenu* menu;
     QAction* act;
 
+    // "Game" menu.
+    menu = menuBar->addMenu(tr("&Game"));
+    act = new QAction(tr("Quick &Save"), this);
+    act->setShortcut(QKeySequence("F5"));
+    menu->addAction(act);
+    this->addAction(act);
+    connect(act, SIGNAL(triggered()), SLOT(fQuickSave()));
+
+    act = new QAction(tr("Quick &Load"), this);
+    act->setShortcut(QKeySequence("F9"));
+    menu->addAction(act);
+    this->addAction(act);
+    connect(act, SIGNAL(triggered()), SLOT(fQuickLoad()));
+
+    menu->addSeparator();
+    act = new QAction(tr("&Trace Capture"), this);
+    act->setCheckable(true);
+    act->setChecked(HTracer::isCapturing());
+    act->setShortcut(QKeySequence("Ctrl+Shift+T"));
+    menu->addAction(act);
+    this->addAction(act);
+    connect(act, SIGNAL(toggled(bool)), SLOT(fToggleTraceCapture(bool)));
+
     // "Edit" menu.
     menu = menuBar->addMenu(tr("&Edit"));
     act = new QAction(tr("&Preferences..."), this);
@@ -164,7 +190,7 @@ HMainWindow::fFullscreenAdjust()
 #endif
     }
     hApp->updateMargins(-1);
-    hFrame->updateGameScreen(true);
+    hFrame->publishFrame(true);
 }
 
 
@@ -220,6 +246,45 @@ HMainWindow::fHideAbout()
 }
 
 
+void
+HMainWindow::fQuickSave()
+{
+    hFrame->requestCheckpoint(HFrame::QuickSaveRequest);
+}
+
+
+void
+HMainWindow::fQuickLoad()
+{
+    hFrame->requestCheckpoint(HFrame::QuickLoadRequest);
+}
+
+
+void
+HMainWindow::fToggleTraceCapture( bool on )
+{
+    if (on) {
+        HTracer::start();
+        return;
+    }
+    HTracer::stop();
+    // Write to the file named by HUGOR_TRACE if there is one, otherwise put it
+    // in the documents folder where the player can find it.
+    QString file = QString::fromLocal8Bit(qgetenv("HUGOR_TRACE"));
+    if (file.isEmpty()) {
+        file = QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation)
+               + QString::fromLatin1("/hugor-trace.json");
+    }
+    if (HTracer::dump(QDir::toNativeSeparators(file).toLocal8Bit().constData())) {
+        QMessageBox::information(this, tr("Trace Capture"),
+                                 tr("The trace was written to %1.").arg(QDir::toNativeSeparators(file)));
+    } else {
+        QMessageBox::warning(this, tr("Trace Capture"),
+                             tr("The trace could not be written to %1.").arg(QDir::toNativeSeparators(file)));
+    }
+}
+
+
 void
 HMainWindow::showScrollback()
 {
@@ -350,10 +415,7 @@ HMainWindow::closeEvent( QCloseEvent* e )
 #endif
 
     if (msgBox->exec() == QMessageBox::Yes) {
-        hApp->settings()->saveToDisk();
-        closeSoundEngine();
-        hApp->terminateEngineThread();
-        exit(0);
+        hApp->quitImmediately();
     } else {
         e->ignore();
     }
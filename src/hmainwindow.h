@@ -65,6 +65,15 @@ class HMainWindow: public QMainWindow {
     void
     fHideAbout();
 
+    void
+    fQuickSave();
+
+    void
+    fQuickLoad();
+
+    void
+    fToggleTraceCapture( bool on );
+
   protected:
     virtual void
     closeEvent( QCloseEvent* e );
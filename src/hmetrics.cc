@@ -0,0 +1,253 @@
+/* Copyright 2015 Nikos Chantziaras
+ *
+ * This file is part of Hugor.
+ *
+ * Hugor is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Hugor is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Hugor.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Additional permission under GNU GPL version 3 section 7
+ *
+ * If you modify this Program, or any covered work, by linking or combining it
+ * with the Hugo Engine (or a modified version of the Hugo Engine), containing
+ * parts covered by the terms of the Hugo License, the licensors of this
+ * Program grant you additional permission to convey the resulting work.
+ * Corresponding Source for a non-source form of such a combination shall
+ * include the source code for the parts of the Hugo Engine used as well as
+ * that of the covered work.
+ */
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "hmetrics.h"
+#include "version.h"
+
+// Interval used when asked for none.
+static const int DEFAULT_EXPORT_INTERVAL = 60;
+
+const int HHistogram::BUCKET_COUNT;
+
+
+HHistogram::HHistogram()
+    : fCount(0),
+      fSum(0),
+      fMax(0)
+{
+    for (auto& bucket : fBuckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+
+void
+HHistogram::record( std::chrono::steady_clock::duration d )
+{
+    const auto us = std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+    const std::uint64_t v = us > 0 ? us : 0;
+    int bucket = 0;
+    while (bucket < BUCKET_COUNT - 1 and (std::uint64_t(1) << bucket) <= v) {
+        ++bucket;
+    }
+    fBuckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    fCount.fetch_add(1, std::memory_order_relaxed);
+    fSum.fetch_add(v, std::memory_order_relaxed);
+    std::uint64_t max = fMax.load(std::memory_order_relaxed);
+    while (v > max and not fMax.compare_exchange_weak(max, v, std::memory_order_relaxed)) {
+    }
+}
+
+
+HHistogram::Summary
+HHistogram::summary() const
+{
+    Summary s;
+    std::uint64_t buckets[BUCKET_COUNT];
+    s.count = 0;
+    for (int i = 0; i < BUCKET_COUNT; ++i) {
+        buckets[i] = fBuckets[i].load(std::memory_order_relaxed);
+        s.count += buckets[i];
+    }
+    s.sum = fSum.load(std::memory_order_relaxed);
+    s.max = fMax.load(std::memory_order_relaxed);
+
+    // The upper bound of the bucket the percentile falls in, but no more than
+    // the largest duration seen.
+    auto percentile = [&](unsigned pct) -> std::uint64_t {
+        if (s.count == 0) {
+            return 0;
+        }
+        const std::uint64_t rank = (s.count * pct + 99) / 100;
+        std::uint64_t seen = 0;
+        for (int i = 0; i < BUCKET_COUNT; ++i) {
+            seen += buckets[i];
+            if (seen >= rank) {
+                return std::min(std::uint64_t(1) << i, s.max);
+            }
+        }
+        return s.max;
+    };
+    s.p50 = percentile(50);
+    s.p90 = percentile(90);
+    s.p99 = percentile(99);
+    return s;
+}
+
+
+namespace {
+
+struct Registry {
+    std::mutex mutex;
+    // Ordered by name, so that the export is too.
+    std::map<std::string, std::unique_ptr<HCounter>> counters;
+    std::map<std::string, std::unique_ptr<HGauge>> gauges;
+    std::map<std::string, std::unique_ptr<HHistogram>> histograms;
+};
+
+struct Exporter {
+    std::FILE* file = nullptr;
+    std::chrono::seconds interval;
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable stopCond;
+    bool stop = false;
+
+    // Also runs when the program calls exit() without stopExport(). The last
+    // snapshot still gets written, and we don't destroy a running thread.
+    ~Exporter()
+    {
+        if (thread.joinable()) {
+            {
+                std::lock_guard<std::mutex> locker(mutex);
+                stop = true;
+            }
+            stopCond.notify_one();
+            thread.join();
+        }
+        if (file != nullptr) {
+            std::fclose(file);
+        }
+    }
+};
+
+}
+
+// Never destroyed; metrics can still be updated from threads that outlive
+// main().
+static Registry& registry = *new Registry;
+static std::unique_ptr<Exporter> exporter;
+
+
+template <typename T>
+static T&
+findOrCreate( std::map<std::string, std::unique_ptr<T>>& map, const std::string& name )
+{
+    std::lock_guard<std::mutex> locker(registry.mutex);
+    std::unique_ptr<T>& metric = map[name];
+    if (not metric) {
+        metric.reset(new T);
+    }
+    return *metric;
+}
+
+
+HCounter&
+HMetrics::counter( const std::string& name )
+{
+    return findOrCreate(registry.counters, name);
+}
+
+
+HGauge&
+HMetrics::gauge( const std::string& name )
+{
+    return findOrCreate(registry.gauges, name);
+}
+
+
+HHistogram&
+HMetrics::histogram( const std::string& name )
+{
+    return findOrCreate(registry.histograms, name);
+}
+
+
+static void
+writeMetrics( std::FILE* out )
+{
+    const long long now = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    std::lock_guard<std::mutex> locker(registry.mutex);
+    for (const auto& i : registry.counters) {
+        std::fprintf(out, "%lld counter %s %llu\n", now, i.first.c_str(),
+                     static_cast<unsigned long long>(i.second->value()));
+    }
+    for (const auto& i : registry.gauges) {
+        std::fprintf(out, "%lld gauge %s %lld\n", now, i.first.c_str(),
+                     static_cast<long long>(i.second->value()));
+    }
+    for (const auto& i : registry.histograms) {
+        const HHistogram::Summary s = i.second->summary();
+        std::fprintf(out, "%lld histogram %s count=%llu sum=%llu p50=%llu p90=%llu p99=%llu max=%llu\n",
+                     now, i.first.c_str(), static_cast<unsigned long long>(s.count),
+                     static_cast<unsigned long long>(s.sum),
+                     static_cast<unsigned long long>(s.p50),
+                     static_cast<unsigned long long>(s.p90),
+                     static_cast<unsigned long long>(s.p99),
+                     static_cast<unsigned long long>(s.max));
+    }
+    std::fflush(out);
+}
+
+
+// Exports until told to stop. Runs on a thread of its own.
+static void
+runExporter( Exporter* data )
+{
+    std::unique_lock<std::mutex> locker(data->mutex);
+    while (not data->stopCond.wait_for(locker, data->interval, [data]{ return data->stop; })) {
+        writeMetrics(data->file);
+    }
+    writeMetrics(data->file);
+}
+
+
+bool
+HMetrics::startExport( const std::string& file, int intervalSeconds )
+{
+    stopExport();
+    std::FILE* out = std::fopen(file.c_str(), "a");
+    if (out == nullptr) {
+        return false;
+    }
+    // Lets the dashboards tell runs and versions apart.
+    const long long now = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    std::fprintf(out, "%lld start hugor %s\n", now, HUGOR_VERSION);
+    exporter.reset(new Exporter);
+    exporter->file = out;
+    exporter->interval = std::chrono::seconds(intervalSeconds > 0 ? intervalSeconds
+                                                                  : DEFAULT_EXPORT_INTERVAL);
+    exporter->thread = std::thread(runExporter, exporter.get());
+    return true;
+}
+
+
+void
+HMetrics::stopExport()
+{
+    exporter.reset();
+}
@@ -0,0 +1,175 @@
+/* Copyright 2015 Nikos Chantziaras
+ *
+ * This file is part of Hugor.
+ *
+ * Hugor is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Hugor is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Hugor.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Additional permission under GNU GPL version 3 section 7
+ *
+ * If you modify this Program, or any covered work, by linking or combining it
+ * with the Hugo Engine (or a modified version of the Hugo Engine), containing
+ * parts covered by the terms of the Hugo License, the licensors of this
+ * Program grant you additional permission to convey the resulting work.
+ * Corresponding Source for a non-source form of such a combination shall
+ * include the source code for the parts of the Hugo Engine used as well as
+ * that of the covered work.
+ */
+#ifndef HMETRICS_H
+#define HMETRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+
+// Counts something that only goes up, like bytes read.
+class HCounter {
+  public:
+    HCounter()
+        : fValue(0)
+    { }
+
+    void
+    add( std::uint64_t n = 1 )
+    { fValue.fetch_add(n, std::memory_order_relaxed); }
+
+    std::uint64_t
+    value() const
+    { return fValue.load(std::memory_order_relaxed); }
+
+  private:
+    std::atomic<std::uint64_t> fValue;
+};
+
+
+// Holds the latest value of something, like the number of text buffer cells
+// in use.
+class HGauge {
+  public:
+    HGauge()
+        : fValue(0)
+    { }
+
+    void
+    set( std::int64_t v )
+    { fValue.store(v, std::memory_order_relaxed); }
+
+    std::int64_t
+    value() const
+    { return fValue.load(std::memory_order_relaxed); }
+
+  private:
+    std::atomic<std::int64_t> fValue;
+};
+
+
+// Distribution of durations, in microseconds. Bucket n counts the durations
+// below 2^n microseconds that didn't fit in bucket n-1, so percentiles come
+// out rounded up to a power of two.
+class HHistogram {
+  public:
+    static const int BUCKET_COUNT = 40;
+
+    HHistogram();
+
+    void
+    record( std::chrono::steady_clock::duration d );
+
+    // Snapshot of the histogram. Only approximate while it's being recorded
+    // to from another thread.
+    struct Summary {
+        std::uint64_t count;
+        std::uint64_t sum;
+        std::uint64_t max;
+        std::uint64_t p50;
+        std::uint64_t p90;
+        std::uint64_t p99;
+    };
+
+    Summary
+    summary() const;
+
+  private:
+    std::atomic<std::uint64_t> fBuckets[BUCKET_COUNT];
+    std::atomic<std::uint64_t> fCount;
+    std::atomic<std::uint64_t> fSum;
+    std::atomic<std::uint64_t> fMax;
+};
+
+
+// Registry of the front end's runtime metrics. Metrics are created on first
+// use and live until the program ends, so call sites can keep references to
+// them:
+//
+//     static HCounter& bytesRead = HMetrics::counter("file.bytes_read");
+//     bytesRead.add(n);
+//
+// Updating a metric costs an atomic operation, whether or not the metrics are
+// being exported.
+//
+// When exporting, a thread of its own appends all metrics to a file every so
+// many seconds, one per line:
+//
+//     <milliseconds since the epoch> counter <name> <value>
+//     <milliseconds since the epoch> gauge <name> <value>
+//     <milliseconds since the epoch> histogram <name> count=<n> sum=<us>
+//         p50=<us> p90=<us> p99=<us> max=<us>
+//
+// (A histogram's line isn't broken.) Counters and histograms count from the
+// start of the program, so the difference between two exports is what
+// happened in between.
+class HMetrics {
+  public:
+    static HCounter&
+    counter( const std::string& name );
+
+    static HGauge&
+    gauge( const std::string& name );
+
+    static HHistogram&
+    histogram( const std::string& name );
+
+    // Starts appending the metrics to 'file' every 'intervalSeconds'. Returns
+    // false if the file can't be written.
+    static bool
+    startExport( const std::string& file, int intervalSeconds );
+
+    // Writes the metrics a last time and stops exporting.
+    static void
+    stopExport();
+};
+
+
+// Records the time from its construction to its destruction in a histogram.
+class HLatencyScope {
+  public:
+    explicit HLatencyScope( HHistogram& histogram )
+        : fHistogram(histogram),
+          fBegin(std::chrono::steady_clock::now())
+    { }
+
+    ~HLatencyScope()
+    { fHistogram.record(std::chrono::steady_clock::now() - fBegin); }
+
+    HLatencyScope( const HLatencyScope& ) = delete;
+    HLatencyScope& operator =( const HLatencyScope& ) = delete;
+
+  private:
+    HHistogram& fHistogram;
+    std::chrono::steady_clock::time_point fBegin;
+};
+
+
+#endif // HMETRICS_H
@@ -0,0 +1,541 @@
+/* Copyright 2015 Nikos Chantziaras
+ *
+ * This file is part of Hugor.
+ *
+ * Hugor is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Hugor is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Hugor.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Additional permission under GNU GPL version 3 section 7
+ *
+ * If you modify this Program, or any covered work, by linking or combining it
+ * with the Hugo Engine (or a modified version of the Hugo Engine), containing
+ * parts covered by the terms of the Hugo License, the licensors of this
+ * Program grant you additional permission to convey the resulting work.
+ * Corresponding Source for a non-source form of such a combination shall
+ * include the source code for the parts of the Hugo Engine used as well as
+ * that of the covered work.
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "hprofiler.h"
+
+extern "C" {
+#include "heheader.h"
+}
+
+using Clock = std::chrono::steady_clock;
+
+struct TokenStats {
+    unsigned long long count = 0;
+    Clock::duration time = Clock::duration::zero();
+};
+
+struct RoutineStats {
+    unsigned long long calls = 0;
+    Clock::duration inclusive = Clock::duration::zero();
+    Clock::duration exclusive = Clock::duration::zero();
+    // How many calls of this routine are on the stack. Only the outermost one
+    // adds to the inclusive time, so that recursion isn't counted twice.
+    int active = 0;
+};
+
+// A block of code RunRoutine() is running. Blocks that aren't routine calls
+// (like the body of a window statement) are kept only so that enter and leave
+// events stay balanced; their time belongs to the routine they're in.
+struct Frame {
+    long addr;
+    bool call;
+    Clock::time_point start;
+    Clock::duration children;
+};
+
+struct ProfileData {
+    std::string reportFile;
+    Clock::time_point started;
+    Clock::duration paused = Clock::duration::zero();
+    Clock::time_point pauseStart;
+    bool isPaused = false;
+
+    TokenStats tokens[TOKENS + 1];
+    // The token that's currently running, and since when. It's charged with
+    // the time until the next token starts.
+    int lastToken = -1;
+    Clock::time_point lastTokenStart;
+
+    std::unordered_map<long, RoutineStats> routines;
+    std::vector<Frame> stack;
+};
+
+// The blocks the engine is in, and the position of the statement it's running,
+// for the sampler. Blocks that aren't routine calls are NOT_A_CALL. The engine
+// thread is the only writer. It makes 'seq' odd while it changes the stack, so
+// that the sampler can tell when it read a stack that was being changed and
+// try again. 'position' is updated before every statement without that; it
+// can be a statement of the caller for a moment after a call or return.
+static const long NOT_A_CALL = -1;
+static const int MAX_CALL_DEPTH = 256;
+
+struct CallStack {
+    std::atomic<unsigned> seq{0};
+    std::atomic<int> depth{0};
+    std::atomic<long> addrs[MAX_CALL_DEPTH];
+    std::atomic<long> position{0};
+};
+
+struct SampleData {
+    std::string foldedFile;
+    int rate;
+    CallStack calls;
+    std::atomic<bool> waiting{false};
+
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable stopCond;
+    bool stop = false;
+
+    // Number of samples per call chain. The last element of a chain is where
+    // in its innermost routine the engine was.
+    std::map<std::vector<long>, unsigned long> samples;
+};
+
+HUGO_TLS char hugo_profiling = false;
+HUGO_TLS char hugo_tracecalls = false;
+HUGO_TLS char hugo_sampling = false;
+static HUGO_TLS ProfileData* profile = nullptr;
+static HUGO_TLS SampleData* sampler = nullptr;
+
+
+void
+hugo_profilestatement( long pos )
+{
+    sampler->calls.position.store(pos, std::memory_order_relaxed);
+}
+
+
+void
+hugo_profileenter( long addr, int call )
+{
+    if (sampler != nullptr) {
+        CallStack& cs = sampler->calls;
+        const int depth = cs.depth.load(std::memory_order_relaxed);
+        cs.seq.fetch_add(1, std::memory_order_acq_rel);
+        if (depth < MAX_CALL_DEPTH) {
+            cs.addrs[depth].store(call ? addr : NOT_A_CALL, std::memory_order_relaxed);
+        }
+        if (call) {
+            cs.position.store(addr, std::memory_order_relaxed);
+        }
+        cs.depth.store(depth + 1, std::memory_order_relaxed);
+        cs.seq.fetch_add(1, std::memory_order_release);
+    }
+    if (profile == nullptr) {
+        return;
+    }
+    profile->stack.push_back({addr, call != 0, Clock::now(), Clock::duration::zero()});
+    if (call) {
+        RoutineStats& stats = profile->routines[addr];
+        ++stats.calls;
+        ++stats.active;
+    }
+}
+
+
+void
+hugo_profileleave( long )
+{
+    if (sampler != nullptr and sampler->calls.depth.load(std::memory_order_relaxed) > 0) {
+        CallStack& cs = sampler->calls;
+        cs.seq.fetch_add(1, std::memory_order_acq_rel);
+        cs.depth.store(cs.depth.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+        cs.seq.fetch_add(1, std::memory_order_release);
+    }
+    // The profiler might have been started in the middle of a routine.
+    if (profile == nullptr or profile->stack.empty()) {
+        return;
+    }
+    const Frame frame = profile->stack.back();
+    profile->stack.pop_back();
+    if (not frame.call) {
+        return;
+    }
+    const Clock::duration time = Clock::now() - frame.start;
+    RoutineStats& stats = profile->routines[frame.addr];
+    if (--stats.active == 0) {
+        stats.inclusive += time;
+    }
+    stats.exclusive += time - frame.children;
+    for (auto it = profile->stack.rbegin(); it != profile->stack.rend(); ++it) {
+        if (it->call) {
+            it->children += time;
+            break;
+        }
+    }
+}
+
+
+void
+hugo_profiletoken( int t )
+{
+    const Clock::time_point now = Clock::now();
+    if (profile->lastToken >= 0) {
+        profile->tokens[profile->lastToken].time += now - profile->lastTokenStart;
+    }
+    if (t >= 0 and t <= TOKENS) {
+        ++profile->tokens[t].count;
+        profile->lastToken = t;
+    } else {
+        profile->lastToken = -1;
+    }
+    profile->lastTokenStart = now;
+}
+
+
+// Reads the routine names from the debugging information of a .hdx file. The
+// header points to it (see H_DEBUGDATA); it lists the names of objects,
+// properties, attributes, globals and aliases before the routines. Anything
+// that doesn't look right means we report addresses instead.
+static std::map<long, std::string>
+readRoutineNames( const char* path )
+{
+    std::map<long, std::string> names;
+    FILE* file = std::fopen(path, "rb");
+    if (file == nullptr) {
+        return names;
+    }
+    std::vector<unsigned char> data;
+    unsigned char buf[65536];
+    size_t len;
+    while ((len = std::fread(buf, 1, sizeof buf, file)) > 0) {
+        data.insert(data.end(), buf, buf + len);
+    }
+    std::fclose(file);
+
+    if (data.size() < H_DEBUGWORKSPACE or data[H_DEBUGGABLE] != 1) {
+        return names;
+    }
+    size_t pos = data[H_DEBUGDATA] | data[H_DEBUGDATA + 1] << 8 | data[H_DEBUGDATA + 2] << 16;
+    bool ok = true;
+
+    auto readWord = [&]() -> long {
+        if (pos + 2 > data.size()) {
+            ok = false;
+            return 0;
+        }
+        pos += 2;
+        return data[pos - 2] | data[pos - 1] << 8;
+    };
+    auto readName = [&]() -> std::string {
+        if (pos >= data.size() or pos + 1 + data[pos] > data.size() or data[pos] == 0) {
+            ok = false;
+            return std::string();
+        }
+        std::string name(reinterpret_cast<const char*>(&data[pos + 1]), data[pos]);
+        pos += 1 + data[pos];
+        for (char c : name) {
+            ok = ok and c > ' ' and c < 127;
+        }
+        return name;
+    };
+
+    // Objects, properties, attributes and globals.
+    for (int section = 0; ok and section < 4; ++section) {
+        for (long i = readWord(); ok and i > 0; --i) {
+            readName();
+        }
+    }
+    // Aliases, with the property or attribute each one stands for.
+    for (long i = readWord(); ok and i > 0; --i) {
+        readName();
+        readWord();
+    }
+    for (long i = readWord(); ok and i > 0; --i) {
+        const long addr = readWord() * address_scale;
+        const std::string name = readName();
+        ok = ok and addr > 0 and addr < static_cast<long>(data.size());
+        names[addr] = name;
+    }
+    if (not ok) {
+        names.clear();
+    }
+    return names;
+}
+
+
+// The debugging information is in the game itself if it's a .hdx, or in a
+// .hdx next to it.
+static std::map<long, std::string>
+routineNames()
+{
+    std::map<long, std::string> names = readRoutineNames(gamefile);
+    if (not names.empty()) {
+        return names;
+    }
+    std::string hdx(gamefile);
+    const size_t dot = hdx.find_last_of('.');
+    const size_t slash = hdx.find_last_of("/\\");
+    if (dot != std::string::npos and (slash == std::string::npos or dot > slash)) {
+        hdx.erase(dot);
+    }
+    hdx += ".hdx";
+    return readRoutineNames(hdx.c_str());
+}
+
+
+static double
+toMs( Clock::duration d )
+{
+    return std::chrono::duration<double, std::milli>(d).count();
+}
+
+
+static bool
+writeReport()
+{
+    hugo_profiletoken(-1);
+    const Clock::duration total = Clock::now() - profile->started - profile->paused;
+
+    FILE* out = std::fopen(profile->reportFile.c_str(), "w");
+    if (out == nullptr) {
+        return false;
+    }
+    std::fprintf(out, "Profile of %s\n", gamefile);
+    std::fprintf(out, "Running time: %.3f ms (not counting waits for input)\n\n", toMs(total));
+
+    std::vector<int> tokenOrder;
+    for (int t = 0; t <= TOKENS; ++t) {
+        if (profile->tokens[t].count > 0) {
+            tokenOrder.push_back(t);
+        }
+    }
+    std::sort(tokenOrder.begin(), tokenOrder.end(), [](int a, int b) {
+        return profile->tokens[a].time > profile->tokens[b].time;
+    });
+    std::fprintf(out, "Tokens, by exclusive time:\n");
+    std::fprintf(out, "%14s %12s %10s  %s\n", "count", "ms", "ns/each", "token");
+    for (int t : tokenOrder) {
+        const TokenStats& stats = profile->tokens[t];
+        std::fprintf(out, "%14llu %12.3f %10.0f  %s\n", stats.count, toMs(stats.time),
+                     toMs(stats.time) * 1e6 / stats.count, token[t]);
+    }
+
+    const std::map<long, std::string> names = routineNames();
+    std::vector<std::pair<long, RoutineStats>> routines(profile->routines.begin(),
+                                                        profile->routines.end());
+    std::sort(routines.begin(), routines.end(), [](const std::pair<long, RoutineStats>& a,
+                                                   const std::pair<long, RoutineStats>& b) {
+        return a.second.exclusive > b.second.exclusive;
+    });
+    std::fprintf(out, "\nRoutines, by exclusive time:\n");
+    std::fprintf(out, "%14s %12s %12s  %s\n", "calls", "incl. ms", "excl. ms", "routine");
+    for (const auto& routine : routines) {
+        const auto name = names.find(routine.first);
+        std::fprintf(out, "%14llu %12.3f %12.3f  ", routine.second.calls,
+                     toMs(routine.second.inclusive), toMs(routine.second.exclusive));
+        if (name != names.end()) {
+            std::fprintf(out, "%s\n", name->second.c_str());
+        } else {
+            std::fprintf(out, "$%06lX\n", routine.first);
+        }
+    }
+
+    return std::fclose(out) == 0;
+}
+
+
+// Takes samples until told to stop. Runs on a thread of its own.
+static void
+runSampler( SampleData* data )
+{
+    const auto interval = std::chrono::microseconds(1000000 / data->rate);
+    std::vector<long> chain;
+    std::unique_lock<std::mutex> locker(data->mutex);
+    while (not data->stopCond.wait_for(locker, interval, [data]{ return data->stop; })) {
+        if (data->waiting) {
+            continue;
+        }
+        // Copy the call stack. If the engine changed it while we were at it,
+        // try again; it's short.
+        CallStack& cs = data->calls;
+        bool ok = false;
+        for (int tries = 0; tries < 8 and not ok; ++tries) {
+            const unsigned seq = cs.seq.load(std::memory_order_acquire);
+            if (seq & 1) {
+                continue;
+            }
+            chain.clear();
+            const int depth = std::min(cs.depth.load(std::memory_order_relaxed),
+                                       MAX_CALL_DEPTH);
+            for (int i = 0; i < depth; ++i) {
+                const long addr = cs.addrs[i].load(std::memory_order_relaxed);
+                if (addr != NOT_A_CALL) {
+                    chain.push_back(addr);
+                }
+            }
+            chain.push_back(cs.position.load(std::memory_order_relaxed));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            ok = cs.seq.load(std::memory_order_relaxed) == seq;
+        }
+        if (ok) {
+            ++data->samples[chain];
+        }
+    }
+}
+
+
+// Writes the samples in the "folded stacks" format that flame graph tools read:
+// one line per call chain, the routines separated by ';', followed by the
+// number of samples. Below the innermost routine, there's a frame for the code
+// in it that was running, as the routine plus an offset.
+static bool
+writeSamples()
+{
+    FILE* out = std::fopen(sampler->foldedFile.c_str(), "w");
+    if (out == nullptr) {
+        return false;
+    }
+    const std::map<long, std::string> names = routineNames();
+    auto nameOf = [&names]( long addr ) {
+        const auto it = names.find(addr);
+        if (it != names.end()) {
+            return it->second;
+        }
+        char buf[16];
+        std::snprintf(buf, sizeof buf, "$%06lX", addr);
+        return std::string(buf);
+    };
+    for (const auto& sample : sampler->samples) {
+        const std::vector<long>& chain = sample.first;
+        const long pos = chain.back();
+        if (chain.size() == 1) {
+            std::fputs("<engine>", out);
+        }
+        for (size_t i = 0; i + 1 < chain.size(); ++i) {
+            std::fprintf(out, "%s%s", i > 0 ? ";" : "", nameOf(chain[i]).c_str());
+        }
+        // Right after a call or return, the position can still be in another
+        // routine. Those samples only count for the routine.
+        if (chain.size() > 1 and pos >= chain[chain.size() - 2]) {
+            std::fprintf(out, ";%s+%lX", nameOf(chain[chain.size() - 2]).c_str(),
+                         pos - chain[chain.size() - 2]);
+        }
+        std::fprintf(out, " %lu\n", sample.second);
+    }
+    return std::fclose(out) == 0;
+}
+
+
+void
+HProfiler::start( const std::string& reportFile )
+{
+    if (profile == nullptr) {
+        profile = new ProfileData;
+    }
+    profile->reportFile = reportFile;
+    profile->started = Clock::now();
+    hugo_profiling = true;
+    hugo_tracecalls = true;
+}
+
+
+void
+HProfiler::startSampling( const std::string& foldedFile, int rate )
+{
+    if (sampler != nullptr) {
+        return;
+    }
+    sampler = new SampleData;
+    sampler->foldedFile = foldedFile;
+    sampler->rate = std::max(1, std::min(rate, 100000));
+    hugo_tracecalls = true;
+    hugo_sampling = true;
+    sampler->thread = std::thread(runSampler, sampler);
+}
+
+
+bool
+HProfiler::isRunning()
+{
+    return profile != nullptr or sampler != nullptr;
+}
+
+
+void
+HProfiler::pause()
+{
+    if (sampler != nullptr) {
+        sampler->waiting = true;
+    }
+    if (profile == nullptr or profile->isPaused) {
+        return;
+    }
+    profile->isPaused = true;
+    profile->pauseStart = Clock::now();
+}
+
+
+void
+HProfiler::resume()
+{
+    if (sampler != nullptr) {
+        sampler->waiting = false;
+    }
+    if (profile == nullptr or not profile->isPaused) {
+        return;
+    }
+    // Move everything that's still running forward by the time we waited.
+    const Clock::duration waited = Clock::now() - profile->pauseStart;
+    profile->isPaused = false;
+    profile->paused += waited;
+    profile->lastTokenStart += waited;
+    for (Frame& frame : profile->stack) {
+        frame.start += waited;
+    }
+}
+
+
+bool
+HProfiler::finish()
+{
+    bool ok = true;
+    hugo_tracecalls = false;
+    hugo_sampling = false;
+    hugo_profiling = false;
+    if (profile != nullptr) {
+        resume();
+        ok = writeReport();
+        delete profile;
+        profile = nullptr;
+    }
+    if (sampler != nullptr) {
+        {
+            std::lock_guard<std::mutex> locker(sampler->mutex);
+            sampler->stop = true;
+        }
+        sampler->stopCond.notify_one();
+        sampler->thread.join();
+        ok = writeSamples() and ok;
+        delete sampler;
+        sampler = nullptr;
+    }
+    return ok;
+}
@@ -0,0 +1,82 @@
+/* Copyright 2015 Nikos Chantziaras
+ *
+ * This file is part of Hugor.
+ *
+ * Hugor is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Hugor is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Hugor.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Additional permission under GNU GPL version 3 section 7
+ *
+ * If you modify this Program, or any covered work, by linking or combining it
+ * with the Hugo Engine (or a modified version of the Hugo Engine), containing
+ * parts covered by the terms of the Hugo License, the licensors of this
+ * Program grant you additional permission to convey the resulting work.
+ * Corresponding Source for a non-source form of such a combination shall
+ * include the source code for the parts of the Hugo Engine used as well as
+ * that of the covered work.
+ */
+#ifndef HPROFILER_H
+#define HPROFILER_H
+
+#include <string>
+
+// Samples per second, unless told otherwise.
+const int DEFAULT_SAMPLE_RATE = 997;
+
+
+// Profiler for game code. Counts the tokens that RunRoutine() executes and the
+// time spent on each kind of token, and the calls and time of each routine,
+// both inclusive and exclusive of the routines it calls. Property routines
+// count as routines too.
+//
+// The profiler is always compiled in, but off until start() is called. While
+// it's off, the engine hooks cost a flag test each. The report lists routines
+// by name when the game was compiled with debugging information (a .hdx file,
+// either the game itself or one next to it), and by address otherwise.
+//
+// For profiling live sessions, there's also a sampling profiler. It only keeps
+// track of which routines the engine is in and where in them it is, and a
+// thread of its own looks at that a number of times per second. The samples
+// are written as folded stacks, which flame graph tools take as input.
+//
+// All of this applies to the game running on the calling thread.
+class HProfiler {
+  public:
+    // Starts profiling. The report is written to 'reportFile' by finish().
+    static void
+    start( const std::string& reportFile );
+
+    // Starts sampling 'rate' times per second. The samples are written to
+    // 'foldedFile' by finish(). Can run along with start().
+    static void
+    startSampling( const std::string& foldedFile, int rate );
+
+    static bool
+    isRunning();
+
+    // Time spent waiting for the player shouldn't count against the game. The
+    // front ends call these around waiting for input.
+    static void
+    pause();
+
+    static void
+    resume();
+
+    // Stops profiling and sampling and writes the report and samples. Returns
+    // false if they couldn't be written.
+    static bool
+    finish();
+};
+
+
+#endif // HPROFILER_H
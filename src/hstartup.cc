@@ -0,0 +1,89 @@
+/* Copyright 2015 Nikos Chantziaras
+ *
+ * This file is part of Hugor.
+ *
+ * Hugor is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Hugor is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Hugor.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Additional permission under GNU GPL version 3 section 7
+ *
+ * If you modify this Program, or any covered work, by linking or combining it
+ * with the Hugo Engine (or a modified version of the Hugo Engine), containing
+ * parts covered by the terms of the Hugo License, the licensors of this
+ * Program grant you additional permission to convey the resulting work.
+ * Corresponding Source for a non-source form of such a combination shall
+ * include the source code for the parts of the Hugo Engine used as well as
+ * that of the covered work.
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "hstartup.h"
+#include "hmetrics.h"
+#include "htracer.h"
+
+struct Phase {
+    const char* name;
+    HTracer::Clock::time_point begin;
+};
+
+static std::vector<Phase> phases;
+static bool finished = false;
+
+
+void
+HStartup::phase( const char* name )
+{
+    if (not finished) {
+        phases.push_back({ name, HTracer::Clock::now() });
+    }
+}
+
+
+void
+HStartup::finish()
+{
+    if (finished or phases.empty()) {
+        return;
+    }
+    finished = true;
+    const HTracer::Clock::time_point end = HTracer::Clock::now();
+    using Ms = std::chrono::duration<double, std::milli>;
+
+    if (HTracer::isCapturing()) {
+        for (size_t i = 0; i < phases.size(); ++i) {
+            HTracer::record(phases[i].name, "startup", phases[i].begin,
+                            i + 1 < phases.size() ? phases[i + 1].begin : end);
+        }
+    }
+    const double total = Ms(end - phases.front().begin).count();
+    HMetrics::gauge("startup.first_frame_ms").set(total);
+
+    const char* reportFile = std::getenv("HUGOR_STARTUP");
+    if (reportFile == nullptr or *reportFile == '\0') {
+        return;
+    }
+    FILE* out = std::fopen(reportFile, "w");
+    if (out == nullptr) {
+        std::fprintf(stderr, "Can't write the startup report to %s\n", reportFile);
+        return;
+    }
+    std::fprintf(out, "%-16s %10s\n", "phase", "ms");
+    for (size_t i = 0; i < phases.size(); ++i) {
+        const HTracer::Clock::time_point next = i + 1 < phases.size() ? phases[i + 1].begin : end;
+        std::fprintf(out, "%-16s %10.1f\n", phases[i].name, Ms(next - phases[i].begin).count());
+    }
+    std::fprintf(out, "%-16s %10.1f\n", "first frame", total);
+    std::fclose(out);
+}
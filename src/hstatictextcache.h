@@ -0,0 +1,63 @@
+/* Copyright 2015 Nikos Chantziaras
+ *
+ * This file is part of Hugor.
+ *
+ * Hugor is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Hugor is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Hugor.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Additional permission under GNU GPL version 3 section 7
+ *
+ * If you modify this Program, or any covered work, by linking or combining it
+ * with the Hugo Engine (or a modified version of the Hugo Engine), containing
+ * parts covered by the terms of the Hugo License, the licensors of this
+ * Program grant you additional permission to convey the resulting work.
+ * Corresponding Source for a non-source form of such a combination shall
+ * include the source code for the parts of the Hugo Engine used as well as
+ * that of the covered work.
+ */
+#ifndef HSTATICTEXTCACHE_H
+#define HSTATICTEXTCACHE_H
+
+#include <QCache>
+#include <QPair>
+#include <QString>
+#include <QFont>
+#include <QStaticText>
+
+
+// A bounded cache of pre-shaped text, keyed by string and font. Strings that
+// are printed over and over again (prompts, status line labels, room names)
+// are then laid out only once.
+//
+// A QStaticText gets modified when it's drawn with a different transform or
+// font than the one it was prepared with, so instances of this class must not
+// be shared between threads.
+class HStaticTextCache {
+  private:
+    // Least recently used entries are evicted first.
+    QCache<QPair<QString, QFont>, QStaticText> fCache;
+
+  public:
+    HStaticTextCache( int maxEntries = 512 );
+
+    // Returns the pre-shaped text for 'str' drawn with 'font'. Painters that
+    // draw it should have 'font' set and no transformation other than a
+    // translation, or else it will be shaped again.
+    // Hits and misses are counted in the "textcache.hits" and
+    // "textcache.misses" metrics.
+    QStaticText
+    get( const QString& str, const QFont& font );
+};
+
+
+#endif
@@ -0,0 +1,184 @@
+/* Copyright 2015 Nikos Chantziaras
+ *
+ * This file is part of Hugor.
+ *
+ * Hugor is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Hugor is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Hugor.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Additional permission under GNU GPL version 3 section 7
+ *
+ * If you modify this Program, or any covered work, by linking or combining it
+ * with the Hugo Engine (or a modified version of the Hugo Engine), containing
+ * parts covered by the terms of the Hugo License, the licensors of this
+ * Program grant you additional permission to convey the resulting work.
+ * Corresponding Source for a non-source form of such a combination shall
+ * include the source code for the parts of the Hugo Engine used as well as
+ * that of the covered work.
+ */
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+#include "htracer.h"
+
+extern "C" {
+#include "heheader.h"
+}
+
+// How many events we keep.
+static const size_t RING_SIZE = 1 << 16;
+
+struct TraceEvent {
+    const char* name;
+    const char* category;
+    HTracer::Clock::time_point begin;
+    HTracer::Clock::time_point end;
+    int thread;
+};
+
+static std::atomic<bool> capturing(false);
+static std::mutex mutex;
+static std::vector<TraceEvent> ring;
+// Total number of events recorded since start(). The oldest ones have been
+// overwritten once this exceeds RING_SIZE.
+static size_t recorded = 0;
+static HTracer::Clock::time_point epoch;
+
+static std::atomic<int> threadCount(0);
+static thread_local int threadId = 0;
+static std::vector<std::pair<int, std::string>> threadNames;
+
+
+// Small, stable numbers for threads read better in trace viewers than the
+// native thread IDs.
+static int
+currentThread()
+{
+    if (threadId == 0) {
+        threadId = ++threadCount;
+    }
+    return threadId;
+}
+
+
+void
+HTracer::start()
+{
+    std::lock_guard<std::mutex> locker(mutex);
+    ring.assign(RING_SIZE, TraceEvent());
+    recorded = 0;
+    epoch = Clock::now();
+    capturing = true;
+}
+
+
+void
+HTracer::stop()
+{
+    capturing = false;
+}
+
+
+bool
+HTracer::isCapturing()
+{
+    return capturing.load(std::memory_order_relaxed);
+}
+
+
+void
+HTracer::setThreadName( const char* name )
+{
+    const int thread = currentThread();
+    std::lock_guard<std::mutex> locker(mutex);
+    threadNames.emplace_back(thread, name);
+}
+
+
+void
+HTracer::record( const char* name, const char* category, Clock::time_point begin,
+                 Clock::time_point end )
+{
+    const int thread = currentThread();
+    std::lock_guard<std::mutex> locker(mutex);
+    if (not capturing or ring.empty()) {
+        return;
+    }
+    ring[recorded++ % RING_SIZE] = {name, category, begin, end, thread};
+}
+
+
+static long long
+toMicroseconds( HTracer::Clock::duration d )
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+}
+
+
+bool
+HTracer::dump( const std::string& file )
+{
+    FILE* out = std::fopen(file.c_str(), "w");
+    if (out == nullptr) {
+        return false;
+    }
+    std::lock_guard<std::mutex> locker(mutex);
+    std::fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", out);
+    bool first = true;
+    for (const auto& thread : threadNames) {
+        std::fprintf(out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+                     "\"args\":{\"name\":\"%s\"}}", first ? "" : ",\n", thread.first,
+                     thread.second.c_str());
+        first = false;
+    }
+    const size_t count = std::min(recorded, RING_SIZE);
+    for (size_t i = recorded - count; i < recorded; ++i) {
+        const TraceEvent& ev = ring[i % RING_SIZE];
+        // Events that started before the capture did are clipped.
+        const long long ts = std::max(0LL, toMicroseconds(ev.begin - epoch));
+        const long long dur = toMicroseconds(ev.end - epoch) - ts;
+        std::fprintf(out, "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,"
+                     "\"tid\":%d,\"ts\":%lld,\"dur\":%lld}", first ? "" : ",\n", ev.name,
+                     ev.category, ev.thread, ts, dur);
+        first = false;
+    }
+    std::fputs("\n]}\n", out);
+    return std::fclose(out) == 0;
+}
+
+
+// Engine side. The engine marks spans in pairs; each thread keeps a stack of
+// their starting times.
+static thread_local std::vector<HTracer::Clock::time_point> engineSpans;
+
+void
+hugo_tracebegin( const char* )
+{
+    engineSpans.push_back(HTracer::Clock::now());
+}
+
+
+void
+hugo_traceend( const char* name )
+{
+    if (engineSpans.empty()) {
+        return;
+    }
+    const HTracer::Clock::time_point begin = engineSpans.back();
+    engineSpans.pop_back();
+    if (HTracer::isCapturing()) {
+        HTracer::record(name, "engine", begin, HTracer::Clock::now());
+    }
+}
@@ -0,0 +1,106 @@
+/* Copyright 2015 Nikos Chantziaras
+ *
+ * This file is part of Hugor.
+ *
+ * Hugor is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Hugor is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Hugor.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Additional permission under GNU GPL version 3 section 7
+ *
+ * If you modify this Program, or any covered work, by linking or combining it
+ * with the Hugo Engine (or a modified version of the Hugo Engine), containing
+ * parts covered by the terms of the Hugo License, the licensors of this
+ * Program grant you additional permission to convey the resulting work.
+ * Corresponding Source for a non-source form of such a combination shall
+ * include the source code for the parts of the Hugo Engine used as well as
+ * that of the covered work.
+ */
+#ifndef HTRACER_H
+#define HTRACER_H
+
+#include <chrono>
+#include <string>
+
+
+// Timeline of what the engine, the GUI and the media back-ends do, for
+// finding out where the time goes when the threads wait on each other. Code
+// marks spans of interest with HTraceScope; while capturing, each span is
+// recorded in a ring buffer that keeps the most recent events. dump() writes
+// them in the Chrome trace event format, which chrome://tracing and Perfetto
+// can show.
+//
+// Can be used from any thread. While not capturing, a span costs an atomic
+// load.
+class HTracer {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    // Starts capturing, dropping anything captured before.
+    static void
+    start();
+
+    static void
+    stop();
+
+    static bool
+    isCapturing();
+
+    // Names the calling thread in the trace.
+    static void
+    setThreadName( const char* name );
+
+    // Records a span. 'name' and 'category' must be string literals (or live
+    // as long as the program.)
+    static void
+    record( const char* name, const char* category, Clock::time_point begin,
+            Clock::time_point end );
+
+    // Writes what's in the ring buffer to 'file'. Returns false if it couldn't
+    // be written.
+    static bool
+    dump( const std::string& file );
+};
+
+
+// Records the span from its construction to its destruction.
+class HTraceScope {
+  public:
+    HTraceScope( const char* name, const char* category )
+        : fName(name),
+          fCategory(category),
+          fCapturing(HTracer::isCapturing())
+    {
+        if (fCapturing) {
+            fBegin = HTracer::Clock::now();
+        }
+    }
+
+    ~HTraceScope()
+    {
+        if (fCapturing) {
+            HTracer::record(fName, fCategory, fBegin, HTracer::Clock::now());
+        }
+    }
+
+    HTraceScope( const HTraceScope& ) = delete;
+    HTraceScope& operator =( const HTraceScope& ) = delete;
+
+  private:
+    const char* fName;
+    const char* fCategory;
+    bool fCapturing;
+    HTracer::Clock::time_point fBegin;
+};
+
+
+#endif // HTRACER_H
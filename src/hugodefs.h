@@ -29,10 +29,13 @@
 #define HUGODEFS_H
 
 #include <QColor>
+#include <QString>
 
 QColor hugoColorToQt( int color );
-void initSoundEngine();
-void initVideoEngine( int& argc, char* argv[] );
+// These return a message for the user if sound or video won't work. Can run in
+// any thread.
+QString initSoundEngine();
+QString initVideoEngine( int& argc, char* argv[] );
 void closeSoundEngine();
 void closeVideoEngine();
 void muteSound( bool mute );
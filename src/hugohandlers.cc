@@ -26,6 +26,7 @@
  * that of the covered work.
  */
 #include <QFileDialog>
+#include <QMessageBox>
 #include <QTextStream>
 #include <QTextLayout>
 #include <QTextCodec>
@@ -34,11 +35,14 @@
 #include <cstdio>
 
 #include "hugohandlers.h"
+#include "happlication.h"
 #include "hmainwindow.h"
+#include "hugodefs.h"
 #include "videoplayer.h"
 #include "hframe.h"
 #include "settings.h"
 #include "hugorfile.h"
+#include "htracer.h"
 
 
 HugoHandlers* hHandlers = 0;
@@ -48,7 +52,7 @@ void
 HugoHandlers::calcFontDimensions()
 {
     const QFontMetrics& curMetr = hFrame->currentFontMetrics();
-    const QFontMetrics fixedMetr(hApp->settings()->fixedFont);
+    const QFontMetrics fixedMetr(hFrame->fixedFont());
 
     FIXEDCHARWIDTH = fixedMetr.averageCharWidth();
     FIXEDLINEHEIGHT = fixedMetr.height();
@@ -145,8 +149,8 @@ void
 HugoHandlers::settextmode()
 {
     calcFontDimensions();
-    SCREENWIDTH = hFrame->width();
-    SCREENHEIGHT = hFrame->height();
+    SCREENWIDTH = hFrame->screenSize().width();
+    SCREENHEIGHT = hFrame->screenSize().height();
 
     /* Must be set: */
     settextwindow(1, 1, SCREENWIDTH / FIXEDCHARWIDTH, SCREENHEIGHT / FIXEDLINEHEIGHT);
@@ -167,9 +171,9 @@ HugoHandlers::settextwindow(int left, int top, int right, int bottom)
     // otherwise be clipped to a multiple of charwidth, leaving a
     // sliver of the former window at the righthand side.
     if (right >= SCREENWIDTH / FIXEDCHARWIDTH)
-        physical_windowright = hFrame->width() - 1;
+        physical_windowright = SCREENWIDTH - 1;
     if (bottom >= SCREENHEIGHT / FIXEDLINEHEIGHT)
-        physical_windowbottom = hFrame->height() - 1;
+        physical_windowbottom = SCREENHEIGHT - 1;
 
     physical_windowwidth = physical_windowright - physical_windowleft + 1;
     physical_windowheight = physical_windowbottom - physical_windowtop + 1;
@@ -186,6 +190,24 @@ HugoHandlers::printFatalError(char* a)
     print(a);
 }
 
+
+void
+HugoHandlers::reportRunawayGame(long addr, int seconds)
+{
+    QMessageBox msgBox(QMessageBox::Warning, hApp->applicationName(),
+                       tr("The story has been busy for %1 seconds without waiting for input. "
+                          "It might be stuck.").arg(seconds),
+                       QMessageBox::Abort | QMessageBox::Ignore, hMainWin);
+    msgBox.setDefaultButton(QMessageBox::Ignore);
+    msgBox.setInformativeText(tr("Abort quits the application; any unsaved progress in the story "
+                                 "will be lost. Ignore keeps waiting."));
+    msgBox.setDetailedText(tr("Running the code block at $%1, code position $%2.")
+                           .arg(addr, 0, 16).arg(codeptr, 0, 16));
+    if (msgBox.exec() == QMessageBox::Abort) {
+        hApp->quitImmediately();
+    }
+}
+
 void
 HugoHandlers::print(char* a)
 {
@@ -289,7 +311,10 @@ HugoHandlers::displaypicture(HUGO_FILE infile, long len, int* result)
     // FIXME: Allow only JPEG images. By default, QImage supports
     // all image formats recognized by Qt.
     QImage img;
-    img.loadFromData(data);
+    {
+        HTraceScope trace("image decode", "media");
+        img.loadFromData(data);
+    }
 
     // Done with the file.
     file.close();
@@ -339,6 +364,7 @@ HugoHandlers::stopvideo()
 void
 HugoHandlers::playvideo(HUGO_FILE infile, long len, char loop, char bg, int vol, int* result)
 {
+    hApp->initMediaEngines(HApplication::VideoEngine);
     if (not hApp->settings()->enableVideo or hApp->settings()->videoSysError) {
         *result = false;
         return;
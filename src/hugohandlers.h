@@ -42,6 +42,10 @@ extern class HugoHandlers* hHandlers;
  * The hugo engine runs in a separate thread, so the heqt.cc callbacks will
  * delegate some work to us in order to ensure it runs in the main thrad (like
  * GUI operations.)
+ *
+ * The text and image rendering handlers (print, font, colors, clearing and
+ * displaypicture) only touch HFrame's back buffer and are called directly
+ * from the engine thread.
  */
 class HugoHandlers: public QObject {
     Q_OBJECT
@@ -63,6 +67,10 @@ class HugoHandlers: public QObject {
     void settextmode();
     void settextwindow(int left, int top, int right, int bottom);
     void printFatalError(char* a);
+
+    // The game ran for 'seconds' without asking for input and is currently
+    // running the code block at 'addr'. Asks the player whether to stop it.
+    void reportRunawayGame(long addr, int seconds);
     void print(char* a);
     void font(int f);
     void settextcolor(int c);
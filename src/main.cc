@@ -40,6 +40,9 @@ extern "C" {
 #include "version.h"
 #include "happlication.h"
 #include "settings.h"
+#include "hmetrics.h"
+#include "hstartup.h"
+#include "htracer.h"
 
 
 // On some platforms, SDL redefines main in order to provide a
@@ -56,11 +59,26 @@ extern "C" {
 
 int main( int argc, char* argv[] )
 {
-    initSoundEngine();
-#ifndef DISABLE_VIDEO
-    initVideoEngine(argc, argv);
-#endif
-
+    HStartup::phase("main");
+    // Capture a trace from the start if HUGOR_TRACE names a file to write it
+    // to on exit.
+    const QByteArray traceFile = qgetenv("HUGOR_TRACE");
+    HTracer::setThreadName("gui");
+    if (not traceFile.isEmpty()) {
+        HTracer::start();
+    }
+    // Export metrics if HUGOR_METRICS names a file to append them to, every
+    // HUGOR_METRICS_INTERVAL seconds.
+    const QByteArray metricsFile = qgetenv("HUGOR_METRICS");
+    if (not metricsFile.isEmpty()
+        and not HMetrics::startExport(metricsFile.constData(),
+                                      qgetenv("HUGOR_METRICS_INTERVAL").toInt()))
+    {
+        qWarning("Can't write metrics to %s", metricsFile.constData());
+    }
+    // The sound and video engines aren't initialized here. HApplication starts
+    // them in the background once a game needs them.
+    HStartup::phase("application");
     HApplication* app = new HApplication(argc, argv, "Hugor", HUGOR_VERSION,
                                          "Nikos Chantziaras", "");
 
@@ -91,6 +109,7 @@ int main( int argc, char* argv[] )
     }
 
     int ret = 0;
+    HStartup::phase("event loop");
 #if QT_VERSION < QT_VERSION_CHECK(5, 4, 0)
     QMetaObject::invokeMethod(app, "entryPoint", Qt::QueuedConnection, Q_ARG(QString, gameFileName));
 #else
@@ -102,5 +121,6 @@ int main( int argc, char* argv[] )
     closeVideoEngine();
 #endif
     closeSoundEngine();
+    HApplication::writeExitReports();
     return ret;
 }
@@ -0,0 +1,134 @@
+/* Copyright 2015 Nikos Chantziaras
+ *
+ * This file is part of Hugor.
+ *
+ * Hugor is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Hugor is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Hugor.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Additional permission under GNU GPL version 3 section 7
+ *
+ * If you modify this Program, or any covered work, by linking or combining it
+ * with the Hugo Engine (or a modified version of the Hugo Engine), containing
+ * parts covered by the terms of the Hugo License, the licensors of this
+ * Program grant you additional permission to convey the resulting work.
+ * Corresponding Source for a non-source form of such a combination shall
+ * include the source code for the parts of the Hugo Engine used as well as
+ * that of the covered work.
+ */
+// Entry point of the game generator (hugor-mkgame). Writes a synthetic game of
+// a given size, and optionally a file with commands to play it with, for
+// benchmarking and profiling the interpreter without real games.
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "hgamebuilder.h"
+
+
+static void
+usage( const char* argv0 )
+{
+    std::fprintf(stderr,
+        "Usage: %s [options] gamefile\n"
+        "\n"
+        "Options:\n"
+        "      --objects N      Objects (default 600.)\n"
+        "      --properties N   Properties of each object (default 12.)\n"
+        "      --words N        Dictionary words (default 3000.)\n"
+        "      --depth N        How deep \"recurse\" nests routine calls, up to\n"
+        "                       %d (default 32.)\n"
+        "      --terms N        Terms of the expression \"compute\" evaluates, up\n"
+        "                       to %d (default 48.)\n"
+        "      --events N       Events that run every turn (default 16.)\n"
+        "  -c, --commands FILE  Write commands that play the game to FILE.\n"
+        "  -n, --turns N        Turns the commands play (default 100.)\n",
+        argv0, HGameBuilder::MAX_CALL_DEPTH, HGameBuilder::MAX_EXPRESSION_TERMS);
+}
+
+
+int
+main( int argc, char* argv[] )
+{
+    HSyntheticGameSpec spec = { 600, 12, 3000, 32, 48, 16 };
+    const char* gameFile = nullptr;
+    const char* commandFile = nullptr;
+    int turns = 100;
+
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (not std::strcmp(arg, "--objects") and hasValue) {
+            spec.objects = std::atoi(argv[++i]);
+        } else if (not std::strcmp(arg, "--properties") and hasValue) {
+            spec.propertiesPerObject = std::atoi(argv[++i]);
+        } else if (not std::strcmp(arg, "--words") and hasValue) {
+            spec.dictionaryWords = std::atoi(argv[++i]);
+        } else if (not std::strcmp(arg, "--depth") and hasValue) {
+            spec.callDepth = std::atoi(argv[++i]);
+        } else if (not std::strcmp(arg, "--terms") and hasValue) {
+            spec.expressionTerms = std::atoi(argv[++i]);
+        } else if (not std::strcmp(arg, "--events") and hasValue) {
+            spec.events = std::atoi(argv[++i]);
+        } else if ((not std::strcmp(arg, "-c") or not std::strcmp(arg, "--commands")) and hasValue) {
+            commandFile = argv[++i];
+        } else if ((not std::strcmp(arg, "-n") or not std::strcmp(arg, "--turns")) and hasValue) {
+            turns = std::atoi(argv[++i]);
+        } else if (arg[0] != '-' and not gameFile) {
+            gameFile = arg;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (not gameFile or spec.objects < 1 or spec.propertiesPerObject < 0
+        or spec.dictionaryWords < 1 or spec.expressionTerms < 1 or spec.events < 0 or turns < 0)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    HSyntheticGame game;
+    std::string error;
+    if (not makeSyntheticGame(spec, game, error)) {
+        std::fprintf(stderr, "Can't make the game: %s\n", error.c_str());
+        return 1;
+    }
+
+    FILE* file = std::fopen(gameFile, "wb");
+    if (not file or std::fwrite(game.image.data(), 1, game.image.size(), file) != game.image.size()
+        or std::fclose(file) != 0)
+    {
+        std::fprintf(stderr, "Can't write game file: %s\n", gameFile);
+        return 1;
+    }
+
+    if (commandFile) {
+        // Mostly waiting, like most turns of real games are, with a call chain
+        // and an expression now and then.
+        file = std::fopen(commandFile, "w");
+        if (not file) {
+            std::fprintf(stderr, "Can't write command file: %s\n", commandFile);
+            return 1;
+        }
+        for (int t = 0; t < turns; ++t) {
+            std::fputs(t % 4 == 1 ? "recurse\n" : t % 4 == 3 ? "compute\n" : "wait\n", file);
+        }
+        std::fputs("quit\n", file);
+        if (std::fclose(file) != 0) {
+            std::fprintf(stderr, "Can't write command file: %s\n", commandFile);
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,408 @@
+/* Copyright 2015 Nikos Chantziaras
+ *
+ * This file is part of Hugor.
+ *
+ * Hugor is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Hugor is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * Hugor.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Additional permission under GNU GPL version 3 section 7
+ *
+ * If you modify this Program, or any covered work, by linking or combining it
+ * with the Hugo Engine (or a modified version of the Hugo Engine), containing
+ * parts covered by the terms of the Hugo License, the licensors of this
+ * Program grant you additional permission to convey the resulting work.
+ * Corresponding Source for a non-source form of such a combination shall
+ * include the source code for the parts of the Hugo Engine used as well as
+ * that of the covered work.
+ */
+// Walkthrough regression runner (hugor-regress). Plays back many recorded
+// command files against a game in parallel, each in its own hugor-headless
+// process or, with --in-process, on its own thread of this process, and
+// compares the per-turn transcript hashes against a stored baseline.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/wait.h>
+#endif
+
+#include "heheadless.h"
+
+
+struct Options {
+    std::string headless;
+    std::string baselineDir = "baseline";
+    std::string outputDir = ".";
+    std::string gameFile;
+    std::vector<std::string> recFiles;
+    unsigned jobs = std::max(1u, std::thread::hardware_concurrency());
+    bool updateBaseline = false;
+    bool inProcess = false;
+    bool allowMissing = false;
+    int timeout = 0;
+};
+
+struct Result {
+    enum Status {Ok, Diverged, NoBaseline, Updated, Failed};
+
+    Status status = Failed;
+    // Zero-based turn of the first difference, when diverged.
+    int divergedTurn = -1;
+    int turns = 0;
+    double seconds = 0;
+    // Why it failed, when it did.
+    std::string error;
+};
+
+static std::mutex reportMutex;
+
+
+static void
+usage( const char* argv0 )
+{
+    std::fprintf(stderr,
+        "Usage: %s [options] gamefile recfile...\n"
+        "\n"
+        "Options:\n"
+        "  -j N                 Run N walkthroughs at a time (default: number of\n"
+        "                       CPU cores.)\n"
+        "  -b, --baseline DIR   Directory of baseline turn hashes (default:\n"
+        "                       \"baseline\".)\n"
+        "  -o, --output DIR     Directory for transcripts and turn hashes\n"
+        "                       (default: current directory.)\n"
+        "  -u, --update         Store the results as the new baseline instead of\n"
+        "                       comparing against it.\n"
+        "      --headless FILE  The hugor-headless executable to use (default:\n"
+        "                       the one next to this program.)\n"
+        "      --in-process     Run the games on threads of this process instead\n"
+        "                       of starting hugor-headless for each of them.\n"
+        "      --timeout N      Fail a walkthrough when the game runs for N\n"
+        "                       seconds without asking for input.\n"
+        "      --allow-missing  Don't fail walkthroughs that have no baseline\n"
+        "                       yet.\n",
+        argv0);
+}
+
+
+// Quote a path for the system shell.
+static std::string
+quote( const std::string& s )
+{
+#ifdef _WIN32
+    return '"' + s + '"';
+#else
+    std::string ret = "'";
+    for (char c : s) {
+        if (c == '\'') {
+            ret += "'\\''";
+        } else {
+            ret += c;
+        }
+    }
+    return ret + "'";
+#endif
+}
+
+
+// File name without directory and extension.
+static std::string
+baseName( const std::string& path )
+{
+    size_t start = path.find_last_of("/\\");
+    start = start == std::string::npos ? 0 : start + 1;
+    size_t dot = path.rfind('.');
+    if (dot == std::string::npos or dot <= start) {
+        dot = path.size();
+    }
+    return path.substr(start, dot - start);
+}
+
+
+static std::vector<std::string>
+readLines( const std::string& path, bool* ok )
+{
+    std::vector<std::string> lines;
+    FILE* f = std::fopen(path.c_str(), "r");
+    *ok = f != nullptr;
+    if (not f) {
+        return lines;
+    }
+    char buf[256];
+    while (std::fgets(buf, sizeof buf, f)) {
+        lines.emplace_back(buf);
+    }
+    std::fclose(f);
+    return lines;
+}
+
+
+// Returns an error message, or an empty string on success.
+static std::string
+writeLines( const std::string& path, const std::vector<std::string>& lines )
+{
+    FILE* f = std::fopen(path.c_str(), "w");
+    if (not f) {
+        return "can't write " + path + ": " + std::strerror(errno);
+    }
+    for (const auto& line : lines) {
+        std::fputs(line.c_str(), f);
+    }
+    if (std::fclose(f) != 0) {
+        return "can't write " + path + ": " + std::strerror(errno);
+    }
+    return std::string();
+}
+
+
+// Creates 'dir' unless it exists. Returns an error message, or an empty
+// string on success. Only the last component is created.
+static std::string
+makeDir( const std::string& dir )
+{
+    struct stat st;
+    if (stat(dir.c_str(), &st) == 0) {
+        return (st.st_mode & S_IFDIR) ? std::string() : dir + " is not a directory";
+    }
+#ifdef _WIN32
+    const int ret = _mkdir(dir.c_str());
+#else
+    const int ret = mkdir(dir.c_str(), 0777);
+#endif
+    return ret == 0 ? std::string() : "can't create " + dir + ": " + std::strerror(errno);
+}
+
+
+// Run a walkthrough in a hugor-headless process and return its exit code.
+static int
+runHeadless( const Options& opts, const std::string& recFile, const std::string& prefix )
+{
+    std::string cmd = quote(opts.headless) + " -i " + quote(recFile)
+        + " -o " + quote(prefix + ".out") + " -t " + quote(prefix + ".txt")
+        + " --turn-hashes " + quote(prefix + ".hashes")
+        + " --watchdog " + std::to_string(opts.timeout) + ' ' + quote(opts.gameFile);
+#ifdef _WIN32
+    // cmd.exe strips the outer quotes of the whole command line.
+    cmd = '"' + cmd + '"';
+#endif
+    const int status = std::system(cmd.c_str());
+#ifdef _WIN32
+    return status;
+#else
+    return WIFEXITED(status) ? WEXITSTATUS(status) : status;
+#endif
+}
+
+
+static Result
+runWalkthrough( const Options& opts, const std::string& recFile )
+{
+    Result res;
+    const std::string name = baseName(recFile);
+    const std::string prefix = opts.outputDir + '/' + name;
+    const std::string hashFile = prefix + ".hashes";
+    const auto start = std::chrono::steady_clock::now();
+    int exitCode;
+
+    if (opts.inProcess) {
+        const std::string transcriptFile = prefix + ".txt";
+        HeadlessOptions session = { nullptr, nullptr, 80, 25, false, nullptr,
+                                    transcriptFile.c_str(), hashFile.c_str(), opts.timeout, 0,
+                                    nullptr, nullptr, 0, nullptr };
+        session.input = std::fopen(recFile.c_str(), "r");
+        session.output = std::fopen((prefix + ".out").c_str(), "w");
+        if (session.input and session.output) {
+            // Every game needs a thread of its own; see runHeadlessSession().
+            std::thread([&] {
+                exitCode = runHeadlessSession(session, opts.gameFile.c_str());
+            }).join();
+        } else {
+            exitCode = 1;
+        }
+        if (session.input) {
+            std::fclose(session.input);
+        }
+        if (session.output) {
+            std::fclose(session.output);
+        }
+    } else {
+        exitCode = runHeadless(opts, recFile, prefix);
+    }
+    res.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    bool ok;
+    const auto hashes = readLines(hashFile, &ok);
+    res.turns = hashes.size();
+    if (exitCode != 0) {
+        res.error = "the game exited with status " + std::to_string(exitCode)
+                    + "; see " + prefix + ".out";
+        return res;
+    }
+    if (not ok) {
+        res.error = "no turn hashes in " + hashFile;
+        return res;
+    }
+
+    const std::string baselineFile = opts.baselineDir + '/' + name + ".hashes";
+    if (opts.updateBaseline) {
+        res.error = writeLines(baselineFile, hashes);
+        res.status = res.error.empty() ? Result::Updated : Result::Failed;
+        return res;
+    }
+    const auto baseline = readLines(baselineFile, &ok);
+    if (not ok) {
+        res.status = Result::NoBaseline;
+        return res;
+    }
+    const auto diff = std::mismatch(hashes.begin(), hashes.end(), baseline.begin(), baseline.end());
+    if (diff.first == hashes.end() and diff.second == baseline.end()) {
+        res.status = Result::Ok;
+    } else {
+        res.status = Result::Diverged;
+        res.divergedTurn = diff.first - hashes.begin();
+    }
+    return res;
+}
+
+
+static void
+report( const std::string& recFile, const Result& res )
+{
+    std::string status;
+    switch (res.status) {
+      case Result::Ok:         status = "ok"; break;
+      case Result::Updated:    status = "baseline updated"; break;
+      case Result::NoBaseline: status = "no baseline"; break;
+      case Result::Failed:     status = "FAILED"; break;
+      case Result::Diverged:
+        status = "DIVERGED at turn " + std::to_string(res.divergedTurn);
+        break;
+    }
+    const double rate = res.seconds > 0 ? res.turns / res.seconds : 0;
+    std::lock_guard<std::mutex> locker(reportMutex);
+    std::printf("%-40s %-24s %6d turns %8.2fs %10.1f turns/s\n", recFile.c_str(),
+                status.c_str(), res.turns, res.seconds, rate);
+    if (not res.error.empty()) {
+        std::printf("    %s\n", res.error.c_str());
+    }
+    std::fflush(stdout);
+}
+
+
+int
+main( int argc, char* argv[] )
+{
+    Options opts;
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (not std::strcmp(arg, "-j") and hasValue) {
+            opts.jobs = std::max(1, std::atoi(argv[++i]));
+        } else if ((not std::strcmp(arg, "-b") or not std::strcmp(arg, "--baseline")) and hasValue) {
+            opts.baselineDir = argv[++i];
+        } else if ((not std::strcmp(arg, "-o") or not std::strcmp(arg, "--output")) and hasValue) {
+            opts.outputDir = argv[++i];
+        } else if (not std::strcmp(arg, "-u") or not std::strcmp(arg, "--update")) {
+            opts.updateBaseline = true;
+        } else if (not std::strcmp(arg, "--timeout") and hasValue) {
+            opts.timeout = std::max(0, std::atoi(argv[++i]));
+        } else if (not std::strcmp(arg, "--allow-missing")) {
+            opts.allowMissing = true;
+        } else if (not std::strcmp(arg, "--in-process")) {
+            opts.inProcess = true;
+        } else if (not std::strcmp(arg, "--headless") and hasValue) {
+            opts.headless = argv[++i];
+        } else if (arg[0] != '-' and opts.gameFile.empty()) {
+            opts.gameFile = arg;
+        } else if (arg[0] != '-') {
+            opts.recFiles.emplace_back(arg);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (opts.gameFile.empty() or opts.recFiles.empty()) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (opts.headless.empty()) {
+        const std::string self = argv[0];
+        const size_t sep = self.find_last_of("/\\");
+        opts.headless = sep == std::string::npos ? "hugor-headless"
+                                                 : self.substr(0, sep + 1) + "hugor-headless";
+    }
+
+    // Results are stored by the walkthrough's base name, so two walkthroughs
+    // with the same one would overwrite each other's.
+    std::set<std::string> names;
+    for (const auto& recFile : opts.recFiles) {
+        if (not names.insert(baseName(recFile)).second) {
+            std::fprintf(stderr, "More than one walkthrough is named \"%s\"; rename one of them.\n",
+                         baseName(recFile).c_str());
+            return 1;
+        }
+    }
+    std::string error = makeDir(opts.outputDir);
+    if (error.empty() and opts.updateBaseline) {
+        error = makeDir(opts.baselineDir);
+    }
+    if (not error.empty()) {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+
+    // Without --in-process, each walkthrough runs in its own hugor-headless
+    // process and these threads only wait on them.
+    std::vector<Result> results(opts.recFiles.size());
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> workers;
+    const auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < std::min<size_t>(opts.jobs, opts.recFiles.size()); ++i) {
+        workers.emplace_back([&] {
+            size_t job;
+            while ((job = next++) < opts.recFiles.size()) {
+                results[job] = runWalkthrough(opts, opts.recFiles[job]);
+                report(opts.recFiles[job], results[job]);
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    int failures = 0;
+    int turns = 0;
+    for (const auto& res : results) {
+        if (res.status == Result::Diverged or res.status == Result::Failed
+            or (res.status == Result::NoBaseline and not opts.allowMissing))
+        {
+            ++failures;
+        }
+        turns += res.turns;
+    }
+    std::printf("\n%zu walkthroughs, %d failed, %d turns in %.2fs (%.1f turns/s)\n",
+                results.size(), failures, turns, seconds, seconds > 0 ? turns / seconds : 0);
+    return failures > 0 ? 1 : 0;
+}
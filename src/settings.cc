@@ -67,6 +67,7 @@ extern "C" {
 #define SETT_SCRIPT_WRAP QString::fromLatin1("scriptWrap")
 #define SETT_ASK_FILE QString::fromLatin1("askforfileatstart")
 #define SETT_LAST_OPEN_DIR QString::fromLatin1("lastFileOpenDir")
+#define SETT_ENGINE_WATCHDOG QString::fromLatin1("engineWatchdog")
 #define SETT_GAMES_LIST QString::fromLatin1("games")
 #define SETT_APP_SIZE QString::fromLatin1("size")
 #define SETT_OVERLAY_SCROLL QString::fromLatin1("overlayScrollback")
@@ -148,6 +149,7 @@ Settings::loadFromDisk( SettingsOverrides* ovr )
     this->askForGameFile = sett.value(SETT_ASK_FILE, true).toBool();
     this->lastFileOpenDir = sett.value(SETT_LAST_OPEN_DIR, QString::fromLatin1("")).toString();
     this->scriptWrap = sett.value(SETT_SCRIPT_WRAP, 0).toInt();
+    this->engineWatchdog = sett.value(SETT_ENGINE_WATCHDOG, 10).toInt();
     sett.endGroup();
 
     sett.beginGroup(SETT_RECENT_GRP);
@@ -281,6 +283,7 @@ Settings::saveToDisk()
     sett.setValue(SETT_ASK_FILE, this->askForGameFile);
     sett.setValue(SETT_LAST_OPEN_DIR, this->lastFileOpenDir);
     sett.setValue(SETT_SCRIPT_WRAP, this->scriptWrap);
+    sett.setValue(SETT_ENGINE_WATCHDOG, this->engineWatchdog);
     sett.endGroup();
 
     sett.beginGroup(SETT_RECENT_GRP);
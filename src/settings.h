@@ -36,7 +36,8 @@
 class Settings {
   public:
     Settings()
-        : videoSysError(false)
+        : videoSysError(false),
+          soundSysError(false)
     { }
 
     void
@@ -70,6 +71,10 @@ class Settings {
     bool askForGameFile;
     QString lastFileOpenDir;
 
+    // Seconds a game can run without asking for input before we ask the
+    // player whether to stop it. 0 means never.
+    int engineWatchdog;
+
     QStringList recentGamesList;
     static const int recentGamesCapacity = 10;
 
@@ -85,6 +90,7 @@ class Settings {
     // These are not saved. Used for temporary overrides that only apply
     // to the current session.
     bool videoSysError;
+    bool soundSysError;
 };
 
 
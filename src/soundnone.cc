@@ -30,9 +30,11 @@
 #include "hugodefs.h"
 
 
-void
+QString
 initSoundEngine()
-{ }
+{
+    return QString();
+}
 
 
 void
@@ -31,6 +31,7 @@
 #include <QFile>
 #include <cstdio>
 #include <cmath>
+#include <atomic>
 
 extern "C" {
 #include "heheader.h"
@@ -47,39 +48,71 @@ extern "C" {
 // after muting them.
 static int currentMusicVol = 100;
 static int currentSampleVol = 100;
-static bool isMuted = false;
+static std::atomic<bool> isMuted(false);
 
+// The engine is initialized in a background thread when a game first needs it
+// (see HApplication::prewarmMediaEngines), so until then, only our own state
+// changes.
+static std::atomic<bool> isInitialized(false);
 
-void
+
+// This runs in a background thread while the game is running, so it can't
+// just exit when there's no sound. Sound and music are turned off instead.
+static QString
+soundError( const char* what, const char* error )
+{
+    qWarning("%s: %s", what, error);
+    hApp->settings()->soundSysError = true;
+    return QObject::tr("Unable to use sound. Sound and music will be disabled. ")
+           + QObject::tr("The SDL error was: ") + QString::fromLocal8Bit(error);
+}
+
+
+QString
 initSoundEngine()
 {
     // Initialize only the audio part of SDL.
     if (SDL_Init(SDL_INIT_AUDIO) != 0) {
-        qWarning("Unable to initialize sound system: %s", SDL_GetError());
-        exit(1);
+        return soundError("Unable to initialize sound system", SDL_GetError());
     }
 
     // This will preload the needed codecs now instead of constantly loading
     // and unloading them each time a sound is played/stopped.
     int sdlFormats = MIX_INIT_MP3 | MIX_INIT_MOD;
     if (Mix_Init((sdlFormats & sdlFormats) != sdlFormats)) {
-        qWarning("Unable to load MP3 and/or MOD audio formats: %s", Mix_GetError());
-        exit(1);
+        const QString& err = soundError("Unable to load MP3 and/or MOD audio formats", Mix_GetError());
+        SDL_Quit();
+        return err;
     }
 
     // Initialize the mixer. 44.1kHz, default sample format,
     // 2 channels (stereo) and a 4k chunk size.
     if (Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, 2, 4096) != 0) {
-        qWarning("Unable to initialize audio mixer: %s", Mix_GetError());
-        exit(1);
+        const QString& err = soundError("Unable to initialize audio mixer", Mix_GetError());
+        Mix_Quit();
+        SDL_Quit();
+        return err;
     }
     Mix_AllocateChannels(8);
+    isInitialized = true;
+
+    // In case we got muted before.
+    if (isMuted) {
+        Mix_VolumeMusic(0);
+        Mix_Volume(-1, 0);
+    }
+    return QString();
 }
 
 
 void
 closeSoundEngine()
 {
+    if (not isInitialized) {
+        return;
+    }
+    isInitialized = false;
+
     // Shut down SDL and SDL_mixer.
     Mix_ChannelFinished(0);
     Mix_HookMusicFinished(0);
@@ -97,8 +130,10 @@ muteSound( bool mute )
 {
     if (mute and not isMuted) {
         isMuted = true;
-        Mix_VolumeMusic(0);
-        Mix_Volume(-1, 0);
+        if (isInitialized) {
+            Mix_VolumeMusic(0);
+            Mix_Volume(-1, 0);
+        }
     } else if (not mute and isMuted) {
         isMuted = false;
         updateMusicVolume();
@@ -124,14 +159,14 @@ updateSoundVolume()
 bool
 isMusicPlaying()
 {
-    return Mix_PlayingMusic();
+    return isInitialized and Mix_PlayingMusic();
 }
 
 
 bool
 isSamplePlaying()
 {
-    return Mix_Playing(-1) > 0;
+    return isInitialized and Mix_Playing(-1) > 0;
 }
 
 
@@ -144,6 +179,13 @@ HugoHandlers::playmusic(HUGO_FILE infile, long reslength, char loop_flag, int* r
         return;
     }
 
+    hApp->initMediaEngines(HApplication::SoundEngine);
+    if (hApp->settings()->soundSysError) {
+        hugo_fclose(infile);
+        *result = false;
+        return;
+    }
+
     // We only play one music track at a time, so it's enough
     // to make this static.
     static Mix_Music* music = 0;
@@ -229,7 +271,7 @@ HugoHandlers::musicvolume(int vol)
     // SDL_mixer's shitty range of 0..128 doesn't really allow for that.)
     vol = vol * std::pow((float)hApp->settings()->soundVolume / 100.f, 2);
 
-    if (not isMuted) {
+    if (isInitialized and not isMuted) {
         Mix_VolumeMusic(vol);
     }
 }
@@ -238,7 +280,9 @@ HugoHandlers::musicvolume(int vol)
 void
 HugoHandlers::stopmusic()
 {
-    Mix_HaltMusic();
+    if (isInitialized) {
+        Mix_HaltMusic();
+    }
 }
 
 
@@ -251,6 +295,13 @@ HugoHandlers::playsample(HUGO_FILE infile, long reslength, char loop_flag, int*
         return;
     }
 
+    hApp->initMediaEngines(HApplication::SoundEngine);
+    if (hApp->settings()->soundSysError) {
+        delete infile;
+        *result = false;
+        return;
+    }
+
     // We only play one sample at a time, so it's enough to make these
     // static.
     static QFile* file = 0;
@@ -333,7 +384,7 @@ HugoHandlers::samplevolume(int vol)
     // SDL_mixer's shitty range of 0..128 doesn't really allow for that.)
     vol = vol * std::pow((float)hApp->settings()->soundVolume / 100.f, 2);
 
-    if (not isMuted) {
+    if (isInitialized and not isMuted) {
         Mix_Volume(-1, vol);
     }
 }
@@ -342,5 +393,7 @@ HugoHandlers::samplevolume(int vol)
 void
 HugoHandlers::stopsample()
 {
-    Mix_HaltChannel(-1);
+    if (isInitialized) {
+        Mix_HaltChannel(-1);
+    }
 }
@@ -3,10 +3,18 @@
 
 #include <QApplication>
 
+#include "hmetrics.h"
+#include "htracer.h"
+
 template <typename F>
 static void
 runInMainThread(F&& fun)
 {
+    // Shows up in traces as the time the engine thread spends blocked on the
+    // GUI thread.
+    HTraceScope trace("runInMainThread", "sync");
+    static HHistogram& blocked = HMetrics::histogram("sync.blocked_us");
+    HLatencyScope latency(blocked);
     QObject tmp;
     QObject::connect(&tmp, &QObject::destroyed, qApp, std::move(fun), Qt::BlockingQueuedConnection);
 }
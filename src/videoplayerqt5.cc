@@ -40,8 +40,10 @@
 #include "hmainwindow.h"
 
 
-void initVideoEngine(int&, char*[])
-{ }
+QString initVideoEngine(int&, char*[])
+{
+    return QString();
+}
 
 void closeVideoEngine()
 { }